@@ -0,0 +1,147 @@
+/*
+ * AstVisitor.cpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "AstVisitor.hpp"
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+void AstWalker::walkLoop(const ExprAST* cond, const ExprAST* step, const StmtAST* body) {
+    ++m_loopDepth;
+    walk(cond);
+    walk(step);
+    walk(body);
+    --m_loopDepth;
+}
+
+void AstWalker::walk(const StmtAST* stmt) {
+    if (stmt == nullptr) return;
+    for (auto &visitor : m_visitors)
+        visitor->enter(stmt);
+
+    switch (stmt->stmt_type()) {
+    case STMT_TYPE::RETURN:
+        walk(static_cast<const ReturnStmtAST*>(stmt)->value());
+        break;
+    case STMT_TYPE::BLOCK:
+        for (auto &s : static_cast<const BlockStmtAST*>(stmt)->blockStatements())
+            walk(s);
+        break;
+    case STMT_TYPE::ASSIGNMENT:
+        walk(static_cast<const AssignmentStmtAST*>(stmt)->expr());
+        break;
+    case STMT_TYPE::ASSIGNMENT_LIST:
+        for (auto &ass : static_cast<const AssignmentListStmtAST*>(stmt)->assignments())
+            walk(ass.second);
+        break;
+    case STMT_TYPE::EXPRESSION:
+        walk(static_cast<const ExpressionStmtAST*>(stmt)->expr());
+        break;
+    case STMT_TYPE::IF: {
+        const IfStmtAST* ifStmt = static_cast<const IfStmtAST*>(stmt);
+        walk(ifStmt->cond());
+        walk(ifStmt->then_stmt());
+        break;
+    }
+    case STMT_TYPE::IF_ELSE: {
+        const IfElseStmtAST* ifStmt = static_cast<const IfElseStmtAST*>(stmt);
+        walk(ifStmt->cond());
+        walk(ifStmt->then_stmt());
+        walk(ifStmt->else_stmt());
+        break;
+    }
+    case STMT_TYPE::WHILE: {
+        const WhileStmtAST* whileStmt = static_cast<const WhileStmtAST*>(stmt);
+        walkLoop(whileStmt->cond(), nullptr, whileStmt->body());
+        break;
+    }
+    case STMT_TYPE::FOR: {
+        const ForStmtAST* forStmt = static_cast<const ForStmtAST*>(stmt);
+        walk(forStmt->init());
+        walkLoop(forStmt->cond(), forStmt->step(), forStmt->body());
+        break;
+    }
+    case STMT_TYPE::FUNCTION:
+        walk(static_cast<const FunctionAST*>(stmt)->body());
+        break;
+    default:
+        break;
+    }
+
+    for (auto &visitor : m_visitors)
+        visitor->leave(stmt);
+}
+
+void AstWalker::walk(const ExprAST* expr) {
+    if (expr == nullptr) return;
+    for (auto &visitor : m_visitors)
+        visitor->visit(expr);
+
+    switch (expr->exp_type()) {
+    case EXP_TYPE::BINARY_EXP: {
+        const BinaryExprAST* bin = static_cast<const BinaryExprAST*>(expr);
+        walk(bin->left());
+        walk(bin->right());
+        break;
+    }
+    case EXP_TYPE::UNARY_EXP:
+        walk(static_cast<const UnaryExprAST*>(expr)->operand());
+        break;
+    case EXP_TYPE::CAST_EXP:
+        walk(static_cast<const CastExprAST*>(expr)->operand());
+        break;
+    case EXP_TYPE::CALL_EXP:
+        for (auto &arg : static_cast<const FunctionCallExprAST*>(expr)->args())
+            walk(arg);
+        break;
+    case EXP_TYPE::VECTOR_EXP:
+        for (auto &arg : static_cast<const VectorExprAST*>(expr)->args())
+            walk(arg);
+        break;
+    case EXP_TYPE::LANE_EXP: {
+        const LaneExprAST* lane = static_cast<const LaneExprAST*>(expr);
+        walk(lane->vector());
+        walk(lane->index());
+        break;
+    }
+    case EXP_TYPE::METHOD_EXP: {
+        const MethodCallExprAST* call = static_cast<const MethodCallExprAST*>(expr);
+        walk(call->object());
+        for (auto &arg : call->args())
+            walk(arg);
+        break;
+    }
+    case EXP_TYPE::FIELD_EXP:
+        walk(static_cast<const FieldExprAST*>(expr)->object());
+        break;
+    case EXP_TYPE::NEW_OBJECT_EXP:
+        for (auto &arg : static_cast<const NewObjectExprAST*>(expr)->args())
+            walk(arg);
+        break;
+    case EXP_TYPE::PRINTF_EXP:
+        for (auto &arg : static_cast<const PrintfExprAST*>(expr)->args())
+            walk(arg);
+        break;
+    case EXP_TYPE::ARRAY_NEW_EXP:
+        walk(static_cast<const ArrayNewExprAST*>(expr)->size());
+        break;
+    case EXP_TYPE::ARRAY_LITERAL_EXP:
+        for (auto &e : static_cast<const ArrayLiteralExprAST*>(expr)->elements())
+            walk(e);
+        break;
+    case EXP_TYPE::INDEX_EXP:
+        walk(static_cast<const ArrayIndexExprAST*>(expr)->index());
+        break;
+    default:
+        break;
+    }
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
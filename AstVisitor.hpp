@@ -0,0 +1,73 @@
+/*
+ * AstVisitor.hpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef AST_VISITOR_HPP
+#define AST_VISITOR_HPP
+
+#include "Expression.hpp"
+#include "Statement.hpp"
+
+#include <vector>
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief An analysis run by AstWalker. Hooks see every node of the walked tree in source
+/// order: statements before (enter) and after (leave) their children, expressions before their
+/// operands. Default hooks do nothing, so analyses override only what they need.
+/// -----------------------------------------------------------------------------------------------
+class AstVisitor {
+public:
+    virtual ~AstVisitor() {}
+
+    /// \brief Called before children of given statement are visited.
+    virtual void enter(const StmtAST*) {}
+
+    /// \brief Called after children of given statement were visited.
+    virtual void leave(const StmtAST*) {}
+
+    /// \brief Called before operands of given expression are visited.
+    virtual void visit(const ExprAST*) {}
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Walks statements and expressions, calling all registered visitors on every node.
+/// Several analyses share one traversal, and the knowledge of which nodes have which children
+/// lives only here (new node kinds need a case in walk(), not in every analysis).
+/// Walker descends into bodies of functions, but not into classes.
+/// -----------------------------------------------------------------------------------------------
+class AstWalker {
+public:
+    AstWalker() : m_loopDepth(0) {}
+
+    /// \brief Registers given visitor (not owned), visitors are called in registration order.
+    void add(AstVisitor* visitor) { m_visitors.push_back(visitor); }
+
+    /// \brief Walks given statement and everything inside it (null is ignored).
+    void walk(const StmtAST* stmt);
+
+    /// \brief Walks given expression and its operands (null is ignored).
+    void walk(const ExprAST* expr);
+
+    /// \brief Returns the number of loops around the node being visited (conditions and steps
+    /// of loops are inside them, they run on every iteration).
+    unsigned loop_depth() const { return m_loopDepth; }
+
+private:
+    void walkLoop(const ExprAST* cond, const ExprAST* step, const StmtAST* body);
+
+    std::vector<AstVisitor*> m_visitors;
+    unsigned m_loopDepth;
+};
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+#endif /* ifndef AST_VISITOR_HPP */
@@ -0,0 +1,99 @@
+/*
+ * DebugInfo.cpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "DebugInfo.hpp"
+#include "ProgramOptions.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+static std::unique_ptr<DIBuilder> DBuilder;
+static DICompileUnit* CompileUnit = nullptr;
+static DIFile* SourceFile = nullptr;
+// Subprogram of current function, null outside of functions
+static DISubprogram* CurrentSubprogram = nullptr;
+
+void InitializeDebugInfo() {
+    DBuilder.reset();
+    CompileUnit = nullptr;
+    SourceFile = nullptr;
+    CurrentSubprogram = nullptr;
+    if (! vlang::util::ProgramOptions::get().debug_info()) return;
+
+    // Debuggers find the source through the absolute directory of the compilation
+    SmallString<256> path(vlang::util::ProgramOptions::get().first_input_file());
+    sys::fs::make_absolute(path);
+    std::string fileName = sys::path::filename(path).str();
+    std::string directory = sys::path::parent_path(path).str();
+    bool isOptimized = vlang::util::ProgramOptions::get().optimization_level() > 0;
+
+    TheModule->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+    TheModule->addModuleFlag(Module::Warning, "Dwarf Version", 4);
+    DBuilder.reset(new DIBuilder(*TheModule));
+    SourceFile = DBuilder->createFile(fileName, directory);
+    // Vala has no DWARF language code of its own, C is what debuggers handle best
+#if LLVM_VERSION_MAJOR >= 4
+    CompileUnit = DBuilder->createCompileUnit(dwarf::DW_LANG_C, SourceFile, "vlang", isOptimized, "", 0);
+#else
+    CompileUnit = DBuilder->createCompileUnit(dwarf::DW_LANG_C, fileName, directory, "vlang", isOptimized, "", 0);
+#endif
+}
+
+void BeginFunctionDebugInfo(Function* f, unsigned line) {
+    if (DBuilder == nullptr) return;
+
+    // Parameter types aren't described, profilers only need names and lines
+#if LLVM_VERSION_MAJOR >= 4 || (LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 8)
+    DISubroutineType* type = DBuilder->createSubroutineType(DBuilder->getOrCreateTypeArray(None));
+#else
+    DISubroutineType* type = DBuilder->createSubroutineType(SourceFile, DBuilder->getOrCreateTypeArray(None));
+#endif
+    bool isOptimized = vlang::util::ProgramOptions::get().optimization_level() > 0;
+#if LLVM_VERSION_MAJOR >= 8
+    DISubprogram::DISPFlags flags = DISubprogram::SPFlagDefinition;
+    if (isOptimized) flags |= DISubprogram::SPFlagOptimized;
+    CurrentSubprogram = DBuilder->createFunction(SourceFile, f->getName(), StringRef(), SourceFile, line, type,
+                                                 line, DINode::FlagPrototyped, flags);
+    f->setSubprogram(CurrentSubprogram);
+#elif LLVM_VERSION_MAJOR >= 4 || (LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 8)
+    CurrentSubprogram = DBuilder->createFunction(SourceFile, f->getName(), StringRef(), SourceFile, line, type,
+                                                 false, true, line, DINode::FlagPrototyped, isOptimized);
+    f->setSubprogram(CurrentSubprogram);
+#else
+    CurrentSubprogram = DBuilder->createFunction(SourceFile, f->getName(), StringRef(), SourceFile, line, type,
+                                                 false, true, line, DINode::FlagPrototyped, isOptimized, f);
+#endif
+    SetDebugLocation(line);
+}
+
+void SetDebugLocation(unsigned line) {
+    if (CurrentSubprogram == nullptr) return;
+#if LLVM_VERSION_MAJOR >= 12
+    Builder.SetCurrentDebugLocation(DILocation::get(TheContext, line, 0, CurrentSubprogram));
+#else
+    Builder.SetCurrentDebugLocation(DebugLoc::get(line, 0, CurrentSubprogram));
+#endif
+}
+
+void EndFunctionDebugInfo() {
+    if (CurrentSubprogram == nullptr) return;
+    CurrentSubprogram = nullptr;
+    Builder.SetCurrentDebugLocation(DebugLoc());
+}
+
+void FinalizeDebugInfo() {
+    if (DBuilder != nullptr) DBuilder->finalize();
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
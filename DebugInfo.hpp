@@ -0,0 +1,48 @@
+/*
+ * DebugInfo.hpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef DEBUG_INFO_HPP
+#define DEBUG_INFO_HPP
+
+#include "LLVMCodegen.hpp"
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// DWARF debug info (-g).
+//
+// The module gets a compile unit for the input file and every function a subprogram starting
+// on the line of its header. Instructions are attributed to the line of the statement they
+// come from (the header line for code of if, while and for conditions), which is what perf,
+// gdb and valgrind need to map samples back to .vala sources. Variables and types aren't
+// described. Debug info doesn't change optimization, -O levels generate the same code.
+//
+// Everything here does nothing unless -g was given.
+
+/// \brief Creates the compile unit of current module, called once the module exists.
+void InitializeDebugInfo();
+
+/// \brief Gives given function a subprogram starting at given line, the builder emits
+/// following instructions on that line.
+void BeginFunctionDebugInfo(Function* f, unsigned line);
+
+/// \brief Emits following instructions of current function on given line.
+void SetDebugLocation(unsigned line);
+
+/// \brief Finishes current function, following instructions have no location (code the
+/// compiler generates outside of functions, like destroy functions of classes).
+void EndFunctionDebugInfo();
+
+/// \brief Finalizes debug info of the module, called before the module is written.
+void FinalizeDebugInfo();
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+#endif /* ifndef DEBUG_INFO_HPP */
@@ -7,9 +7,12 @@
 
 #include "Expression.hpp"
 #include "GlobalContainers.hpp"
+#include "MemoryManagement.hpp"
 #include "color.h"
 
 #include "ProgramOptions.hpp"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Intrinsics.h"
 
 // Required in order to use lexical cast
 namespace boost{
@@ -24,8 +27,8 @@ namespace vlang {
 // CastTo
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 ExprAST* ConstIntExprAST::convertTo(VLANG_TYPE type) {
+    if (is_integer(type)) return new ConstIntExprAST(m_val, type);
     switch (type) {
-    case VLANG_TYPE::INT32:     return this->clone();
     case VLANG_TYPE::DOUBLE:    return new ConstDoubleExprAST(m_val);
     case VLANG_TYPE::STRING:    return new StringExprAST(std::to_string(m_val));
     case VLANG_TYPE::BOOL:      return new BoolExprAST(m_val);
@@ -36,8 +39,8 @@ ExprAST* ConstIntExprAST::convertTo(VLANG_TYPE type) {
 }
 
 ExprAST* ConstDoubleExprAST::convertTo(VLANG_TYPE type) {
+    if (is_integer(type)) return new ConstIntExprAST(m_val, type);
     switch (type) {
-    case VLANG_TYPE::INT32:     return new ConstIntExprAST(m_val);
     case VLANG_TYPE::DOUBLE:    return this->clone();
     case VLANG_TYPE::STRING:    return new StringExprAST(std::to_string(m_val));
     case VLANG_TYPE::BOOL:      return new BoolExprAST(m_val);
@@ -48,8 +51,8 @@ ExprAST* ConstDoubleExprAST::convertTo(VLANG_TYPE type) {
 }
 
 ExprAST* BoolExprAST::convertTo(VLANG_TYPE type) {
+    if (is_integer(type)) return new ConstIntExprAST(m_val == true ? 1 : 0, type);
     switch (type) {
-    case VLANG_TYPE::INT32:     return new ConstIntExprAST(m_val == true ? 1 : 0);
     case VLANG_TYPE::DOUBLE:    return new ConstDoubleExprAST(m_val == true ? 1.0 : 0.0);
     case VLANG_TYPE::STRING:    return new StringExprAST(std::to_string(m_val));
     case VLANG_TYPE::BOOL:      return this->clone();
@@ -76,9 +79,13 @@ ExprAST* StringExprAST::convertTo(VLANG_TYPE type) {
     }
 }
 
+ExprAST* CastExprAST::convertTo(VLANG_TYPE type) {
+    return new CastExprAST(type, m_expr->clone());
+}
+
 // TODO
 ExprAST* UnaryExprAST::convertTo(VLANG_TYPE type) {
-    return new UnaryExprAST(m_op, m_expr->convertTo(type));
+    return new UnaryExprAST(m_op, m_expr->convertTo(type), m_postfix);
 }
 
 // TODO
@@ -86,6 +93,39 @@ ExprAST* BinaryExprAST::convertTo(VLANG_TYPE type) {
     return new BinaryExprAST(m_op, m_left->convertTo(type), m_right->convertTo(type));
 }
 
+ExprAST* ArrayNewExprAST::convertTo(VLANG_TYPE type) {
+    return type == m_type->vlang_type() ? this->clone() : nullptr;
+}
+
+ExprAST* ArrayLiteralExprAST::convertTo(VLANG_TYPE type) {
+    if (! is_array(type)) return nullptr;
+    ArrayLiteralExprAST* res = static_cast<ArrayLiteralExprAST*>(this->clone());
+    res->set_element_type(element_of(type));
+    return res;
+}
+
+// Values known only at run time (elements, lengths, results of methods) are converted by a
+// cast. Numbers convert to each other, any other conversion is unsupported (nullptr).
+static ExprAST* convertByCast(const ExprAST* expr, VLANG_TYPE type) {
+    VLANG_TYPE from = expr->type()->vlang_type();
+    if (from == type) return expr->clone();
+    bool numbers = (is_integer(from) || from == VLANG_TYPE::DOUBLE)
+                && (is_integer(type) || type == VLANG_TYPE::DOUBLE);
+    return numbers ? new CastExprAST(type, expr->clone()) : nullptr;
+}
+
+ExprAST* ArrayIndexExprAST::convertTo(VLANG_TYPE type) {
+    return convertByCast(this, type);
+}
+
+ExprAST* ArrayLengthExprAST::convertTo(VLANG_TYPE type) {
+    return convertByCast(this, type);
+}
+
+ExprAST* MethodCallExprAST::convertTo(VLANG_TYPE type) {
+    return convertByCast(this, type);
+}
+
 ExprAST* FunctionCallExprAST::convertTo(VLANG_TYPE type) {
     switch (type) {
     case VLANG_TYPE::INT32:     return nullptr;
@@ -101,15 +141,49 @@ ExprAST* FunctionCallExprAST::convertTo(VLANG_TYPE type) {
 // Codegen functions (LLVM related)
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 Value* ConstIntExprAST::codegen() const {
-    return LLVM_INT(m_val);
+    return ConstantInt::get(m_type->llvm_type(), m_val, true);
+}
+
+bool ConstIntExprAST::fits_into(VLANG_TYPE type) const {
+    unsigned bits = integer_bits(type);
+    if (bits == 0) return false;
+    if (is_unsigned(m_type->vlang_type())) {
+        unsigned long long val = m_val;
+        return bits == 64 || val < (1ULL << (bits - (is_unsigned(type) ? 0 : 1)));
+    }
+    if (is_unsigned(type))
+        return m_val >= 0 && (bits == 64 || (unsigned long long)m_val < (1ULL << bits));
+    return bits == 64 || (m_val >= -(1LL << (bits - 1)) && m_val < (1LL << (bits - 1)));
+}
+
+// Integers are extended by the signedness of the operand, doubles are converted by the
+// signedness of the target (same as C).
+Value* CastExprAST::codegen() const {
+    Value* val = m_expr->codegen();
+    if (val == nullptr) return logError("Failed m_expr->codegen() in CastExprAST::codegen()");
+    Type* to = m_type->llvm_type();
+    if (val->getType()->isDoubleTy() && is_unsigned(m_type->vlang_type()))
+        return Builder.CreateFPToUI(val, to, "conv");
+    return CreateNumericCast(val, to, is_unsigned(m_expr->type()->vlang_type()));
 }
 
 Value* ConstDoubleExprAST::codegen() const {
     return LLVM_DOUBLE(m_val);
 }
 
-// TODO
+// Strings are (data, length) values, literals are pooled so no instruction is needed.
 Value* StringExprAST::codegen() const {
+    return GetStringLiteral(UnescapeString(m_str));
+}
+
+// Returns the address of a local (or global) variable, nullptr if there is no such variable.
+Value* getVariableAddress(const std::string& name) {
+    auto localFinder = NamedValues.find(name);
+    if (localFinder != NamedValues.end() && localFinder->second != nullptr)
+        return localFinder->second;
+    auto globalFinder = GlobalValues.find(name);
+    if (globalFinder != GlobalValues.end() && globalFinder->second != nullptr)
+        return globalFinder->second;
     return nullptr;
 }
 
@@ -123,46 +197,129 @@ Value* VariableExprAST::codegen() const {
     return Builder.CreateLoad(varAddress);
 }
 
-// TODO
 Value* UnaryExprAST::codegen() const {
-    std::cerr << "UnaryExprAST::codegen() has not yet been implemented!" << std::endl;
-    return nullptr;
+    if (m_op == "++" || m_op == "--") {
+        if (m_expr->exp_type() != EXP_TYPE::VARIABLE_EXP)
+            return logError("Operand of '" + m_op + "' has to be a variable!");
+        std::string name = static_cast<VariableExprAST*>(m_expr)->name();
+        Value* addr = getVariableAddress(name);
+        if (addr == nullptr) return logError("Unknown variable: '" + name + "'");
+
+        Value* oldVal = Builder.CreateLoad(addr, name);
+        Value* newVal = nullptr;
+        if (oldVal->getType() == LLVM_DOUBLETY())
+            newVal = (m_op == "++") ? Builder.CreateFAdd(oldVal, LLVM_DOUBLE(1.0), "inc")
+                                    : Builder.CreateFSub(oldVal, LLVM_DOUBLE(1.0), "dec");
+        else if (is_unsigned(m_expr->type()->vlang_type()))
+            // Unsigned integers wrap around
+            newVal = (m_op == "++") ? Builder.CreateAdd(oldVal, ConstantInt::get(oldVal->getType(), 1), "inc")
+                                    : Builder.CreateSub(oldVal, ConstantInt::get(oldVal->getType(), 1), "dec");
+        else if (oldVal->getType()->isIntegerTy())
+            newVal = (m_op == "++") ? Builder.CreateNSWAdd(oldVal, ConstantInt::get(oldVal->getType(), 1), "inc")
+                                    : Builder.CreateNSWSub(oldVal, ConstantInt::get(oldVal->getType(), 1), "dec");
+        else return logError("Unsupported operand type for '" + m_op + "'");
+        Builder.CreateStore(newVal, addr);
+        return m_postfix ? oldVal : newVal;
+    }
+
+    Value* val = m_expr->codegen();
+    if (val == nullptr) return logError("Failed m_expr->codegen() in UnaryExprAST::codegen()");
+    if (m_op == "-") {
+        if (val->getType()->isFPOrFPVectorTy()) return Builder.CreateFNeg(val, "neg");
+        if (is_unsigned(m_expr->type()->vlang_type())) return Builder.CreateNeg(val, "neg");
+        return Builder.CreateNSWNeg(val, "neg");
+    }
+    if (m_op == "!") return Builder.CreateNot(val, "not");
+    return logError("Unsupported unary operation '" + m_op + "'");
 }
 
+// Comparisons produce i1, operands are already converted to binOpType.
 Value* handleRelationalOperation(std::string op, Value* left, Value* right, const VlangType* binOpType) {
+    if (is_unsigned(binOpType->vlang_type())) {
+        if (op == "<")  return Builder.CreateICmpULT(left, right, "lt");
+        if (op == ">")  return Builder.CreateICmpUGT(left, right, "gt");
+        if (op == ">=") return Builder.CreateICmpUGE(left, right, "ge");
+        if (op == "<=") return Builder.CreateICmpULE(left, right, "le");
+        if (op == "==") return Builder.CreateICmpEQ(left, right, "eq");
+        if (op == "!=") return Builder.CreateICmpNE(left, right, "ne");
+        return logError("Unsupported operation '" + op + "' with " + binOpType->str() + " type.");
+    }
+    if (is_integer(binOpType->vlang_type())) {
+        if (op == "<")  return Builder.CreateICmpSLT(left, right, "lt");
+        if (op == ">")  return Builder.CreateICmpSGT(left, right, "gt");
+        if (op == ">=") return Builder.CreateICmpSGE(left, right, "ge");
+        if (op == "<=") return Builder.CreateICmpSLE(left, right, "le");
+        if (op == "==") return Builder.CreateICmpEQ(left, right, "eq");
+        if (op == "!=") return Builder.CreateICmpNE(left, right, "ne");
+        return logError("Unsupported operation '" + op + "' with " + binOpType->str() + " type.");
+    }
     switch (binOpType->vlang_type()) {
-        case VLANG_TYPE::INT32:
+        case VLANG_TYPE::STRING: {
+            // Strings are compared through runtime, result is compared with 0
+            Type* params[] = { GetStringStructType(), GetStringStructType() };
+            Function* compare = GetRuntimeFunction("vlang_string_compare",
+                    FunctionType::get(LLVM_INTTY(), params, false));
+            compare->setOnlyReadsMemory();
+            Value* args[] = { left, right };
+            left = Builder.CreateCall(compare, args, "str_cmp");
+            right = LLVM_INT(0);
+            if (op == "<")  return Builder.CreateICmpSLT(left, right, "str_lt");
+            if (op == ">")  return Builder.CreateICmpSGT(left, right, "str_gt");
+            if (op == ">=") return Builder.CreateICmpSGE(left, right, "str_ge");
+            if (op == "<=") return Builder.CreateICmpSLE(left, right, "str_le");
+            if (op == "==") return Builder.CreateICmpEQ(left, right, "str_eq");
+            if (op == "!=") return Builder.CreateICmpNE(left, right, "str_ne");
+            return logError("Unsupported operation '" + op + "' with string type.");
+        }
         case VLANG_TYPE::BOOL:
+            // false < true
             if (op == "<")  return Builder.CreateICmpULT(left, right, "lt");
             if (op == ">")  return Builder.CreateICmpUGT(left, right, "gt");
             if (op == ">=") return Builder.CreateICmpUGE(left, right, "ge");
             if (op == "<=") return Builder.CreateICmpULE(left, right, "le");
             if (op == "==") return Builder.CreateICmpEQ(left, right, "eq");
             if (op == "!=") return Builder.CreateICmpNE(left, right, "ne");
-            return logError("Unsupported operation '" + op + "' with int/bool type.");
+            return logError("Unsupported operation '" + op + "' with bool type.");
         case VLANG_TYPE::DOUBLE:
-            if (op == "<" ) left = Builder.CreateFCmpULT(left, right, "fp_lt");
-            if (op == ">" ) left = Builder.CreateFCmpUGT(left, right, "fp_lt");
-            if (op == ">=" ) left = Builder.CreateFCmpUGE(left, right, "fp_lt");
-            if (op == "<=" ) left = Builder.CreateFCmpULE(left, right, "fp_lt");
-            if (op == "==" ) left = Builder.CreateFCmpOEQ(left, right, "fp_lt");
-            if (op == "!=" ) left = Builder.CreateFCmpONE(left, right, "fp_lt");
-            return Builder.CreateUIToFP(left, LLVM_DOUBLETY(), "boollt");
+            // Same as C: comparisons with NaN are false, except for !=
+            if (op == "<" ) return Builder.CreateFCmpOLT(left, right, "fp_lt");
+            if (op == ">" ) return Builder.CreateFCmpOGT(left, right, "fp_gt");
+            if (op == ">=") return Builder.CreateFCmpOGE(left, right, "fp_ge");
+            if (op == "<=") return Builder.CreateFCmpOLE(left, right, "fp_le");
+            if (op == "==") return Builder.CreateFCmpOEQ(left, right, "fp_eq");
+            if (op == "!=") return Builder.CreateFCmpUNE(left, right, "fp_ne");
+            return logError("Unsupported operation '" + op + "' with double type.");
         default:
             std::cerr << "Unsupported operation " << op << " on operands of type: " << binOpType->str() << std::endl;
             return nullptr;
     }
 }
 
+// Signed integers overflow is undefined (as in C), nsw lets LLVM widen induction variables
+// and compute trip counts. Unsigned integers wrap around.
 Value* handleArithmeticOperation(std::string op, Value* left, Value* right, const VlangType* type) {
+    // Vectors work lane by lane, with the same instructions as their lanes
+    if (is_vector(type->vlang_type())) {
+        std::unique_ptr<VlangType> lane(make_from_enum(vector_element(type->vlang_type())));
+        return handleArithmeticOperation(op, left, right, lane.get());
+    }
+    if (is_unsigned(type->vlang_type())) {
+        if (op == "+") return Builder.CreateAdd(left, right, "uint_add");
+        if (op == "-") return Builder.CreateSub(left, right, "uint_sub");
+        if (op == "*") return Builder.CreateMul(left, right, "uint_mul");
+        if (op == "/") return Builder.CreateUDiv(left, right, "uint_div");
+        if (op == "%") return Builder.CreateURem(left, right, "uint_mod");
+        else return logError("Unsupported operation '" + op + "' with " + type->str() + " type.");
+    }
+    if (is_integer(type->vlang_type())) {
+        if (op == "+") return Builder.CreateNSWAdd(left, right, "int_add");
+        if (op == "-") return Builder.CreateNSWSub(left, right, "int_sub");
+        if (op == "*") return Builder.CreateNSWMul(left, right, "int_mul");
+        if (op == "/") return Builder.CreateSDiv(left, right, "int_div");
+        if (op == "%") return Builder.CreateSRem(left, right, "int_mod");
+        else return logError("Unsupported operation '" + op + "' with " + type->str() + " type.");
+    }
     switch (type->vlang_type()) {
-        case VLANG_TYPE::INT32:
-            if (op == "+") return Builder.CreateAdd(left, right, "int_add");
-            if (op == "-") return Builder.CreateSub(left, right, "int_sub");
-            if (op == "*") return Builder.CreateMul(left, right, "int_mul");
-            if (op == "/") return Builder.CreateUDiv(left, right, "int_div");
-            if (op == "%") return Builder.CreateSRem(left, right, "int_mod");
-            else return logError("Unsupported operation '" + op + "' with int type.");
         case VLANG_TYPE::DOUBLE:
             if (op == "+") return Builder.CreateFAdd(left, right, "double_add");
             if (op == "-") return Builder.CreateFSub(left, right, "double_sub");
@@ -187,56 +344,814 @@ bool BinaryExprAST::is_relational() const {
     else return false;
 }
 
+// Returns the length (i64) of a string value, decoding the inline representation:
+// if the sign bit of length is set, the length is stored in the top byte (see lib/vlang.h).
+// Bit 62 of length marks heap strings and isn't a part of the length.
+Value* createStringLength(Value* str) {
+    Value* length = Builder.CreateExtractValue(str, 1, "str_len_field");
+    Value* isInline = Builder.CreateICmpSLT(length, LLVM_INT_SIZE(64, 0), "str_is_inline");
+    Value* inlineLength = Builder.CreateAnd(Builder.CreateLShr(length, 56), LLVM_INT_SIZE(64, 0x7f), "str_inline_len");
+    Value* heapLength = Builder.CreateAnd(length, LLVM_INT_SIZE(64, ~(1ULL << 62)), "str_heap_len");
+    return Builder.CreateSelect(isInline, inlineLength, heapLength, "str_len");
+}
+
+// Returns true if given expression is a number formatted into a string: x.to_string()
+static bool isNumberToString(const ExprAST* expr) {
+    if (expr->exp_type() != EXP_TYPE::METHOD_EXP) return false;
+    const MethodCallExprAST* call = static_cast<const MethodCallExprAST*>(expr);
+    VLANG_TYPE type = call->object()->type()->vlang_type();
+    return call->method() == "to_string" && (is_integer(type) || type == VLANG_TYPE::DOUBLE);
+}
+
+// Collects operands of a string + chain (left to right): "(" + x.to_string() + ")" has 3 parts.
+static void collectConcatParts(const ExprAST* expr, std::vector<const ExprAST*>& parts) {
+    if (expr->exp_type() == EXP_TYPE::BINARY_EXP) {
+        const BinaryExprAST* bin = static_cast<const BinaryExprAST*>(expr);
+        if (bin->operation() == "+" && bin->type()->vlang_type() == VLANG_TYPE::STRING) {
+            collectConcatParts(bin->left(), parts);
+            collectConcatParts(bin->right(), parts);
+            return;
+        }
+    }
+    parts.push_back(expr);
+}
+
+// Builds a string out of a + chain (or a single to_string()) with one allocation:
+// lengths of all parts are summed up first (numbers by their maximal formatted length),
+// then each part is written straight into the buffer.
+Value* createStringConcat(const ExprAST* expr) {
+    Type* i64 = Type::getInt64Ty(TheContext);
+    Type* bufTy = Type::getInt8PtrTy(TheContext);
+
+    std::vector<const ExprAST*> parts;
+    collectConcatParts(expr, parts);
+
+    // Evaluate parts and compute the capacity
+    std::vector<Value*> values;
+    std::vector<const char*> appenders;
+    Temporaries temporaries;
+    Value* capacity = LLVM_INT_SIZE(64, 0);
+    for (auto &part : parts) {
+        const ExprAST* valueExpr = isNumberToString(part) ? static_cast<const MethodCallExprAST*>(part)->object() : part;
+        Value* val = CreateOperand(valueExpr, temporaries);
+        if (val == nullptr) return logError("Failed part->codegen() in createStringConcat()");
+
+        Value* length = nullptr;
+        if (val->getType()->isDoubleTy()) {
+            length = LLVM_INT_SIZE(64, 14);     // "%g" never takes more than 13 characters
+        } else if (val->getType()->isIntegerTy()) {
+            // Narrower unsigned values fit into int64, only uint64 needs the unsigned functions
+            bool isUnsigned = is_unsigned(valueExpr->type()->vlang_type());
+            bool isUInt64 = valueExpr->type()->vlang_type() == VLANG_TYPE::UINT64;
+            val = CreateNumericCast(val, i64, isUnsigned);
+            Function* digits = GetRuntimeFunction(isUInt64 ? "vlang_uint_string_length" : "vlang_int_string_length",
+                                                  FunctionType::get(i64, { i64 }, false));
+            digits->setDoesNotAccessMemory();
+            length = Builder.CreateCall(digits, { val }, "int_str_len");
+            appenders.push_back(isUInt64 ? "vlang_concat_uint" : "vlang_concat_int");
+        } else {
+            length = createStringLength(val);
+        }
+        if (appenders.size() == values.size())
+            appenders.push_back(val->getType()->isDoubleTy() ? "vlang_concat_double" : "vlang_concat_str");
+        values.push_back(val);
+        capacity = Builder.CreateAdd(capacity, length, "concat_cap");
+    }
+
+    Function* begin = GetRuntimeFunction("vlang_concat_begin", FunctionType::get(bufTy, { i64 }, false));
+    Value* buf = Builder.CreateCall(begin, { capacity }, "concat_buf");
+    Value* cursor = buf;
+    for (unsigned i = 0; i < values.size(); ++i) {
+        Type* params[] = { bufTy, values[i]->getType() };
+        Function* f = GetRuntimeFunction(appenders[i], FunctionType::get(bufTy, params, false));
+        Value* args[] = { cursor, values[i] };
+        cursor = Builder.CreateCall(f, args, "concat_pos");
+    }
+
+    Type* params[] = { bufTy, bufTy, i64 };
+    Function* end = GetRuntimeFunction("vlang_concat_end", FunctionType::get(GetStringStructType(), params, false));
+    Value* args[] = { buf, cursor, capacity };
+    Value* res = Builder.CreateCall(end, args, "concat");
+    ReleaseTemporaries(temporaries);
+    return res;
+}
+
 Value* BinaryExprAST::codegen() const {
     if (m_op == "=") {
-        Value* assignMe = m_right->codegen();
+        // Variables and fields own their values
+        VLANG_TYPE leftType = m_left->type()->vlang_type();
+        bool managed = is_managed(leftType);
+        bool isUnsigned = is_unsigned(m_right->type()->vlang_type());
+        Value* assignMe = managed ? CreateOwnedValue(m_right) : m_right->codegen();
         if (! assignMe) return logError("Failed m_right->codegen() in BinaryExprAST::codegen()");
+        if (m_left->exp_type() == EXP_TYPE::LANE_EXP) {
+            // v[i] = x replaces one lane of the vector variable
+            const LaneExprAST* lane = static_cast<LaneExprAST*>(m_left);
+            if (lane->vector()->exp_type() != EXP_TYPE::VARIABLE_EXP) return logError("Lanes can be assigned only to vector variables!");
+            std::string name = static_cast<const VariableExprAST*>(lane->vector())->name();
+            Value* addr = getVariableAddress(name);
+            if (addr == nullptr) return logError("Unknown variable: '" + name + "'");
+            Value* index = lane->index()->codegen();
+            if (index == nullptr) return logError("Failed lane->index()->codegen() in BinaryExprAST::codegen()");
+            index = CreateNumericCast(index, LLVM_INTTY(), is_unsigned(lane->index()->type()->vlang_type()));
+            Value* vec = Builder.CreateLoad(addr, name);
+            vec = Builder.CreateInsertElement(vec, CreateNumericCast(assignMe, vec->getType()->getScalarType(), isUnsigned), index, "lane_set");
+            return Builder.CreateStore(vec, addr);
+        }
+        if (m_left->exp_type() == EXP_TYPE::INDEX_EXP) {
+            Value* addr = static_cast<ArrayIndexExprAST*>(m_left)->address();
+            if (addr == nullptr) return logError("Failed computing element address in BinaryExprAST::codegen()");
+            return Builder.CreateStore(CreateNumericCast(assignMe, addr->getType()->getPointerElementType(), isUnsigned), addr);
+        }
+        if (m_left->exp_type() == EXP_TYPE::FIELD_EXP) {
+            Value* addr = static_cast<FieldExprAST*>(m_left)->address();
+            if (addr == nullptr) return logError("Failed computing field address in BinaryExprAST::codegen()");
+            if (managed) return CreateOwnedStore(assignMe, addr, leftType);
+            return Builder.CreateStore(CreateNumericCast(assignMe, addr->getType()->getPointerElementType(), isUnsigned), addr);
+        }
         if (m_left->exp_type() != EXP_TYPE::VARIABLE_EXP) return logError("Bad left operand in assignment, it isnt a variable!");
         VariableExprAST* var = static_cast<VariableExprAST*>(m_left);
 
-        // Check if it's a local variable
-        auto localFinder = NamedValues.find(var->name());
-        if (localFinder != NamedValues.end())
-            return Builder.CreateStore(assignMe, localFinder->second);
-
-        // Check if global
-        auto globalFinder = GlobalValues.find(var->name());
-        if (globalFinder != GlobalValues.end()) return Builder.CreateStore(assignMe, globalFinder->second);
-
-        return logError("Failed assigning to variable '" + var->name() + "'");
+        // Local or global variable
+        Value* addr = getVariableAddress(var->name());
+        if (addr == nullptr) return logError("Failed assigning to variable '" + var->name() + "'");
+        if (managed) return CreateOwnedStore(assignMe, addr, leftType);
+        return Builder.CreateStore(CreateNumericCast(assignMe, addr->getType()->getPointerElementType(), isUnsigned), addr);
     }
-    Value* left = m_left->codegen();
-    Value* right = m_right->codegen();
+    // Whole chains of string + are built at once
+    if (m_op == "+" && type()->vlang_type() == VLANG_TYPE::STRING)
+        return createStringConcat(this);
+
+    Temporaries temporaries;
+    Value* left = CreateOperand(m_left, temporaries);
+    Value* right = CreateOperand(m_right, temporaries);
     if (left == nullptr) return logError("Failed m_left->codegen() in BinaryExprAST::codegen()");
     if (right == nullptr) return logError("Failed m_right->codegen() in BinaryExprAST::codegen()");
 
+    // Operands of different types (int + double) are converted into the stronger type
+    Type* operandType = operand_type()->llvm_type();
+    left = CreateNumericCast(left, operandType, is_unsigned(m_left->type()->vlang_type()));
+    right = CreateNumericCast(right, operandType, is_unsigned(m_right->type()->vlang_type()));
+
     Value* tmp = nullptr;
     if (is_arithmetic())
-        tmp = handleArithmeticOperation(m_op, left, right, type());
+        tmp = handleArithmeticOperation(m_op, left, right, operand_type());
     else if (is_relational())
-        tmp = handleRelationalOperation(m_op, left, right, type());
+        tmp = handleRelationalOperation(m_op, left, right, operand_type());
+    ReleaseTemporaries(temporaries);
     return tmp;
 }
 
+// Calls given function, arguments are converted into types of parameters (int -> double...).
+// argExprs are the expressions of the last arguments (the receiver of a method has none), their
+// signedness picks the conversion.
+Value* createCallWithCasts(Function* f, std::vector<Value*> args, const std::vector<ExprAST*>& argExprs) {
+    if (args.size() != f->arg_size()) return logError("Wrong number of arguments calling " + f->getName().str());
+    unsigned i = 0;
+    unsigned firstExpr = args.size() - argExprs.size();
+    for (auto &param : f->args()) {
+        bool isUnsigned = i >= firstExpr && is_unsigned(argExprs[i - firstExpr]->type()->vlang_type());
+        args[i] = CreateNumericCast(args[i], param.getType(), isUnsigned);
+        ++i;
+    }
+    if (f->getReturnType()->isVoidTy())
+        return Builder.CreateCall(f, args);
+    return Builder.CreateCall(f, args, "calltmp");
+}
+
+// Math functions (GLib.Math) and intrinsics they are lowered to, so LLVM can constant fold
+// them, vectorize them and (with --fp-model) fuse or reassociate them.
+static const std::map<std::string, std::pair<Intrinsic::ID, int>> MathIntrinsics = {
+    { "Math.sqrt",     { Intrinsic::sqrt, 1 } },
+    { "Math.fabs",     { Intrinsic::fabs, 1 } },
+    { "Math.floor",    { Intrinsic::floor, 1 } },
+    { "Math.ceil",     { Intrinsic::ceil, 1 } },
+    { "Math.round",    { Intrinsic::round, 1 } },
+    { "Math.trunc",    { Intrinsic::trunc, 1 } },
+    { "Math.sin",      { Intrinsic::sin, 1 } },
+    { "Math.cos",      { Intrinsic::cos, 1 } },
+    { "Math.exp",      { Intrinsic::exp, 1 } },
+    { "Math.exp2",     { Intrinsic::exp2, 1 } },
+    { "Math.log",      { Intrinsic::log, 1 } },
+    { "Math.log2",     { Intrinsic::log2, 1 } },
+    { "Math.log10",    { Intrinsic::log10, 1 } },
+    { "Math.pow",      { Intrinsic::pow, 2 } },
+    { "Math.fmin",     { Intrinsic::minnum, 2 } },
+    { "Math.fmax",     { Intrinsic::maxnum, 2 } },
+    { "Math.copysign", { Intrinsic::copysign, 2 } },
+    { "Math.fma",      { Intrinsic::fma, 3 } },
+};
+
+int MathFunctionArity(const std::string& name) {
+    auto finder = MathIntrinsics.find(name);
+    return finder == MathIntrinsics.end() ? -1 : finder->second.second;
+}
+
+// Math functions take doubles, int arguments are converted.
+static Value* createMathCall(const std::string& name, const std::vector<ExprAST*>& args) {
+    auto finder = MathIntrinsics.find(name);
+    if (finder == MathIntrinsics.end()) return logError("Unknown function " + name);
+    if ((int)args.size() != finder->second.second) return logError("Wrong number of arguments calling " + name);
+    std::vector<Value*> values;
+    for (auto &arg : args) {
+        Value* val = arg->codegen();
+        if (val == nullptr) return logError("Failed argument of " + name);
+        values.push_back(CreateNumericCast(val, LLVM_DOUBLETY(), is_unsigned(arg->type()->vlang_type())));
+    }
+    Function* intrinsic = Intrinsic::getDeclaration(TheModule.get(), finder->second.first, { LLVM_DOUBLETY() });
+    return Builder.CreateCall(intrinsic, values, name.substr(5));
+}
+
 Value* FunctionCallExprAST::codegen() const {
+    // Evaluated at compile time
+    auto value = ConstantCalls.find(this);
+    if (value != ConstantCalls.end()) return value->second->codegen();
+
+    if (m_name.compare(0, 5, "Math.") == 0)
+        return createMathCall(m_name, m_args);
     Function* f = GetFunction(m_name);
     if (f == nullptr) return logError("Failed finding function " + m_name);
     if (m_args.size() != f->arg_size()) return logError("Wrong number of arguments!");
 
-    // Create arguments
+    // Create arguments, they are borrowed by the callee
     std::vector<Value*> args;
-    for (auto & arg : m_args) args.push_back(arg->codegen());
-    if (m_retType == VLANG_TYPE::VOID)
-        return Builder.CreateCall(f, args);
-    else
-        return Builder.CreateCall(f, args, "calltmp");
+    Temporaries temporaries;
+    for (auto & arg : m_args) {
+        Value* val = CreateOperand(arg, temporaries);
+        if (val == nullptr) return logError("Failed m_args[i]->codegen() in FunctionCallExprAST::codegen()");
+        args.push_back(val);
+    }
+    Value* res = createCallWithCasts(f, args, m_args);
+    ReleaseTemporaries(temporaries);
+    return res;
 }
 
 Value* BoolExprAST::codegen() const {
     return LLVM_BOOL(m_val);
 }
 
+// Allocates an array (through vlang runtime) with given length (i64) of given element type.
+Value* createArrayAllocation(Type* elementType, Value* length) {
+    Type* i64 = Type::getInt64Ty(TheContext);
+    Type* params[] = { i64, i64 };
+    Function* arrayNew = GetRuntimeFunction("vlang_array_new",
+            FunctionType::get(Type::getInt8PtrTy(TheContext), params, false));
+    Value* args[] = { length, ConstantExpr::getSizeOf(elementType) };
+    Value* raw = Builder.CreateCall(arrayNew, args, "array_raw");
+    return Builder.CreateBitCast(raw, GetArrayStructType(elementType)->getPointerTo(), "array");
+}
+
+// Returns the address of array length field.
+Value* createArrayLengthAddress(Value* array) {
+    return Builder.CreateStructGEP(nullptr, array, 0, "length_addr");
+}
+
+Value* ArrayNewExprAST::codegen() const {
+    Value* size = m_size->codegen();
+    if (size == nullptr) return logError("Failed m_size->codegen() in ArrayNewExprAST::codegen()");
+    size = CreateNumericCast(size, Type::getInt64Ty(TheContext), is_unsigned(m_size->type()->vlang_type()));
+    std::unique_ptr<VlangType> elem(make_from_enum(m_elementType));
+    return createArrayAllocation(elem->llvm_type(), size);
+}
+
+Value* ArrayLiteralExprAST::codegen() const {
+    Type* elementType = make_from_enum(element_type())->llvm_type();
+    Value* array = createArrayAllocation(elementType, LLVM_INT_SIZE(64, m_elements.size()));
+
+    for (unsigned i = 0; i < m_elements.size(); ++i) {
+        Value* val = m_elements[i]->codegen();
+        if (val == nullptr) return logError("Failed m_elements[i]->codegen() in ArrayLiteralExprAST::codegen()");
+        Value* idx[] = { LLVM_INT_SIZE(64, 0), LLVM_INT(2), LLVM_INT_SIZE(64, i) };
+        Value* addr = Builder.CreateInBoundsGEP(array, idx, "elem_addr");
+        Builder.CreateStore(CreateNumericCast(val, elementType, is_unsigned(m_elements[i]->type()->vlang_type())), addr);
+    }
+    return array;
+}
+
+// Continues in a new block if inBounds holds, otherwise aborts through vlang runtime.
+static void createBoundsCheck(Value* inBounds, Value* index, Value* length) {
+    Function* TheFunction = Builder.GetInsertBlock()->getParent();
+    BasicBlock* okBB = BasicBlock::Create(TheContext, "bounds_ok", TheFunction);
+    BasicBlock* failBB = BasicBlock::Create(TheContext, "bounds_fail", TheFunction);
+    MDBuilder md(TheContext);
+    Builder.CreateCondBr(inBounds, okBB, failBB, md.createBranchWeights(1 << 20, 1));
+
+    Builder.SetInsertPoint(failBB);
+    Type* params[] = { Type::getInt64Ty(TheContext), Type::getInt64Ty(TheContext) };
+    Function* boundsFail = GetRuntimeFunction("vlang_array_bounds_fail",
+            FunctionType::get(LLVM_VOIDTY(), params, false));
+    boundsFail->setDoesNotReturn();
+    boundsFail->addFnAttr(Attribute::Cold);
+    Value* args[] = { index, length };
+    Builder.CreateCall(boundsFail, args);
+    Builder.CreateUnreachable();
+
+    Builder.SetInsertPoint(okBB);
+}
+
+Value* ArrayIndexExprAST::address() const {
+    Value* arrayAddr = getVariableAddress(m_name);
+    if (arrayAddr == nullptr) return logError("Unknown array: '" + m_name + "'");
+    Value* array = Builder.CreateLoad(arrayAddr, m_name);
+
+    Value* index = m_index->codegen();
+    if (index == nullptr) return logError("Failed m_index->codegen() in ArrayIndexExprAST::address()");
+    index = CreateNumericCast(index, Type::getInt64Ty(TheContext), is_unsigned(m_index->type()->vlang_type()));
+
+    if (! IsProvenInBounds(m_name, m_index)) {
+        // Unsigned comparison covers negative indices as well
+        Value* length = Builder.CreateLoad(createArrayLengthAddress(array), "length");
+        createBoundsCheck(Builder.CreateICmpULT(index, length, "in_bounds"), index, length);
+    }
+
+    Value* idx[] = { LLVM_INT_SIZE(64, 0), LLVM_INT(2), index };
+    return Builder.CreateInBoundsGEP(array, idx, "elem_addr");
+}
+
+Value* ArrayIndexExprAST::codegen() const {
+    Value* addr = address();
+    if (addr == nullptr) return logError("Failed address() in ArrayIndexExprAST::codegen()");
+    return Builder.CreateLoad(addr, m_name + "_elem");
+}
+
+Value* ArrayLengthExprAST::codegen() const {
+    Value* arrayAddr = getVariableAddress(m_name);
+    if (arrayAddr == nullptr) return logError("Unknown array: '" + m_name + "'");
+    Value* array = Builder.CreateLoad(arrayAddr, m_name);
+    Value* length = Builder.CreateLoad(createArrayLengthAddress(array), "length");
+    return Builder.CreateTrunc(length, LLVM_INTTY(), "length_int");
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// SIMD vectors
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// Alignment of vector loads and stores. Array data is 16 byte aligned, so aligned accesses
+// (index is a multiple of lanes, all vectors are at least 16 bytes) can rely on 16 bytes,
+// other ones only on the alignment of lanes.
+static unsigned vectorAccessAlignment(Type* vectorType, bool aligned) {
+    return aligned ? 16 : vectorType->getScalarSizeInBits() / 8;
+}
+
+// Returns the address of array[index] ... array[index + lanes - 1] as a vector pointer. All lanes
+// are checked with one comparison, aligned accesses also check the index is a multiple of lanes.
+static Value* createVectorAddress(Value* array, Value* index, Type* vectorType, unsigned lanes, bool aligned) {
+    Value* length = Builder.CreateLoad(createArrayLengthAddress(array), "length");
+    // index < length keeps index + lanes from overflowing
+    Value* first = Builder.CreateICmpULT(index, length, "first_in_bounds");
+    Value* last = Builder.CreateICmpULE(Builder.CreateAdd(index, LLVM_INT_SIZE(64, lanes)), length, "last_in_bounds");
+    Value* inBounds = Builder.CreateAnd(first, last, "in_bounds");
+    if (aligned) {
+        Value* misalignment = Builder.CreateAnd(index, LLVM_INT_SIZE(64, lanes - 1), "misalignment");
+        inBounds = Builder.CreateAnd(inBounds, Builder.CreateICmpEQ(misalignment, LLVM_INT_SIZE(64, 0)), "in_bounds_aligned");
+    }
+    createBoundsCheck(inBounds, index, length);
+
+    Value* idx[] = { LLVM_INT_SIZE(64, 0), LLVM_INT(2), index };
+    Value* addr = Builder.CreateInBoundsGEP(array, idx, "elem_addr");
+    return Builder.CreateBitCast(addr, vectorType->getPointerTo(), "vec_addr");
+}
+
+Value* VectorExprAST::codegen() const {
+    Type* vectorType = m_type->llvm_type();
+    if (m_op == "load" || m_op == "load_aligned") {
+        Temporaries temporaries;
+        Value* array = CreateOperand(m_args[0], temporaries);
+        Value* index = m_args[1]->codegen();
+        if (array == nullptr || index == nullptr) return logError("Failed m_args[i]->codegen() in VectorExprAST::codegen()");
+        index = CreateNumericCast(index, Type::getInt64Ty(TheContext), is_unsigned(m_args[1]->type()->vlang_type()));
+        bool aligned = m_op == "load_aligned";
+        Value* addr = createVectorAddress(array, index, vectorType, vector_lanes(m_type->vlang_type()), aligned);
+        LoadInst* load = Builder.CreateLoad(addr, "vec_load");
+        load->setAlignment(vectorAccessAlignment(vectorType, aligned));
+        ReleaseTemporaries(temporaries);
+        return load;
+    }
+
+    // A single value is splatted, otherwise lanes are inserted one by one
+    std::vector<Value*> lanes;
+    for (auto &arg : m_args) {
+        Value* val = arg->codegen();
+        if (val == nullptr) return logError("Failed m_args[i]->codegen() in VectorExprAST::codegen()");
+        lanes.push_back(CreateNumericCast(val, vectorType->getScalarType(), is_unsigned(arg->type()->vlang_type())));
+    }
+    if (lanes.size() == 1)
+        return CreateNumericCast(lanes[0], vectorType);
+    Value* res = UndefValue::get(vectorType);
+    for (unsigned i = 0; i < lanes.size(); ++i)
+        res = Builder.CreateInsertElement(res, lanes[i], LLVM_INT(i), "vec_init");
+    return res;
+}
+
+Value* LaneExprAST::codegen() const {
+    Value* vec = m_vector->codegen();
+    Value* index = m_index->codegen();
+    if (vec == nullptr || index == nullptr) return logError("Failed codegen() of operands in LaneExprAST::codegen()");
+    index = CreateNumericCast(index, LLVM_INTTY(), is_unsigned(m_index->type()->vlang_type()));
+    return Builder.CreateExtractElement(vec, index, "lane");
+}
+
+std::string CheckVectorMethod(VLANG_TYPE type, const std::string& method, const std::vector<ExprAST*>& args) {
+    unsigned lanes = vector_lanes(type);
+    if (method == "sum" || method == "min" || method == "max")
+        return args.empty() ? "" : method + "() takes no arguments";
+    if (method == "store" || method == "store_aligned") {
+        if (args.size() != 2 || args[0]->type()->vlang_type() != array_of(vector_element(type))
+                || ! is_integer(args[1]->type()->vlang_type()))
+            return method + "() of " + to_str(type) + " takes an array of " + to_str(vector_element(type))
+                   + " and an index";
+        return "";
+    }
+    if (method == "shuffle") {
+        // v.shuffle(3, 2, 1, 0) permutes lanes of v, a.shuffle(b, 0, 4, 1, 5) picks lanes of
+        // both vectors (lanes of b follow lanes of a)
+        unsigned sources = ! args.empty() && args[0]->type()->vlang_type() == type ? 2 : 1;
+        if (args.size() != lanes + sources - 1)
+            return "shuffle() of " + to_str(type) + " takes " + std::to_string(lanes) + " lane indices";
+        for (unsigned i = sources - 1; i < args.size(); ++i) {
+            if (args[i]->exp_type() != EXP_TYPE::INT_EXP)
+                return "lane indices of shuffle() have to be integer constants";
+            long long lane = static_cast<const ConstIntExprAST*>(args[i])->val();
+            if (lane < 0 || lane >= (long long)(lanes * sources))
+                return "lane index " + std::to_string(lane) + " of shuffle() is out of range";
+        }
+        return "";
+    }
+    return "unknown method '" + method + "' of " + to_str(type);
+}
+
+// Horizontal reductions add (or compare) the upper half of the vector to the lower one until a
+// single lane is left. The order is fixed, so double sums don't depend on the target.
+static Value* createVectorReduction(const std::string& method, Value* vec, VLANG_TYPE type) {
+    unsigned lanes = vector_lanes(type);
+    bool isDouble = vector_element(type) == VLANG_TYPE::DOUBLE;
+    for (unsigned width = lanes / 2; width > 0; width /= 2) {
+        std::vector<Constant*> mask;
+        for (unsigned i = 0; i < lanes; ++i)
+            mask.push_back(i < width ? cast<Constant>(LLVM_INT(i + width)) : UndefValue::get(LLVM_INTTY()));
+        Value* upper = Builder.CreateShuffleVector(vec, UndefValue::get(vec->getType()), ConstantVector::get(mask), "upper");
+        if (method == "sum") {
+            vec = isDouble ? Builder.CreateFAdd(vec, upper, "sum") : Builder.CreateAdd(vec, upper, "sum");
+        } else {
+            Value* less = isDouble ? Builder.CreateFCmpOLT(vec, upper, "lt") : Builder.CreateICmpSLT(vec, upper, "lt");
+            vec = method == "min" ? Builder.CreateSelect(less, vec, upper, "min")
+                                  : Builder.CreateSelect(less, upper, vec, "max");
+        }
+    }
+    return Builder.CreateExtractElement(vec, LLVM_INT(0), method);
+}
+
+// Methods of vectors, arguments are already checked by CheckVectorMethod().
+static Value* createVectorMethod(const std::string& method, Value* vec, VLANG_TYPE type,
+                                 const std::vector<Value*>& args, const std::vector<ExprAST*>& argExprs) {
+    if (method == "sum" || method == "min" || method == "max")
+        return createVectorReduction(method, vec, type);
+    if (method == "shuffle") {
+        bool twoSources = argExprs.size() > vector_lanes(type);
+        std::vector<Constant*> mask;
+        for (unsigned i = twoSources ? 1 : 0; i < argExprs.size(); ++i)
+            mask.push_back(cast<Constant>(LLVM_INT(static_cast<const ConstIntExprAST*>(argExprs[i])->val())));
+        Value* second = twoSources ? args[0] : UndefValue::get(vec->getType());
+        return Builder.CreateShuffleVector(vec, second, ConstantVector::get(mask), "shuffle");
+    }
+    if (method == "store" || method == "store_aligned") {
+        bool aligned = method == "store_aligned";
+        Value* index = CreateNumericCast(args[1], Type::getInt64Ty(TheContext), is_unsigned(argExprs[1]->type()->vlang_type()));
+        Value* addr = createVectorAddress(args[0], index, vec->getType(), vector_lanes(type), aligned);
+        StoreInst* store = Builder.CreateStore(vec, addr);
+        store->setAlignment(vectorAccessAlignment(vec->getType(), aligned));
+        return store;
+    }
+    return nullptr;
+}
+
+VLANG_TYPE MethodReturnType(VLANG_TYPE objectType, const std::string& method) {
+    if (objectType == VLANG_TYPE::STRING) {
+        if (method == "length") return VLANG_TYPE::INT32;
+        if (method == "substring") return VLANG_TYPE::STRING;
+    }
+    if (is_class(objectType)) {
+        const ClassAST* c = GetClass(objectType);
+        return c == nullptr ? VLANG_TYPE::UNKNOWN : c->method_type(method);
+    }
+    if (is_vector(objectType)) {
+        if (method == "sum" || method == "min" || method == "max") return vector_element(objectType);
+        if (method == "shuffle") return objectType;
+        if (method == "store" || method == "store_aligned") return VLANG_TYPE::VOID;
+    }
+    if (method == "to_string" && (is_integer(objectType) || objectType == VLANG_TYPE::DOUBLE))
+        return VLANG_TYPE::STRING;
+    return VLANG_TYPE::UNKNOWN;
+}
+
+Value* MethodCallExprAST::codegen() const {
+    // Numbers are formatted inline, to_string() of objects is an ordinary method
+    if (isNumberToString(this))
+        return createStringConcat(this);
+
+    Temporaries temporaries;
+    Value* object = CreateOperand(m_object, temporaries);
+    if (object == nullptr) return logError("Failed m_object->codegen() in MethodCallExprAST::codegen()");
+
+    std::vector<Value*> args;
+    for (auto &arg : m_args) {
+        Value* val = CreateOperand(arg, temporaries);
+        if (val == nullptr) return logError("Failed m_args[i]->codegen() in MethodCallExprAST::codegen()");
+        args.push_back(val);
+    }
+
+    Value* res = nullptr;
+    if (is_class(m_object->type()->vlang_type())) {
+        // Methods can't be overridden, so the call is always direct
+        const ClassAST* c = GetClass(m_object->type()->vlang_type());
+        Function* f = GetFunction(c->method_name(m_method));
+        if (f == nullptr) return logError("Failed finding method " + c->method_name(m_method));
+        args.insert(args.begin(), object);
+        res = createCallWithCasts(f, args, m_args);
+    } else if (m_object->type()->vlang_type() == VLANG_TYPE::STRING) {
+        if (m_method == "length")
+            res = Builder.CreateTrunc(createStringLength(object), LLVM_INTTY(), "length_int");
+        if (m_method == "substring") {
+            // Substrings of literals and inline strings are zero-copy slices
+            Type* i64 = Type::getInt64Ty(TheContext);
+            Type* params[] = { GetStringStructType(), i64, i64 };
+            Function* substring = GetRuntimeFunction("vlang_string_substring",
+                    FunctionType::get(GetStringStructType(), params, false));
+            Value* callArgs[] = {
+                object,
+                args.size() > 0 ? CreateNumericCast(args[0], i64) : LLVM_INT_SIZE(64, 0),
+                args.size() > 1 ? CreateNumericCast(args[1], i64) : LLVM_INT_SIZE(64, -1)
+            };
+            res = Builder.CreateCall(substring, callArgs, "substr");
+        }
+    } else if (is_vector(m_object->type()->vlang_type())) {
+        res = createVectorMethod(m_method, object, m_object->type()->vlang_type(), args, m_args);
+    }
+    if (res == nullptr) return logError("Unsupported method '" + m_method + "' on type " + m_object->type()->str());
+    ReleaseTemporaries(temporaries);
+    return res;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Objects
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+VLANG_TYPE FieldType(VLANG_TYPE classType, const std::string& field) {
+    const ClassAST* c = GetClass(classType);
+    const FieldDecl* f = c == nullptr ? nullptr : c->field(field);
+    return f == nullptr ? VLANG_TYPE::UNKNOWN : f->type;
+}
+
+Value* FieldExprAST::address() const {
+    const ClassAST* c = GetClass(m_object->type()->vlang_type());
+    if (c == nullptr || c->field(m_field) == nullptr) return logError("Unknown field '" + m_field + "'");
+    Value* object = m_object->codegen();
+    if (object == nullptr) return logError("Failed m_object->codegen() in FieldExprAST::address()");
+    return Builder.CreateStructGEP(nullptr, object, c->field_index(m_field), m_field + "_addr");
+}
+
+Value* FieldExprAST::codegen() const {
+    Value* addr = address();
+    if (addr == nullptr) return logError("Failed computing field address in FieldExprAST::codegen()");
+    return Builder.CreateLoad(addr, m_field);
+}
+
+Value* NewObjectExprAST::codegen() const {
+    const ClassAST* c = GetClass(m_type->vlang_type());
+    if (c == nullptr) return logError("Unknown class in NewObjectExprAST::codegen()");
+    StructType* structTy = c->llvm_type();
+
+    Value* object = nullptr;
+    if (StackAllocatedObjects.count(this)) {
+        // Object never escapes the function, so it lives in its stack frame (and usually gets
+        // scalar-replaced by the optimizer)
+        // Object created by the previous loop iteration is cleared first
+        Function* function = Builder.GetInsertBlock()->getParent();
+        AllocaInst* slot = GetEntryBlockAllocaForType(function, structTy, "stack_object");
+        RegisterStackObject(slot, c);
+        CreateReleaseFields(slot, c);
+        Builder.CreateStore(Constant::getNullValue(structTy), slot);
+        object = slot;
+    } else {
+        Type* i64 = Type::getInt64Ty(TheContext);
+        Function* objectNew = GetRuntimeFunction("vlang_object_new",
+                FunctionType::get(Type::getInt8PtrTy(TheContext), { i64 }, false));
+        Value* raw = Builder.CreateCall(objectNew, { ConstantExpr::getSizeOf(structTy) }, "object_raw");
+        object = Builder.CreateBitCast(raw, structTy->getPointerTo(), "object");
+    }
+
+    // Objects come zeroed, only fields with default values are initialized
+    for (auto &f : c->fields()) {
+        if (f.init == nullptr) continue;
+        Value* val = CreateOwnedValue(f.init);
+        if (val == nullptr) return logError("Failed default value of field '" + f.name + "'");
+        Value* addr = Builder.CreateStructGEP(nullptr, object, c->field_index(f.name), f.name + "_addr");
+        Builder.CreateStore(CreateNumericCast(val, addr->getType()->getPointerElementType(),
+                                              is_unsigned(f.init->type()->vlang_type())), addr);
+    }
+
+    if (c->constructor() == nullptr) {
+        if (! m_args.empty()) return logError("Class " + c->name() + " has no constructor with arguments");
+        return object;
+    }
+    std::vector<Value*> args = { object };
+    Temporaries temporaries;
+    for (auto &arg : m_args) {
+        Value* val = CreateOperand(arg, temporaries);
+        if (val == nullptr) return logError("Failed m_args[i]->codegen() in NewObjectExprAST::codegen()");
+        args.push_back(val);
+    }
+    Function* constructor = GetFunction(c->constructor()->name());
+    if (constructor == nullptr) return logError("Failed finding constructor of " + c->name());
+    if (createCallWithCasts(constructor, args, m_args) == nullptr) return nullptr;
+    ReleaseTemporaries(temporaries);
+    return object;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// stdout.printf
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+bool ParseFormatString(const std::string& format, std::vector<FormatSegment>& segments, std::string& error) {
+    std::string text;
+    for (unsigned i = 0; i < format.size(); ++i) {
+        if (format[i] != '%') {
+            text += format[i];
+            continue;
+        }
+        // Length modifiers (%ld, %lld, %hhd) don't matter, all ints are written as 64 bit
+        unsigned j = i + 1;
+        while (j < format.size() && (format[j] == 'l' || format[j] == 'h')) ++j;
+        if (j == format.size()) {
+            error = "format ends with '%'";
+            return false;
+        }
+        char conv = format[j];
+        if (conv == '%') {
+            text += '%';
+        } else if (std::string("diufegs").find(conv) != std::string::npos) {
+            if (! text.empty()) segments.push_back({ 0, text });
+            text.clear();
+            segments.push_back({ conv == 'i' ? 'd' : conv, format.substr(i, j - i + 1) });
+        } else {
+            error = "unsupported conversion '" + format.substr(i, j - i + 1) + "'";
+            return false;
+        }
+        i = j;
+    }
+    if (! text.empty()) segments.push_back({ 0, text });
+    return true;
+}
+
+// Returns true if a value of given type can be written with given conversion.
+static bool isFormatCompatible(char conversion, VLANG_TYPE type) {
+    switch (conversion) {
+        // uint8 ... uint32 fit into int64, so they can be written as signed
+        case 'd':           return is_integer(type) && type != VLANG_TYPE::UINT64;
+        case 'u':           return is_unsigned(type);
+        case 'e': case 'f':
+        case 'g':           return type == VLANG_TYPE::DOUBLE;
+        case 's':           return type == VLANG_TYPE::STRING;
+        default:            return false;
+    }
+}
+
+std::string PrintfExprAST::checkFormat() const {
+    if (m_args.empty()) return "stdout.printf() requires a format";
+    if (m_args[0]->type()->vlang_type() != VLANG_TYPE::STRING) return "format of stdout.printf() must be a string";
+    if (m_args[0]->exp_type() != EXP_TYPE::STRING_EXP)
+        return m_args.size() == 1 ? "" : "format of stdout.printf() with arguments must be a string literal";
+
+    std::vector<FormatSegment> segments;
+    std::string error;
+    if (! ParseFormatString(UnescapeString(static_cast<StringExprAST*>(m_args[0])->val()), segments, error))
+        return error;
+
+    unsigned arg = 1;
+    for (auto &segment : segments) {
+        if (segment.conversion == 0) continue;
+        if (arg == m_args.size())
+            return "missing argument for '" + segment.text + "'";
+        if (! isFormatCompatible(segment.conversion, m_args[arg]->type()->vlang_type()))
+            return "'" + segment.text + "' expects a different type than " + m_args[arg]->type()->str()
+                 + " of argument " + std::to_string(arg);
+        ++arg;
+    }
+    if (arg != m_args.size()) return "too many arguments for format";
+    return "";
+}
+
+// Emits a call to one of vlang_out_* runtime functions.
+static Value* createOutCall(const std::string& name, std::vector<Value*> args) {
+    std::vector<Type*> params;
+    for (auto &arg : args) params.push_back(arg->getType());
+    Function* f = GetRuntimeFunction(name, FunctionType::get(Type::getVoidTy(TheContext), params, false));
+    return Builder.CreateCall(f, args);
+}
+
+Value* PrintfExprAST::codegen() const {
+    std::string error = checkFormat();
+    if (! error.empty()) return logError("Bad stdout.printf(): " + error);
+
+    // Non literal format is just written out
+    if (m_args[0]->exp_type() != EXP_TYPE::STRING_EXP) {
+        Temporaries temporaries;
+        Value* str = CreateOperand(m_args[0], temporaries);
+        if (str == nullptr) return logError("Failed m_args[0]->codegen() in PrintfExprAST::codegen()");
+        Value* res = createOutCall("vlang_out_str", { str });
+        ReleaseTemporaries(temporaries);
+        return res;
+    }
+
+    std::vector<FormatSegment> segments;
+    ParseFormatString(UnescapeString(static_cast<StringExprAST*>(m_args[0])->val()), segments, error);
+
+    // Arguments are evaluated before anything is written
+    std::vector<Value*> values;
+    Temporaries temporaries;
+    for (unsigned i = 1; i < m_args.size(); ++i) {
+        Value* val = CreateOperand(m_args[i], temporaries);
+        if (val == nullptr) return logError("Failed m_args[i]->codegen() in PrintfExprAST::codegen()");
+        values.push_back(val);
+    }
+
+    Value* last = LLVM_BOOL(true);
+    unsigned arg = 0;
+    for (auto &segment : segments) {
+        switch (segment.conversion) {
+            case 0: {
+                Constant* literal = GetStringLiteral(segment.text);
+                last = createOutCall("vlang_out_write", { Builder.CreateExtractValue(literal, 0),
+                                                          Builder.CreateExtractValue(literal, 1) });
+                break;
+            }
+            case 'd':
+            case 'u': {
+                bool isUnsigned = is_unsigned(m_args[arg + 1]->type()->vlang_type());
+                Value* val = CreateNumericCast(values[arg++], Type::getInt64Ty(TheContext), isUnsigned);
+                last = createOutCall(segment.conversion == 'u' ? "vlang_out_uint" : "vlang_out_int", { val });
+                break;
+            }
+            case 's':
+                last = createOutCall("vlang_out_str", { values[arg++] });
+                break;
+            default:
+                last = createOutCall("vlang_out_double", { values[arg++], LLVM_INT_SIZE(8, segment.conversion) });
+                break;
+        }
+    }
+    ReleaseTemporaries(temporaries);
+    return last;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Range analysis (bounds check elimination)
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+std::map<std::string, long long> ArrayStaticLength;
+std::map<std::string, InductionRange> InductionRanges;
+std::set<const ExprAST*> StackAllocatedObjects;
+std::map<const ExprAST*, std::unique_ptr<ExprAST>> ConstantCalls;
+
+bool IsProvenInBounds(const std::string& array, const ExprAST* index) {
+    auto staticLength = ArrayStaticLength.find(array);
+
+    // Constant index into array of known length
+    if (index->exp_type() == EXP_TYPE::INT_EXP) {
+        long long val = static_cast<const ConstIntExprAST*>(index)->val();
+        return staticLength != ArrayStaticLength.end() && val >= 0 && val < staticLength->second;
+    }
+
+    // Induction variable of an enclosing for loop
+    if (index->exp_type() == EXP_TYPE::VARIABLE_EXP) {
+        auto range = InductionRanges.find(static_cast<const VariableExprAST*>(index)->name());
+        if (range == InductionRanges.end() || range->second.lower < 0) return false;
+        if (range->second.boundArray == array) return true;
+        return range->second.boundConst >= 0 && staticLength != ArrayStaticLength.end()
+            && range->second.boundConst <= staticLength->second;
+    }
+    return false;
+}
+
+std::string UnescapeString(const std::string& raw) {
+    std::string res;
+    for (unsigned i = 0; i < raw.size(); ++i) {
+        if (raw[i] != '\\' || i + 1 == raw.size()) {
+            res += raw[i];
+            continue;
+        }
+        switch (raw[++i]) {
+            case 'n':   res += '\n'; break;
+            case 't':   res += '\t'; break;
+            case 'r':   res += '\r'; break;
+            case '0':   res += '\0'; break;
+            default:    res += raw[i]; break;       // \\, \", \'
+        }
+    }
+    return res;
+}
+
 std::pair<int, VLANG_TYPE> DetermineExpressionConversion(const ExprAST* left, const ExprAST* right) {
+    VLANG_TYPE common = common_type(left->type()->vlang_type(), right->type()->vlang_type());
+    if (common != VLANG_TYPE::UNKNOWN)
+        return std::pair<int, VLANG_TYPE>(common == left->type()->vlang_type() ? 2 : 1, common);
     if (left->type()->strength() > right->type()->strength()) {
         return std::pair<int, VLANG_TYPE>(2, left->type()->vlang_type());
     }
@@ -246,6 +1161,18 @@ std::pair<int, VLANG_TYPE> DetermineExpressionConversion(const ExprAST* left, co
 }
 
 const VlangType* BinaryExprAST::type() const {
+    static const BoolType boolType;
+    return is_relational() ? &boolType : operand_type();
+}
+
+// Numeric operands follow C conversions (int8 + int8 is int, int + uint is uint...), other
+// operands are converted into the stronger type.
+const VlangType* BinaryExprAST::operand_type() const {
+    static const Int32Type int32Type;
+    VLANG_TYPE common = common_type(m_left->type()->vlang_type(), m_right->type()->vlang_type());
+    if (common == m_left->type()->vlang_type()) return m_left->type();
+    if (common == m_right->type()->vlang_type()) return m_right->type();
+    if (common == VLANG_TYPE::INT32) return &int32Type;
     if (m_left->type() == m_right->type())
         return m_left->type();
     else {
@@ -284,13 +1211,48 @@ ExprAST* BinaryExprAST::promote(VLANG_TYPE) {
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 // Clone
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
-ExprAST* ConstIntExprAST::clone() const { return new ConstIntExprAST(m_val); }
+ExprAST* ConstIntExprAST::clone() const { return new ConstIntExprAST(m_val, m_type->vlang_type()); }
+ExprAST* CastExprAST::clone() const { return new CastExprAST(m_type->vlang_type(), m_expr->clone()); }
 ExprAST* ConstDoubleExprAST::clone() const { return new ConstDoubleExprAST(m_val); }
 ExprAST* BoolExprAST::clone() const { return new BoolExprAST(m_val); }
 ExprAST* StringExprAST::clone() const { return new StringExprAST(m_str); }
 ExprAST* VariableExprAST::clone() const { return new VariableExprAST(m_name); }
-ExprAST* UnaryExprAST::clone() const { return new UnaryExprAST(m_op, m_expr->clone()); }
+ExprAST* UnaryExprAST::clone() const { return new UnaryExprAST(m_op, m_expr->clone(), m_postfix); }
 ExprAST* BinaryExprAST::clone() const { return new BinaryExprAST(m_op, m_left->clone(), m_right->clone()); }
+ExprAST* ArrayNewExprAST::clone() const { return new ArrayNewExprAST(m_elementType, m_size->clone()); }
+ExprAST* ArrayIndexExprAST::clone() const { return new ArrayIndexExprAST(m_name, m_index->clone(), m_arrayType); }
+ExprAST* ArrayLengthExprAST::clone() const { return new ArrayLengthExprAST(m_name); }
+ExprAST* ArrayLiteralExprAST::clone() const {
+    std::vector<ExprAST*> elements;
+    for (auto &e : m_elements) elements.push_back(e->clone());
+    ArrayLiteralExprAST* res = new ArrayLiteralExprAST(elements);
+    res->set_element_type(element_type());
+    return res;
+}
+ExprAST* VectorExprAST::clone() const {
+    std::vector<ExprAST*> args;
+    for (auto &a : m_args) args.push_back(a->clone());
+    return new VectorExprAST(m_type->vlang_type(), args, m_op);
+}
+ExprAST* LaneExprAST::clone() const { return new LaneExprAST(m_vector->clone(), m_index->clone()); }
+ExprAST* MethodCallExprAST::clone() const {
+    std::vector<ExprAST*> args;
+    for (auto &a : m_args) args.push_back(a->clone());
+    return new MethodCallExprAST(m_object->clone(), m_method, args, m_property);
+}
+ExprAST* FieldExprAST::clone() const {
+    return new FieldExprAST(m_object->clone(), m_field);
+}
+ExprAST* NewObjectExprAST::clone() const {
+    std::vector<ExprAST*> args;
+    for (auto &a : m_args) args.push_back(a->clone());
+    return new NewObjectExprAST(m_type->vlang_type(), args);
+}
+ExprAST* PrintfExprAST::clone() const {
+    std::vector<ExprAST*> args;
+    for (auto &a : m_args) args.push_back(a->clone());
+    return new PrintfExprAST(args);
+}
 ExprAST* FunctionCallExprAST::clone() const {
     std::vector<ExprAST*> args;
     for (auto &a : m_args) args.push_back(a->clone());
@@ -301,6 +1263,9 @@ ExprAST* FunctionCallExprAST::clone() const {
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 std::string ConstIntExprAST::dump(unsigned) const {
     std::string res = boost::lexical_cast<std::string>(m_val);
+    if (is_unsigned(m_type->vlang_type()))
+        res = boost::lexical_cast<std::string>((unsigned long long)m_val) + "U";
+    if (integer_bits(m_type->vlang_type()) == 64) res += "L";
     if (vlang::util::ProgramOptions::get().syntax_highlight())
         res = std::string(INT_C) + res + std::string(RESET);
     return res;
@@ -324,10 +1289,17 @@ std::string UnaryExprAST::dump(unsigned) const {
     std::string res = m_op;
     if (vlang::util::ProgramOptions::get().syntax_highlight())
         res = std::string(OPERATOR_C) + res + std::string(RESET);
+    if (m_postfix) return m_expr->dump() + res;
     res += m_expr->dump();
     return res;
 }
 
+std::string CastExprAST::dump(unsigned) const {
+    std::string operand = m_expr->dump();
+    if (m_expr->exp_type() == EXP_TYPE::BINARY_EXP) operand = "(" + operand + ")";
+    return "(" + m_type->str() + ") " + operand;
+}
+
 std::string BinaryExprAST::dump(unsigned) const {
     std::string res = m_op;
     if (vlang::util::ProgramOptions::get().syntax_highlight())
@@ -343,23 +1315,82 @@ std::string VariableExprAST::dump(unsigned) const {
 }
 
 std::string FunctionCallExprAST::dump(unsigned) const {
-    // We try to find the function
-    ProtoDefContainer* ZiFunction = FunctionContainer[m_name];
-    unsigned i = 0;
-    if (ZiFunction == nullptr) {
-        std::cout << "Failed finding function '" << m_name << "'" << std::endl;
-        return "";
-    } else {
-        std::string res = ZiFunction->name();
-        if (vlang::util::ProgramOptions::get().syntax_highlight())
-            res = std::string(FUNNAME_C) + res + std::string(RESET);
-        res += "(";
-        if (m_args.empty()) return res += ")";
-        for (; i < m_args.size()-1; ++i)
-            res += m_args[i]->dump() + ", ";
-        res += m_args[i]->dump() + ")";
-        return res;
-    }
+    // Only looked up, dumps run on the threads of semantic analysis. Math.* functions of the
+    // runtime aren't in the container, their name is printed as written.
+    auto finder = FunctionContainer.find(m_name);
+    std::string res = (finder != FunctionContainer.end() && finder->second != nullptr) ? finder->second->name() : m_name;
+    if (vlang::util::ProgramOptions::get().syntax_highlight())
+        res = std::string(FUNNAME_C) + res + std::string(RESET);
+    res += "(";
+    for (unsigned i = 0; i < m_args.size(); ++i)
+        res += (i == 0 ? "" : ", ") + m_args[i]->dump();
+    return res + ")";
+}
+
+std::string ArrayNewExprAST::dump(unsigned) const {
+    std::string res = "new";
+    if (vlang::util::ProgramOptions::get().syntax_highlight())
+        res = std::string(KEYWORD_C) + res + std::string(RESET);
+    return res + " " + to_str(m_elementType) + "[" + m_size->dump() + "]";
+}
+
+std::string ArrayLiteralExprAST::dump(unsigned) const {
+    std::string res = "{";
+    for (unsigned i = 0; i < m_elements.size(); ++i)
+        res += (i == 0 ? "" : ", ") + m_elements[i]->dump();
+    return res + "}";
+}
+
+std::string ArrayIndexExprAST::dump(unsigned) const {
+    std::string res = m_name;
+    if (vlang::util::ProgramOptions::get().syntax_highlight())
+        res = std::string(VARIABLE_C) + res + std::string(RESET);
+    return res + "[" + m_index->dump() + "]";
+}
+
+std::string ArrayLengthExprAST::dump(unsigned) const {
+    std::string res = m_name;
+    if (vlang::util::ProgramOptions::get().syntax_highlight())
+        res = std::string(VARIABLE_C) + res + std::string(RESET);
+    return res + ".length";
+}
+
+std::string VectorExprAST::dump(unsigned) const {
+    std::string res = m_type->str() + (m_op.empty() ? "" : "." + m_op) + "(";
+    for (unsigned i = 0; i < m_args.size(); ++i)
+        res += (i == 0 ? "" : ", ") + m_args[i]->dump();
+    return res + ")";
+}
+
+std::string LaneExprAST::dump(unsigned) const {
+    return m_vector->dump() + "[" + m_index->dump() + "]";
+}
+
+std::string MethodCallExprAST::dump(unsigned) const {
+    std::string res = m_object->dump() + "." + m_method;
+    if (m_property) return res;
+    res += "(";
+    for (unsigned i = 0; i < m_args.size(); ++i)
+        res += (i == 0 ? "" : ", ") + m_args[i]->dump();
+    return res + ")";
+}
+
+std::string FieldExprAST::dump(unsigned) const {
+    return m_object->dump() + "." + m_field;
+}
+
+std::string NewObjectExprAST::dump(unsigned) const {
+    std::string res = "new " + m_type->str() + "(";
+    for (unsigned i = 0; i < m_args.size(); ++i)
+        res += (i == 0 ? "" : ", ") + m_args[i]->dump();
+    return res + ")";
+}
+
+std::string PrintfExprAST::dump(unsigned) const {
+    std::string res = "stdout.printf(";
+    for (unsigned i = 0; i < m_args.size(); ++i)
+        res += (i == 0 ? "" : ", ") + m_args[i]->dump();
+    return res + ")";
 }
 
 std::string BoolExprAST::dump(unsigned) const {
@@ -10,6 +10,9 @@
 
 #include <exception>
 #include <vector>
+#include <map>
+#include <set>
+#include <memory>
 #include <boost/lexical_cast.hpp>
 
 #include "LLVMCodegen.hpp"
@@ -23,7 +26,9 @@ namespace vlang {
 /// \brief Used to fast discover a class type in class hierarchy.
 /// -----------------------------------------------------------------------------------------------
 typedef enum {
-    INT_EXP, DOUBLE_EXP, STRING_EXP, VARIABLE_EXP, BINARY_EXP, UNARY_EXP, CALL_EXP
+    INT_EXP, DOUBLE_EXP, STRING_EXP, VARIABLE_EXP, BINARY_EXP, UNARY_EXP, CALL_EXP,
+    ARRAY_NEW_EXP, ARRAY_LITERAL_EXP, INDEX_EXP, LENGTH_EXP, METHOD_EXP, PRINTF_EXP,
+    FIELD_EXP, NEW_OBJECT_EXP, CAST_EXP, VECTOR_EXP, LANE_EXP
 } EXP_TYPE;
 
 /// -----------------------------------------------------------------------------------------------
@@ -62,6 +67,9 @@ public:
 // TODO: Still to make a decision on this
 std::pair<int, VLANG_TYPE> DetermineExpressionConversion(const ExprAST* left, const ExprAST* right);
 
+/// \brief Replaces escape sequences (\n, \t, \", \\...) of a string literal with characters.
+std::string UnescapeString(const std::string& raw);
+
 /// -----------------------------------------------------------------------------------------------
 /// \brief Represents an AST string constant node.
 /// -----------------------------------------------------------------------------------------------
@@ -128,26 +136,29 @@ private:
 };
 
 /// -----------------------------------------------------------------------------------------------
-/// \brief Represents an AST int const node.
-// TODO: Switch it to LONG LONG it in order to be able to represent smaller int types.
-// TODO: Allow signed, unsigned values
+/// \brief Represents an AST int const node. Literals are int unless they don't fit into it
+/// or have a suffix (10u, 10L, 10UL), the value of unsigned literals is stored bitwise.
 /// -----------------------------------------------------------------------------------------------
 class ConstIntExprAST : public ExprAST {
 public:
-    ConstIntExprAST(int val)
-        : m_val(val), m_type(new Int32Type())
+    ConstIntExprAST(long long val, VLANG_TYPE type = VLANG_TYPE::INT32)
+        : m_val(val), m_type(make_from_enum(type))
     {}
     ~ConstIntExprAST() {
         delete m_type;
     }
-    int val() const { return m_val; }
+    long long val() const { return m_val; }
+
+    /// \brief Returns true if the value of literal can be represented in given integer type,
+    /// so int8 x = 100 is fine without a cast.
+    bool fits_into(VLANG_TYPE type) const;
 
     virtual std::string dump(unsigned level = 0) const;
     virtual const VlangType* type() const { return m_type; }
     virtual Value* codegen() const;
     virtual EXP_TYPE exp_type() const { return EXP_TYPE::INT_EXP; }
     virtual ExprAST* promote(VLANG_TYPE type) {
-        if (type == VLANG_TYPE::INT32) return nullptr;
+        if (is_integer(type)) return nullptr;
         else if (type == VLANG_TYPE::DOUBLE)
             return new ConstDoubleExprAST(m_val);
         else if (type == VLANG_TYPE::STRING)
@@ -161,7 +172,7 @@ public:
     virtual ExprAST* clone() const;
 
 private:
-    int m_val;
+    long long m_val;
     VlangType* m_type;
 };
 
@@ -235,6 +246,8 @@ public:
     FunctionCallExprAST(std::string name, std::vector<ExprAST*> args, VLANG_TYPE retType)
         : m_name(name), m_args(args), m_retType(retType)
     {}
+    std::string name() const { return m_name; }
+    const std::vector<ExprAST*>& args() const { return m_args; }
     virtual std::string dump(unsigned level = 0) const;
     virtual Value* codegen() const;
     virtual EXP_TYPE exp_type() const { return EXP_TYPE::CALL_EXP; }
@@ -255,14 +268,17 @@ private:
 
 /// -----------------------------------------------------------------------------------------------
 /// \brief Represents an unary expression.
+/// Increment and decrement (++, --) can be prefix or postfix and require a variable operand.
 /// -----------------------------------------------------------------------------------------------
 class UnaryExprAST : public ExprAST {
 public:
-    UnaryExprAST(std::string operation, ExprAST* operand)
-        : m_op(operation), m_expr(operand)
+    UnaryExprAST(std::string operation, ExprAST* operand, bool postfix = false)
+        : m_op(operation), m_expr(operand), m_postfix(postfix)
     {}
     ~UnaryExprAST() { delete m_expr; }
     std::string operation() const { return m_op; }
+    bool is_postfix() const { return m_postfix; }
+    const ExprAST* operand() const { return m_expr; }
 
     virtual const VlangType* type() const {
         return m_expr->type();
@@ -280,6 +296,38 @@ public:
 private:
     std::string m_op;
     ExprAST* m_expr;
+    bool m_postfix;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents an explicit numeric conversion: (uint8) x, (double) n, (int64) a * b
+/// Integers are truncated or extended by the signedness of the operand, doubles are rounded
+/// towards zero.
+/// -----------------------------------------------------------------------------------------------
+class CastExprAST : public ExprAST {
+public:
+    CastExprAST(VLANG_TYPE type, ExprAST* operand)
+        : m_type(make_from_enum(type)), m_expr(operand)
+    {}
+    ~CastExprAST() {
+        delete m_type;
+        delete m_expr;
+    }
+    const ExprAST* operand() const { return m_expr; }
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::CAST_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) {
+        return nullptr;
+    }
+    virtual ExprAST* convertTo(VLANG_TYPE type);
+    virtual ExprAST* clone() const;
+
+private:
+    VlangType* m_type;
+    ExprAST* m_expr;
 };
 
 /// -----------------------------------------------------------------------------------------------
@@ -295,6 +343,8 @@ public:
         delete m_right;
     }
     std::string operation() const { return m_op; }
+    const ExprAST* left() const { return m_left; }
+    const ExprAST* right() const { return m_right; }
 
     virtual EXP_TYPE exp_type() const { return EXP_TYPE::BINARY_EXP; }
     virtual const VlangType* type() const;
@@ -304,6 +354,9 @@ public:
     virtual ExprAST* convertTo(VLANG_TYPE type);
     virtual ExprAST* clone() const;
 
+    /// \brief Type both operands are converted to, comparisons themselves are bool.
+    const VlangType* operand_type() const;
+
     bool is_arithmetic() const;
     bool is_relational() const;
 
@@ -313,6 +366,389 @@ private:
     ExprAST* m_right;
 };
 
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents an array allocation: new int[size]
+/// -----------------------------------------------------------------------------------------------
+class ArrayNewExprAST : public ExprAST {
+public:
+    ArrayNewExprAST(VLANG_TYPE elementType, ExprAST* size)
+        : m_elementType(elementType), m_size(size), m_type(new ArrayType(elementType))
+    {}
+    ~ArrayNewExprAST() {
+        delete m_size;
+        delete m_type;
+    }
+    VLANG_TYPE element_type() const { return m_elementType; }
+    const ExprAST* size() const { return m_size; }
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::ARRAY_NEW_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type);
+    virtual ExprAST* clone() const;
+
+private:
+    VLANG_TYPE m_elementType;
+    ExprAST* m_size;
+    VlangType* m_type;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents an array initializer: {1, 2, 3}
+/// Element type is set by declaration (for example double[] a = {1, 2}), elements are converted
+/// into element type during codegen.
+/// -----------------------------------------------------------------------------------------------
+class ArrayLiteralExprAST : public ExprAST {
+public:
+    ArrayLiteralExprAST(std::vector<ExprAST*> elements)
+        : m_elements(elements), m_type(nullptr)
+    {
+        set_element_type(VLANG_TYPE::INT32);
+    }
+    ~ArrayLiteralExprAST() {
+        for (auto &e : m_elements) delete e;
+        delete m_type;
+    }
+    const std::vector<ExprAST*>& elements() const { return m_elements; }
+    VLANG_TYPE element_type() const { return m_type->element_type(); }
+    void set_element_type(VLANG_TYPE type) {
+        delete m_type;
+        m_type = new ArrayType(type);
+    }
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::ARRAY_LITERAL_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type);
+    virtual ExprAST* clone() const;
+
+private:
+    std::vector<ExprAST*> m_elements;
+    ArrayType* m_type;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents an array element access: a[i]
+/// Access is bounds checked unless range analysis proves the index is in bounds.
+/// -----------------------------------------------------------------------------------------------
+class ArrayIndexExprAST : public ExprAST {
+public:
+    ArrayIndexExprAST(std::string name, ExprAST* index, VLANG_TYPE arrayType)
+        : m_name(name), m_index(index), m_arrayType(arrayType), m_type(make_from_enum(element_of(arrayType)))
+    {}
+    ~ArrayIndexExprAST() {
+        delete m_index;
+        delete m_type;
+    }
+    std::string name() const { return m_name; }
+    const ExprAST* index() const { return m_index; }
+
+    /// \brief Returns the address of the element (performs bounds check if required).
+    Value* address() const;
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::INDEX_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type);
+    virtual ExprAST* clone() const;
+
+private:
+    std::string m_name;
+    ExprAST* m_index;
+    VLANG_TYPE m_arrayType;
+    VlangType* m_type;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents an array length: a.length
+/// -----------------------------------------------------------------------------------------------
+class ArrayLengthExprAST : public ExprAST {
+public:
+    ArrayLengthExprAST(std::string name)
+        : m_name(name), m_type(new Int32Type())
+    {}
+    ~ArrayLengthExprAST() {
+        delete m_type;
+    }
+    std::string name() const { return m_name; }
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::LENGTH_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type);
+    virtual ExprAST* clone() const;
+
+private:
+    std::string m_name;
+    VlangType* m_type;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents a vector value built from lanes or loaded from an array:
+///     double4(1, 2, 3, 4), double4(x), double4.load(a, i), int32x8.load_aligned(b, j)
+/// A single argument is splatted into all lanes. Loads read lanes a[i] ... a[i + lanes - 1]
+/// with one bounds check, load_aligned additionally requires i to be a multiple of lanes.
+/// -----------------------------------------------------------------------------------------------
+class VectorExprAST : public ExprAST {
+public:
+    VectorExprAST(VLANG_TYPE type, std::vector<ExprAST*> args, std::string op = "")
+        : m_args(args), m_op(op), m_type(new SimdType(type))
+    {}
+    ~VectorExprAST() {
+        for (auto &a : m_args) delete a;
+        delete m_type;
+    }
+    const std::vector<ExprAST*>& args() const { return m_args; }
+    /// \brief Empty for lanes/splat, "load" or "load_aligned".
+    std::string operation() const { return m_op; }
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::VECTOR_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* clone() const;
+
+private:
+    std::vector<ExprAST*> m_args;
+    std::string m_op;
+    VlangType* m_type;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents a lane of a vector variable: v[i] (extractelement, insertelement when
+/// assigned to). Lane index isn't checked, out of range lanes are undefined.
+/// -----------------------------------------------------------------------------------------------
+class LaneExprAST : public ExprAST {
+public:
+    LaneExprAST(ExprAST* vector, ExprAST* index)
+        : m_vector(vector), m_index(index),
+          m_type(make_from_enum(vector_element(vector->type()->vlang_type())))
+    {}
+    ~LaneExprAST() {
+        delete m_vector;
+        delete m_index;
+        delete m_type;
+    }
+    const ExprAST* vector() const { return m_vector; }
+    const ExprAST* index() const { return m_index; }
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::LANE_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* clone() const;
+
+private:
+    ExprAST* m_vector;
+    ExprAST* m_index;
+    VlangType* m_type;
+};
+
+/// \brief Checks arguments of a method of given vector type: reductions sum(), min(), max(),
+/// shuffle(lanes...), shuffle(other, lanes...) with constant lanes and store(array, index),
+/// store_aligned(array, index). Returns an error message (empty if fine).
+std::string CheckVectorMethod(VLANG_TYPE type, const std::string& method, const std::vector<ExprAST*>& args);
+
+/// \brief Returns the type of given method (or property) of given type, UNKNOWN if there is no
+/// such method. For example: string.substring() returns a string.
+VLANG_TYPE MethodReturnType(VLANG_TYPE objectType, const std::string& method);
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents a method call or a property access on a value: s.substring(1, 3), s.length
+/// -----------------------------------------------------------------------------------------------
+class MethodCallExprAST : public ExprAST {
+public:
+    MethodCallExprAST(ExprAST* object, std::string method, std::vector<ExprAST*> args, bool property = false)
+        : m_object(object), m_method(method), m_args(args), m_property(property),
+          m_type(make_from_enum(MethodReturnType(object->type()->vlang_type(), method)))
+    {}
+    ~MethodCallExprAST() {
+        delete m_object;
+        for (auto &a : m_args) delete a;
+        delete m_type;
+    }
+    const ExprAST* object() const { return m_object; }
+    std::string method() const { return m_method; }
+    const std::vector<ExprAST*>& args() const { return m_args; }
+    bool is_property() const { return m_property; }
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::METHOD_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type);
+    virtual ExprAST* clone() const;
+
+private:
+    ExprAST* m_object;
+    std::string m_method;
+    std::vector<ExprAST*> m_args;
+    bool m_property;
+    VlangType* m_type;
+};
+
+/// \brief Returns the type of given field of given class type, UNKNOWN if there is no such field.
+VLANG_TYPE FieldType(VLANG_TYPE classType, const std::string& field);
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents an access to a field (or an auto-property) of an object: p.x, this.x
+/// Properties have no accessor functions, this is a direct load (or a store in assignments).
+/// -----------------------------------------------------------------------------------------------
+class FieldExprAST : public ExprAST {
+public:
+    FieldExprAST(ExprAST* object, std::string field)
+        : m_object(object), m_field(field),
+          m_type(make_from_enum(FieldType(object->type()->vlang_type(), field)))
+    {}
+    ~FieldExprAST() {
+        delete m_object;
+        delete m_type;
+    }
+    const ExprAST* object() const { return m_object; }
+    std::string field() const { return m_field; }
+
+    /// \brief Returns the address of the field.
+    Value* address() const;
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::FIELD_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* clone() const;
+
+private:
+    ExprAST* m_object;
+    std::string m_field;
+    VlangType* m_type;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents an object creation: new Point(1.1, 2.2)
+/// -----------------------------------------------------------------------------------------------
+class NewObjectExprAST : public ExprAST {
+public:
+    NewObjectExprAST(VLANG_TYPE classType, std::vector<ExprAST*> args)
+        : m_args(args), m_type(new ClassType(classType))
+    {}
+    ~NewObjectExprAST() {
+        for (auto &a : m_args) delete a;
+        delete m_type;
+    }
+    const std::vector<ExprAST*>& args() const { return m_args; }
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::NEW_OBJECT_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* clone() const;
+
+private:
+    std::vector<ExprAST*> m_args;
+    VlangType* m_type;
+};
+
+/// \brief A piece of a printf format string: literal text or a conversion (%d, %f, %g, %s).
+struct FormatSegment {
+    char conversion;        // 0 for literal text
+    std::string text;
+};
+
+/// \brief Splits given (unescaped) format string into segments. In case of an unsupported
+/// conversion returns false and sets error.
+bool ParseFormatString(const std::string& format, std::vector<FormatSegment>& segments, std::string& error);
+
+/// \brief Returns the number of parameters of given Math function ("Math.sqrt"), -1 if there
+/// is no such function. Math functions are called as regular functions returning double and
+/// are lowered to LLVM intrinsics.
+int MathFunctionArity(const std::string& name);
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents stdout.printf(format, args...)
+/// Literal formats are parsed during compilation, so printf becomes a sequence of calls writing
+/// text, ints, doubles and strings into buffered stdout.
+/// -----------------------------------------------------------------------------------------------
+class PrintfExprAST : public ExprAST {
+public:
+    PrintfExprAST(std::vector<ExprAST*> args)
+        : m_args(args), m_type(new VoidType())
+    {}
+    ~PrintfExprAST() {
+        for (auto &a : m_args) delete a;
+        delete m_type;
+    }
+    const std::vector<ExprAST*>& args() const { return m_args; }
+
+    /// \brief Checks format against the arguments, returns an error message (empty if fine).
+    std::string checkFormat() const;
+
+    virtual const VlangType* type() const { return m_type; }
+    virtual std::string dump(unsigned level = 0) const;
+    virtual Value* codegen() const;
+    virtual EXP_TYPE exp_type() const { return EXP_TYPE::PRINTF_EXP; }
+    virtual ExprAST* promote(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* convertTo(VLANG_TYPE type) { return nullptr; }
+    virtual ExprAST* clone() const;
+
+private:
+    std::vector<ExprAST*> m_args;
+    VlangType* m_type;
+};
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Range analysis facts, used to remove redundant array bounds checks.
+// Filled by FunctionAST/ForStmtAST during codegen.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// \brief Range [lower, bound) of a for loop induction variable, where bound is either the
+/// length of boundArray or constant boundConst.
+struct InductionRange {
+    long long lower;
+    std::string boundArray;
+    long long boundConst;
+};
+
+/// \brief Arrays (of current function) whose length is known at compile time.
+extern std::map<std::string, long long> ArrayStaticLength;
+
+/// \brief Induction variables of for loops which are currently being generated.
+extern std::map<std::string, InductionRange> InductionRanges;
+
+/// \brief Returns true if range analysis proves that array[index] is always in bounds.
+bool IsProvenInBounds(const std::string& array, const ExprAST* index);
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Escape analysis facts, filled by FunctionAST during codegen.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// \brief Allocations (new C(...)) of current function whose objects never escape it,
+/// they are placed in the stack frame instead of the heap.
+extern std::set<const ExprAST*> StackAllocatedObjects;
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Compile-time evaluation facts, filled by semantic analysis.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// \brief Calls of pure functions with constant arguments and their values (ConstIntExprAST,
+/// ConstDoubleExprAST or BoolExprAST). Such calls are generated as their value.
+extern std::map<const ExprAST*, std::unique_ptr<ExprAST>> ConstantCalls;
+
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 } // ;vlang
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
@@ -16,11 +16,18 @@ namespace vlang {
 std::stack<std::map<std::string, VLANG_TYPE>> LocalVariableScopeContainer;
 std::map<std::string, ProtoDefContainer*> FunctionContainer;
 std::map<std::string, VLANG_TYPE> FunctionReturnType;
+std::vector<ClassAST*> ClassContainer;
+ClassAST* CurrentClass = nullptr;
 
 void RegisterVariable(std::string name, VLANG_TYPE type) {
     LocalVariableScopeContainer.top()[name] = type;
 }
 
+void UnregisterVariable(std::string name) {
+    if (! LocalVariableScopeContainer.empty())
+        LocalVariableScopeContainer.top().erase(name);
+}
+
 VLANG_TYPE GetVariableType(std::string name) {
     if (! LocalVariableScopeContainer.empty()) {
         auto finder = LocalVariableScopeContainer.top().find(name);
@@ -29,6 +36,24 @@ VLANG_TYPE GetVariableType(std::string name) {
         else return finder->second;
     } else return VLANG_TYPE::UNKNOWN;
 }
+VLANG_TYPE RegisterClass(ClassAST* c) {
+    ClassContainer.push_back(c);
+    return static_cast<VLANG_TYPE>(VLANG_TYPE::CLASS + ClassContainer.size() - 1);
+}
+
+ClassAST* GetClass(VLANG_TYPE type) {
+    if (! is_class(type)) return nullptr;
+    unsigned index = type - VLANG_TYPE::CLASS;
+    return index < ClassContainer.size() ? ClassContainer[index] : nullptr;
+}
+
+VLANG_TYPE GetClassType(const std::string& name) {
+    for (unsigned i = 0; i < ClassContainer.size(); ++i)
+        if (ClassContainer[i]->name() == name)
+            return static_cast<VLANG_TYPE>(VLANG_TYPE::CLASS + i);
+    return VLANG_TYPE::UNKNOWN;
+}
+
 void BeginScope() {
     if (LocalVariableScopeContainer.empty())
         LocalVariableScopeContainer.push(std::map<std::string, VLANG_TYPE>());
@@ -28,6 +28,12 @@ namespace vlang {
 extern std::stack<std::map<std::string, VLANG_TYPE>> LocalVariableScopeContainer;
 extern std::map<std::string, ProtoDefContainer*> FunctionContainer;
 
+/// \brief Classes of the program, index of a class is its type: VLANG_TYPE::CLASS + index.
+extern std::vector<ClassAST*> ClassContainer;
+
+/// \brief Class whose body is being parsed, nullptr outside of class definitions.
+extern ClassAST* CurrentClass;
+
 /// \brief This counter is used by lexer in order to count program lines (so error can point the exact line)
 extern unsigned long long int ProgramLineCounter;
 
@@ -39,6 +45,18 @@ VLANG_TYPE GetVariableType(std::string name);
 /// This should be taken care by semantic analyzer.
 void RegisterVariable(std::string name, VLANG_TYPE type);
 
+/// \brief Removes given variable from current scope.
+void UnregisterVariable(std::string name);
+
+/// \brief Registers a given class and returns its type.
+VLANG_TYPE RegisterClass(ClassAST* c);
+
+/// \brief Returns the class of given type, nullptr if it's not a class type.
+ClassAST* GetClass(VLANG_TYPE type);
+
+/// \brief Returns the type of class with given name, UNKNOWN if there is no such class.
+VLANG_TYPE GetClassType(const std::string& name);
+
 /// \brief Begins a scope. Called by lexer when it finds '{' token.
 void BeginScope();
 
@@ -0,0 +1,894 @@
+/*
+ * Interpreter.cpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "Interpreter.hpp"
+#include "ProgramOptions.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+
+// Pieces of stdout.printf() from the vlang runtime (lib/io.c), linked into the compiler.
+extern "C" {
+void vlang_out_write(const char* data, int64_t length);
+void vlang_out_int(int64_t value);
+void vlang_out_double(double value, char conversion);
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+namespace {
+
+/// \brief A register. Ints are kept sign extended, bools are 0 or 1.
+union Slot {
+    int64_t i;
+    double d;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Bytecode instructions, operands a, b, c are registers of the frame unless said otherwise.
+/// -----------------------------------------------------------------------------------------------
+enum class Op : uint8_t {
+    LOADK,                          // a = constants[b]
+    MOV,                            // a = b
+    ADD, SUB, MUL, DIV, REM,        // a = b op c (int)
+    FADD, FSUB, FMUL, FDIV,         // a = b op c (double)
+    NEG, FNEG, NOT,                 // a = op b
+    LT, GT, LE, GE, EQ, NE,         // a = b op c (int, bool)
+    FLT, FGT, FLE, FGE, FEQ, FNE,   // a = b op c (double)
+    I2D, D2I,                       // a = (type) b
+    JMP,                            // goto a
+    JMPF,                           // if (! a) goto b
+    CALL,                           // a = functions[b](c, c + 1...), a is -1 for void calls
+    RET,                            // return
+    RETV,                           // return a
+    OUT_TEXT,                       // write texts[a]
+    OUT_INT,                        // write a
+    OUT_DOUBLE                      // write a with conversion c
+};
+
+struct Instr {
+    Op op;
+    int32_t a, b, c;
+};
+
+/// \brief Native code of a function: arguments are read from slots, result is written to slots[0].
+typedef void (*NativeEntry)(Slot* slots);
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief A function of the program as seen by the interpreter.
+/// Arguments are the first registers of the frame, the result is returned in register 0.
+/// -----------------------------------------------------------------------------------------------
+struct VmFunction {
+    std::string name;
+    const FunctionAST* ast;             // nullptr for declarations
+    std::vector<VLANG_TYPE> params;
+    VLANG_TYPE ret;
+
+    bool hasBytecode = false;
+    std::vector<Instr> code;
+    std::vector<Slot> constants;
+    std::vector<std::string> texts;
+    unsigned registers = 0;
+
+    unsigned hotness = 0;               // calls and loop iterations so far
+    NativeEntry native = nullptr;
+};
+
+// Types the bytecode works with, everything else is left to native code.
+bool isScalar(VLANG_TYPE type) {
+    return type == VLANG_TYPE::INT32 || type == VLANG_TYPE::DOUBLE || type == VLANG_TYPE::BOOL;
+}
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Translates the body of a function into bytecode.
+///
+/// Variables get their own registers (one per name, as NamedValues during codegen), temporaries
+/// live above them and are freed after every statement. Arguments of a call are evaluated into
+/// consecutive registers on top, which become the first registers of the callee's frame.
+/// -----------------------------------------------------------------------------------------------
+class BytecodeCompiler {
+public:
+    BytecodeCompiler(VmFunction& function, const std::map<std::string, unsigned>& indices,
+                     const std::vector<std::unique_ptr<VmFunction>>& functions)
+        : m_f(function), m_indices(indices), m_functions(functions), m_locals(0), m_top(0)
+    {}
+
+    /// \brief Returns false if the function uses something the bytecode doesn't support.
+    bool compile() {
+        const auto& args = m_f.ast->proto().args();
+        for (unsigned i = 0; i < args.size(); ++i)
+            m_variables[args[i].second] = std::make_pair((int)declare(), args[i].first);
+        if (! statement(m_f.ast->body())) return false;
+        emit(Op::RET);
+        m_f.registers = std::max(m_f.registers, 1u);
+        return true;
+    }
+
+private:
+    unsigned declare() {
+        m_top = ++m_locals;
+        m_f.registers = std::max(m_f.registers, m_top);
+        return m_locals - 1;
+    }
+
+    int temp() {
+        m_f.registers = std::max(m_f.registers, m_top + 1);
+        return m_top++;
+    }
+
+    unsigned emit(Op op, int a = 0, int b = 0, int c = 0) {
+        m_f.code.push_back(Instr{ op, a, b, c });
+        return m_f.code.size() - 1;
+    }
+
+    void loadInt(int dst, int64_t val) {
+        Slot k;
+        k.i = val;
+        m_f.constants.push_back(k);
+        emit(Op::LOADK, dst, m_f.constants.size() - 1);
+    }
+
+    void loadDouble(int dst, double val) {
+        Slot k;
+        k.d = val;
+        m_f.constants.push_back(k);
+        emit(Op::LOADK, dst, m_f.constants.size() - 1);
+    }
+
+    const VmFunction* callee(const std::string& name) const {
+        auto finder = m_indices.find(name);
+        return finder == m_indices.end() ? nullptr : m_functions[finder->second].get();
+    }
+
+    // Calls have their type in the callee (FunctionCallExprAST::type() allocates a new one)
+    VLANG_TYPE typeOf(const ExprAST* expr) const {
+        if (expr->exp_type() == EXP_TYPE::CALL_EXP) {
+            const VmFunction* f = callee(static_cast<const FunctionCallExprAST*>(expr)->name());
+            return f == nullptr ? VLANG_TYPE::UNKNOWN : f->ret;
+        }
+        const VlangType* type = expr->type();
+        return type == nullptr ? VLANG_TYPE::UNKNOWN : type->vlang_type();
+    }
+
+    // Converts register src of type from into register dst of type to.
+    bool convert(int dst, int src, VLANG_TYPE from, VLANG_TYPE to) {
+        if (from == to || (from == VLANG_TYPE::BOOL && to == VLANG_TYPE::INT32)) {
+            if (dst != src) emit(Op::MOV, dst, src);
+            return true;
+        }
+        if (to == VLANG_TYPE::DOUBLE && (from == VLANG_TYPE::INT32 || from == VLANG_TYPE::BOOL)) {
+            emit(Op::I2D, dst, src);
+            return true;
+        }
+        if (from == VLANG_TYPE::DOUBLE && to == VLANG_TYPE::INT32) {
+            emit(Op::D2I, dst, src);
+            return true;
+        }
+        return false;
+    }
+
+    // Evaluates expression into dst, converted to given type.
+    bool expressionAs(const ExprAST* expr, VLANG_TYPE type, int dst) {
+        VLANG_TYPE from = typeOf(expr);
+        if (from == type) return expression(expr, dst);
+        int tmp = temp();
+        return expression(expr, tmp) && convert(dst, tmp, from, type);
+    }
+
+    // Evaluates a condition into a register which is 0 if it's false.
+    int condition(const ExprAST* expr) {
+        int reg = temp();
+        if (! expression(expr, reg)) return -1;
+        VLANG_TYPE type = typeOf(expr);
+        if (type == VLANG_TYPE::DOUBLE) {
+            int zero = temp();
+            loadDouble(zero, 0.0);
+            emit(Op::FNE, reg, reg, zero);
+        } else if (! isScalar(type)) return -1;
+        return reg;
+    }
+
+    // Evaluates expression into dst (-1 if the value isn't needed).
+    bool expression(const ExprAST* expr, int dst) {
+        VLANG_TYPE type = typeOf(expr);
+        bool isVoid = expr->exp_type() == EXP_TYPE::PRINTF_EXP
+                   || (expr->exp_type() == EXP_TYPE::CALL_EXP && type == VLANG_TYPE::VOID);
+        if (! isVoid && ! isScalar(type)) return false;
+        if (dst < 0 && ! isVoid) dst = temp();
+
+        // BoolExprAST claims to be STRING_EXP
+        if (const BoolExprAST* boolean = dynamic_cast<const BoolExprAST*>(expr)) {
+            loadInt(dst, boolean->val());
+            return true;
+        }
+
+        switch (expr->exp_type()) {
+            case EXP_TYPE::INT_EXP:
+                loadInt(dst, (int32_t)static_cast<const ConstIntExprAST*>(expr)->val());
+                return true;
+            case EXP_TYPE::DOUBLE_EXP:
+                loadDouble(dst, static_cast<const ConstDoubleExprAST*>(expr)->val());
+                return true;
+            case EXP_TYPE::VARIABLE_EXP: {
+                auto finder = m_variables.find(static_cast<const VariableExprAST*>(expr)->name());
+                if (finder == m_variables.end()) return false;
+                if (dst != finder->second.first) emit(Op::MOV, dst, finder->second.first);
+                return true;
+            }
+            case EXP_TYPE::BINARY_EXP:
+                return binary(static_cast<const BinaryExprAST*>(expr), dst);
+            case EXP_TYPE::UNARY_EXP:
+                return unary(static_cast<const UnaryExprAST*>(expr), dst);
+            case EXP_TYPE::CAST_EXP:
+                return expressionAs(static_cast<const CastExprAST*>(expr)->operand(), type, dst);
+            case EXP_TYPE::CALL_EXP: {
+                // Evaluated at compile time
+                auto value = ConstantCalls.find(expr);
+                if (value != ConstantCalls.end()) return expression(value->second.get(), dst);
+                return call(static_cast<const FunctionCallExprAST*>(expr), isVoid ? -1 : dst);
+            }
+            case EXP_TYPE::PRINTF_EXP:
+                return output(static_cast<const PrintfExprAST*>(expr));
+            default:
+                return false;
+        }
+    }
+
+    bool binary(const BinaryExprAST* expr, int dst) {
+        const std::string& op = expr->operation();
+        if (op == "=") {
+            if (expr->left()->exp_type() != EXP_TYPE::VARIABLE_EXP) return false;
+            auto finder = m_variables.find(static_cast<const VariableExprAST*>(expr->left())->name());
+            if (finder == m_variables.end()) return false;
+            int tmp = temp();
+            if (! expressionAs(expr->right(), finder->second.second, tmp)) return false;
+            emit(Op::MOV, finder->second.first, tmp);
+            if (dst != finder->second.first) emit(Op::MOV, dst, tmp);
+            return true;
+        }
+
+        VLANG_TYPE type = expr->operand_type()->vlang_type();
+        if (! isScalar(type)) return false;
+        int left = temp();
+        int right = temp();
+        if (! expressionAs(expr->left(), type, left) || ! expressionAs(expr->right(), type, right))
+            return false;
+
+        static const std::map<std::string, std::pair<Op, Op>> operations = {
+            { "+",  { Op::ADD, Op::FADD } },
+            { "-",  { Op::SUB, Op::FSUB } },
+            { "*",  { Op::MUL, Op::FMUL } },
+            { "/",  { Op::DIV, Op::FDIV } },
+            { "%",  { Op::REM, Op::REM } },
+            { "<",  { Op::LT,  Op::FLT } },
+            { ">",  { Op::GT,  Op::FGT } },
+            { "<=", { Op::LE,  Op::FLE } },
+            { ">=", { Op::GE,  Op::FGE } },
+            { "==", { Op::EQ,  Op::FEQ } },
+            { "!=", { Op::NE,  Op::FNE } },
+        };
+        auto finder = operations.find(op);
+        if (finder == operations.end()) return false;
+        if (type == VLANG_TYPE::BOOL && ! expr->is_relational()) return false;
+        if (type == VLANG_TYPE::DOUBLE && op == "%") return false;
+        emit(type == VLANG_TYPE::DOUBLE ? finder->second.second : finder->second.first, dst, left, right);
+        return true;
+    }
+
+    bool unary(const UnaryExprAST* expr, int dst) {
+        const std::string& op = expr->operation();
+        VLANG_TYPE type = typeOf(expr->operand());
+        if (op == "++" || op == "--") {
+            if (expr->operand()->exp_type() != EXP_TYPE::VARIABLE_EXP || type == VLANG_TYPE::BOOL) return false;
+            auto finder = m_variables.find(static_cast<const VariableExprAST*>(expr->operand())->name());
+            if (finder == m_variables.end()) return false;
+            int var = finder->second.first;
+            int one = temp();
+            bool isDouble = type == VLANG_TYPE::DOUBLE;
+            if (isDouble) loadDouble(one, 1.0);
+            else loadInt(one, 1);
+
+            if (expr->is_postfix()) emit(Op::MOV, dst, var);
+            if (op == "++") emit(isDouble ? Op::FADD : Op::ADD, var, var, one);
+            else emit(isDouble ? Op::FSUB : Op::SUB, var, var, one);
+            if (! expr->is_postfix()) emit(Op::MOV, dst, var);
+            return true;
+        }
+
+        if (! expression(expr->operand(), dst)) return false;
+        if (op == "-" && type == VLANG_TYPE::INT32) emit(Op::NEG, dst, dst);
+        else if (op == "-" && type == VLANG_TYPE::DOUBLE) emit(Op::FNEG, dst, dst);
+        else if (op == "!" && type == VLANG_TYPE::BOOL) emit(Op::NOT, dst, dst);
+        else return false;
+        return true;
+    }
+
+    bool call(const FunctionCallExprAST* expr, int dst) {
+        auto finder = m_indices.find(expr->name());
+        if (finder == m_indices.end()) return false;
+        const VmFunction& f = *m_functions[finder->second];
+        if (f.params.size() != expr->args().size()) return false;
+
+        int base = m_top;
+        for (unsigned i = 0; i < f.params.size(); ++i) {
+            int arg = temp();
+            if (! expressionAs(expr->args()[i], f.params[i], arg)) return false;
+            m_top = arg + 1;
+        }
+        // The callee needs at least one register for its result
+        if (f.params.empty()) temp();
+        emit(Op::CALL, dst, finder->second, base);
+        return true;
+    }
+
+    bool output(const PrintfExprAST* expr) {
+        const StringExprAST* format = dynamic_cast<const StringExprAST*>(expr->args()[0]);
+        if (format == nullptr || ! expr->checkFormat().empty()) return false;
+        std::vector<FormatSegment> segments;
+        std::string error;
+        if (! ParseFormatString(UnescapeString(format->val()), segments, error)) return false;
+
+        // Arguments are evaluated before anything is written
+        std::vector<int> values;
+        for (unsigned i = 1; i < expr->args().size(); ++i) {
+            values.push_back(temp());
+            if (! expression(expr->args()[i], values.back())) return false;
+        }
+
+        unsigned arg = 0;
+        for (auto &segment : segments) {
+            switch (segment.conversion) {
+                case 0:
+                    m_f.texts.push_back(segment.text);
+                    emit(Op::OUT_TEXT, m_f.texts.size() - 1);
+                    break;
+                case 'd':
+                    emit(Op::OUT_INT, values[arg++]);
+                    break;
+                case 'e': case 'f': case 'g':
+                    emit(Op::OUT_DOUBLE, values[arg++], 0, segment.conversion);
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Declares (or reuses) a variable of given type, returns its register.
+    int variable(const std::string& name, VLANG_TYPE type) {
+        auto finder = m_variables.find(name);
+        if (finder != m_variables.end())
+            return finder->second.second == type ? finder->second.first : -1;
+        int reg = declare();
+        m_variables[name] = std::make_pair(reg, type);
+        return reg;
+    }
+
+    bool assignment(const std::string& name, VLANG_TYPE type, const ExprAST* expr) {
+        int reg = -1;
+        if (type == VLANG_TYPE::NO_VAR_DECL) {
+            auto finder = m_variables.find(name);
+            if (finder == m_variables.end()) return false;
+            reg = finder->second.first;
+            type = finder->second.second;
+        } else {
+            if (! isScalar(type)) return false;
+            reg = variable(name, type);
+            if (reg < 0) return false;
+        }
+        if (expr == nullptr) {
+            if (type == VLANG_TYPE::DOUBLE) loadDouble(reg, 0.0);
+            else loadInt(reg, 0);
+            return true;
+        }
+        int tmp = temp();
+        if (! expressionAs(expr, type, tmp)) return false;
+        emit(Op::MOV, reg, tmp);
+        return true;
+    }
+
+    bool statement(const StmtAST* stmt) {
+        if (stmt == nullptr) return true;
+        m_top = m_locals;
+
+        switch (stmt->stmt_type()) {
+            case STMT_TYPE::RETURN: {
+                const ExprAST* value = static_cast<const ReturnStmtAST*>(stmt)->value();
+                if (value == nullptr) {
+                    emit(Op::RET);
+                    return true;
+                }
+                if (m_f.ret == VLANG_TYPE::VOID) return false;
+                int reg = temp();
+                if (! expressionAs(value, m_f.ret, reg)) return false;
+                emit(Op::RETV, reg);
+                return true;
+            }
+            case STMT_TYPE::BLOCK:
+                for (auto &child : static_cast<const BlockStmtAST*>(stmt)->blockStatements())
+                    if (! statement(child)) return false;
+                return true;
+            case STMT_TYPE::ASSIGNMENT: {
+                const AssignmentStmtAST* assign = static_cast<const AssignmentStmtAST*>(stmt);
+                return assignment(assign->var_name(), assign->assignmentTypes().first, assign->expr());
+            }
+            case STMT_TYPE::ASSIGNMENT_LIST: {
+                const AssignmentListStmtAST* list = static_cast<const AssignmentListStmtAST*>(stmt);
+                for (auto &assign : list->assignments()) {
+                    m_top = m_locals;
+                    if (! assignment(assign.first, list->type(), assign.second)) return false;
+                }
+                return true;
+            }
+            case STMT_TYPE::EXPRESSION:
+                return expression(static_cast<const ExpressionStmtAST*>(stmt)->expr(), -1);
+            case STMT_TYPE::EMPTY:
+                return true;
+            case STMT_TYPE::IF: {
+                const IfStmtAST* ifStmt = static_cast<const IfStmtAST*>(stmt);
+                int cond = condition(ifStmt->cond());
+                if (cond < 0) return false;
+                unsigned jump = emit(Op::JMPF, cond);
+                if (! statement(ifStmt->then_stmt())) return false;
+                m_f.code[jump].b = m_f.code.size();
+                return true;
+            }
+            case STMT_TYPE::IF_ELSE: {
+                const IfElseStmtAST* ifStmt = static_cast<const IfElseStmtAST*>(stmt);
+                int cond = condition(ifStmt->cond());
+                if (cond < 0) return false;
+                unsigned jumpElse = emit(Op::JMPF, cond);
+                if (! statement(ifStmt->then_stmt())) return false;
+                unsigned jumpEnd = emit(Op::JMP);
+                m_f.code[jumpElse].b = m_f.code.size();
+                if (! statement(ifStmt->else_stmt())) return false;
+                m_f.code[jumpEnd].a = m_f.code.size();
+                return true;
+            }
+            case STMT_TYPE::WHILE: {
+                const WhileStmtAST* whileStmt = static_cast<const WhileStmtAST*>(stmt);
+                unsigned top = m_f.code.size();
+                int cond = condition(whileStmt->cond());
+                if (cond < 0) return false;
+                unsigned jumpEnd = emit(Op::JMPF, cond);
+                if (! statement(whileStmt->body())) return false;
+                emit(Op::JMP, top);
+                m_f.code[jumpEnd].b = m_f.code.size();
+                return true;
+            }
+            case STMT_TYPE::FOR: {
+                const ForStmtAST* forStmt = static_cast<const ForStmtAST*>(stmt);
+                if (! statement(forStmt->init())) return false;
+                m_top = m_locals;
+                unsigned top = m_f.code.size();
+                int jumpEnd = -1;
+                if (forStmt->cond() != nullptr) {
+                    int cond = condition(forStmt->cond());
+                    if (cond < 0) return false;
+                    jumpEnd = emit(Op::JMPF, cond);
+                }
+                if (! statement(forStmt->body())) return false;
+                m_top = m_locals;
+                if (forStmt->step() != nullptr && ! expression(forStmt->step(), -1)) return false;
+                emit(Op::JMP, top);
+                if (jumpEnd >= 0) m_f.code[jumpEnd].b = m_f.code.size();
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    VmFunction& m_f;
+    const std::map<std::string, unsigned>& m_indices;
+    const std::vector<std::unique_ptr<VmFunction>>& m_functions;
+    std::map<std::string, std::pair<int, VLANG_TYPE>> m_variables;
+    unsigned m_locals;
+    unsigned m_top;
+};
+
+[[noreturn]] void runtimeError(const std::string& message) {
+    std::cerr << "error: " << message << std::endl;
+    std::exit(1);
+}
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Runs bytecode. With --run it compiles the program with MCJIT once some function gets
+/// hot, during semantic analysis it evaluates calls of pure functions with a budget of steps.
+/// -----------------------------------------------------------------------------------------------
+class Interpreter {
+public:
+    Interpreter(const std::vector<StmtAST*>* program)
+        : m_program(program), m_stack(StackSlots),
+          m_threshold(util::ProgramOptions::get().jit_threshold()),
+          m_evaluating(false), m_failed(false), m_budget(0), m_depth(0)
+    {
+        for (auto &stmt : *m_program) {
+            if (stmt->stmt_type() == STMT_TYPE::FUNCTION)
+                addFunction(static_cast<const FunctionAST*>(stmt)->proto(), static_cast<const FunctionAST*>(stmt));
+            else if (stmt->stmt_type() == STMT_TYPE::PROTOTYPE)
+                addFunction(*static_cast<const PrototypeAST*>(stmt), nullptr);
+        }
+        for (auto &f : m_functions) {
+            if (f->ast == nullptr) continue;
+            BytecodeCompiler compiler(*f, m_indices, m_functions);
+            f->hasBytecode = compiler.compile();
+            if (! f->hasBytecode) f->code.clear();
+        }
+    }
+
+    int run() {
+        auto main = m_indices.find("main");
+        if (main == m_indices.end() || ! m_functions[main->second]->params.empty()) {
+            std::cerr << "error: --run needs a main function without parameters" << std::endl;
+            return 1;
+        }
+
+        // Classes and globals are only supported by native code
+        bool interpretable = true;
+        for (auto &stmt : *m_program) {
+            STMT_TYPE type = stmt->stmt_type();
+            if (type != STMT_TYPE::FUNCTION && type != STMT_TYPE::PROTOTYPE) interpretable = false;
+        }
+        unsigned interpreted = 0;
+        for (auto &f : m_functions) {
+            // Caches of [Memoize] functions exist only in native code
+            if (! interpretable || (f->ast != nullptr && f->ast->has_attribute("Memoize"))) f->hasBytecode = false;
+            if (f->hasBytecode) ++interpreted;
+        }
+        std::cerr << "[run]: " << interpreted << " of " << m_functions.size() << " functions interpreted." << std::endl;
+
+        VmFunction& mainFunction = *m_functions[main->second];
+        call(mainFunction, m_stack.data());
+        return mainFunction.ret == VLANG_TYPE::VOID ? 0 : (int)m_stack[0].i;
+    }
+
+    /// \brief Returns the value of given call if the callee is pure and arguments are constant,
+    /// nullptr otherwise (or if evaluation fails or takes more than budget steps).
+    ExprAST* evaluate(const FunctionCallExprAST* expr, unsigned budget) {
+        if (m_pure.empty()) findPureFunctions();
+        auto finder = m_indices.find(expr->name());
+        if (finder == m_indices.end() || ! m_pure[finder->second]) return nullptr;
+        VmFunction& f = *m_functions[finder->second];
+        if (f.ret == VLANG_TYPE::VOID || f.params.size() != expr->args().size()) return nullptr;
+        for (unsigned i = 0; i < f.params.size(); ++i)
+            if (! constantValue(expr->args()[i], f.params[i], m_stack[i])) return nullptr;
+
+        m_evaluating = true;
+        m_failed = false;
+        m_budget = budget;
+        call(f, m_stack.data());
+        m_evaluating = false;
+        if (m_failed) return nullptr;
+
+        if (f.ret == VLANG_TYPE::DOUBLE) return new ConstDoubleExprAST(m_stack[0].d);
+        if (f.ret == VLANG_TYPE::BOOL) return new BoolExprAST(m_stack[0].i != 0);
+        return new ConstIntExprAST((int32_t)m_stack[0].i);
+    }
+
+private:
+    static const unsigned StackSlots = 1 << 20;
+    static const unsigned MaxEvaluationDepth = 10000;
+
+    void addFunction(const PrototypeAST& proto, const FunctionAST* ast) {
+        bool scalar = proto.ret_val_type() == VLANG_TYPE::VOID || isScalar(proto.ret_val_type());
+        for (auto &arg : proto.args()) scalar = scalar && isScalar(arg.first);
+
+        // Bytecode can call only functions whose values fit in a register, the rest is
+        // reachable from native code only
+        if (! scalar || m_indices.count(proto.name())) {
+            if (scalar && ast != nullptr) m_functions[m_indices[proto.name()]]->ast = ast;
+            return;
+        }
+        std::unique_ptr<VmFunction> f(new VmFunction());
+        f->name = proto.name();
+        f->ast = ast;
+        f->ret = proto.ret_val_type();
+        for (auto &arg : proto.args()) f->params.push_back(arg.first);
+        m_indices[f->name] = m_functions.size();
+        m_functions.push_back(std::move(f));
+    }
+
+    // Pure functions write nothing and call only pure functions (bytecode can't touch globals).
+    void findPureFunctions() {
+        m_pure.assign(m_functions.size(), false);
+        for (unsigned i = 0; i < m_functions.size(); ++i) {
+            m_pure[i] = m_functions[i]->hasBytecode;
+            for (auto &in : m_functions[i]->code)
+                if (in.op == Op::OUT_TEXT || in.op == Op::OUT_INT || in.op == Op::OUT_DOUBLE) m_pure[i] = false;
+        }
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (unsigned i = 0; i < m_functions.size(); ++i)
+                for (auto &in : m_functions[i]->code)
+                    if (m_pure[i] && in.op == Op::CALL && ! m_pure[in.b]) {
+                        m_pure[i] = false;
+                        changed = true;
+                    }
+        }
+    }
+
+    // Reads a literal (possibly negated, or an already evaluated call) as given type.
+    static bool constantValue(const ExprAST* expr, VLANG_TYPE type, Slot& value) {
+        auto evaluated = ConstantCalls.find(expr);
+        if (evaluated != ConstantCalls.end()) expr = evaluated->second.get();
+
+        if (const BoolExprAST* boolean = dynamic_cast<const BoolExprAST*>(expr)) {
+            value.i = boolean->val();
+            return type == VLANG_TYPE::BOOL;
+        }
+        switch (expr->exp_type()) {
+            case EXP_TYPE::INT_EXP: {
+                if (expr->type()->vlang_type() != VLANG_TYPE::INT32) return false;
+                int32_t val = static_cast<const ConstIntExprAST*>(expr)->val();
+                if (type == VLANG_TYPE::DOUBLE) value.d = val;
+                else value.i = val;
+                return type != VLANG_TYPE::BOOL;
+            }
+            case EXP_TYPE::DOUBLE_EXP:
+                value.d = static_cast<const ConstDoubleExprAST*>(expr)->val();
+                return type == VLANG_TYPE::DOUBLE;
+            case EXP_TYPE::UNARY_EXP: {
+                const UnaryExprAST* unary = static_cast<const UnaryExprAST*>(expr);
+                if (unary->operation() != "-" || ! constantValue(unary->operand(), type, value)) return false;
+                if (type == VLANG_TYPE::DOUBLE) value.d = -value.d;
+                else value.i = (int32_t)(0u - (uint32_t)value.i);
+                return type != VLANG_TYPE::BOOL;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // Errors of compile-time evaluation just give up on the call.
+    void fail(const std::string& message) {
+        if (! m_evaluating) runtimeError(message);
+        m_failed = true;
+    }
+
+    // Counts a step (call or loop iteration) of compile-time evaluation.
+    bool step() {
+        if (! m_evaluating) return true;
+        if (m_budget == 0) {
+            m_failed = true;
+            return false;
+        }
+        --m_budget;
+        return true;
+    }
+
+    void call(VmFunction& f, Slot* frame) {
+        ++f.hotness;
+        if (! m_evaluating && f.native == nullptr && (! f.hasBytecode || f.hotness >= m_threshold)) tierUp(f);
+        if (f.native != nullptr) {
+            f.native(frame);
+            return;
+        }
+        if (! f.hasBytecode) return fail("failed compiling '" + f.name + "'");
+        if (frame + f.registers > m_stack.data() + m_stack.size()) return fail("stack overflow");
+        // Frames of the interpreter live on the compiler's stack
+        if (m_evaluating && m_depth == MaxEvaluationDepth) return fail("recursion too deep");
+        if (! step()) return;
+        ++m_depth;
+        execute(f, frame);
+        --m_depth;
+    }
+
+    void execute(VmFunction& f, Slot* r) {
+        const Instr* code = f.code.data();
+        const Instr* pc = code;
+        for (;;) {
+            const Instr& in = *pc++;
+            switch (in.op) {
+                case Op::LOADK: r[in.a] = f.constants[in.b]; break;
+                case Op::MOV:   r[in.a] = r[in.b]; break;
+
+                // Ints wrap around as in native code
+                case Op::ADD: r[in.a].i = (int32_t)((uint32_t)r[in.b].i + (uint32_t)r[in.c].i); break;
+                case Op::SUB: r[in.a].i = (int32_t)((uint32_t)r[in.b].i - (uint32_t)r[in.c].i); break;
+                case Op::MUL: r[in.a].i = (int32_t)((uint32_t)r[in.b].i * (uint32_t)r[in.c].i); break;
+                case Op::DIV:
+                    if (r[in.c].i == 0) return fail("division by zero");
+                    r[in.a].i = (int32_t)(r[in.b].i / r[in.c].i);
+                    break;
+                case Op::REM:
+                    if (r[in.c].i == 0) return fail("division by zero");
+                    r[in.a].i = (int32_t)(r[in.b].i % r[in.c].i);
+                    break;
+                case Op::FADD: r[in.a].d = r[in.b].d + r[in.c].d; break;
+                case Op::FSUB: r[in.a].d = r[in.b].d - r[in.c].d; break;
+                case Op::FMUL: r[in.a].d = r[in.b].d * r[in.c].d; break;
+                case Op::FDIV: r[in.a].d = r[in.b].d / r[in.c].d; break;
+                case Op::NEG:  r[in.a].i = (int32_t)(0u - (uint32_t)r[in.b].i); break;
+                case Op::FNEG: r[in.a].d = -r[in.b].d; break;
+                case Op::NOT:  r[in.a].i = r[in.b].i ^ 1; break;
+
+                case Op::LT:  r[in.a].i = r[in.b].i <  r[in.c].i; break;
+                case Op::GT:  r[in.a].i = r[in.b].i >  r[in.c].i; break;
+                case Op::LE:  r[in.a].i = r[in.b].i <= r[in.c].i; break;
+                case Op::GE:  r[in.a].i = r[in.b].i >= r[in.c].i; break;
+                case Op::EQ:  r[in.a].i = r[in.b].i == r[in.c].i; break;
+                case Op::NE:  r[in.a].i = r[in.b].i != r[in.c].i; break;
+                case Op::FLT: r[in.a].i = r[in.b].d <  r[in.c].d; break;
+                case Op::FGT: r[in.a].i = r[in.b].d >  r[in.c].d; break;
+                case Op::FLE: r[in.a].i = r[in.b].d <= r[in.c].d; break;
+                case Op::FGE: r[in.a].i = r[in.b].d >= r[in.c].d; break;
+                case Op::FEQ: r[in.a].i = r[in.b].d == r[in.c].d; break;
+                case Op::FNE: r[in.a].i = r[in.b].d != r[in.c].d; break;
+                case Op::I2D: r[in.a].d = (double)r[in.b].i; break;
+                case Op::D2I: r[in.a].i = (int32_t)r[in.b].d; break;
+
+                case Op::JMP:
+                    // Backedges of loops
+                    if (code + in.a < pc) {
+                        ++f.hotness;
+                        if (! step()) return;
+                    }
+                    pc = code + in.a;
+                    break;
+                case Op::JMPF:
+                    if (r[in.a].i == 0) pc = code + in.b;
+                    break;
+                case Op::CALL:
+                    call(*m_functions[in.b], r + in.c);
+                    if (m_failed) return;
+                    if (in.a >= 0) r[in.a] = r[in.c];
+                    break;
+                case Op::RET:
+                    return;
+                case Op::RETV:
+                    r[0] = r[in.a];
+                    return;
+
+                case Op::OUT_TEXT: {
+                    const std::string& text = f.texts[in.a];
+                    vlang_out_write(text.data(), text.size());
+                    break;
+                }
+                case Op::OUT_INT:    vlang_out_int(r[in.a].i); break;
+                case Op::OUT_DOUBLE: vlang_out_double(r[in.a].d, (char)in.c); break;
+            }
+        }
+    }
+
+    // Value of a register as given type and back.
+    static Value* fromSlot(Value* slot, VLANG_TYPE type) {
+        if (type == VLANG_TYPE::DOUBLE) return Builder.CreateBitCast(slot, LLVM_DOUBLETY(), "slot_double");
+        if (type == VLANG_TYPE::BOOL) return Builder.CreateTrunc(slot, LLVM_BOOLTY(), "slot_bool");
+        return Builder.CreateTrunc(slot, LLVM_INTTY(), "slot_int");
+    }
+
+    static Value* toSlot(Value* val, VLANG_TYPE type) {
+        Type* slotType = Type::getInt64Ty(TheContext);
+        if (type == VLANG_TYPE::DOUBLE) return Builder.CreateBitCast(val, slotType, "double_slot");
+        if (type == VLANG_TYPE::BOOL) return Builder.CreateZExt(val, slotType, "bool_slot");
+        return Builder.CreateSExt(val, slotType, "int_slot");
+    }
+
+    // Creates void name.vm_entry(i64* slots) calling given function with arguments from slots.
+    static void createEntry(const VmFunction& f) {
+        Function* callee = TheModule->getFunction(f.name);
+        if (callee == nullptr) return;
+
+        Type* slotsType = Type::getInt64PtrTy(TheContext);
+        FunctionType* type = FunctionType::get(LLVM_VOIDTY(), { slotsType }, false);
+        Function* entry = Function::Create(type, Function::ExternalLinkage, f.name + ".vm_entry", TheModule.get());
+        Builder.SetInsertPoint(BasicBlock::Create(TheContext, "entry", entry));
+
+        Value* slots = &*entry->arg_begin();
+        std::vector<Value*> args;
+        for (unsigned i = 0; i < f.params.size(); ++i) {
+#if LLVM_VERSION_MAJOR >= 13
+            Value* addr = Builder.CreateConstGEP1_32(Type::getInt64Ty(TheContext), slots, i);
+#else
+            Value* addr = Builder.CreateConstGEP1_32(slots, i);
+#endif
+            args.push_back(fromSlot(Builder.CreateLoad(addr, "slot"), f.params[i]));
+        }
+        Value* res = Builder.CreateCall(callee, args);
+        if (f.ret != VLANG_TYPE::VOID) Builder.CreateStore(toSlot(res, f.ret), slots);
+        Builder.CreateRetVoid();
+        verifyFunction(*entry);
+    }
+
+    // Generates the whole program, compiles it with MCJIT and switches every function to it.
+    // Frames already running in the interpreter finish there.
+    void tierUp(const VmFunction& hot) {
+        if (m_engine != nullptr) return;
+        if (hot.hasBytecode)
+            std::cerr << "[run]: '" << hot.name << "' is hot, compiling." << std::endl;
+
+        for (auto &stmt : *m_program) stmt->codegen();
+        for (auto &f : m_functions) createEntry(*f);
+        FinalizeModule();
+
+        unsigned optLevel = util::ProgramOptions::get().optimization_level();
+        if (optLevel > 0) {
+            PassManagerBuilder passes;
+            passes.OptLevel = optLevel;
+#if LLVM_VERSION_MAJOR >= 5
+            passes.Inliner = createFunctionInliningPass(optLevel, 0, false);
+#else
+            passes.Inliner = createFunctionInliningPass(optLevel, 0);
+#endif
+            legacy::FunctionPassManager functionPasses(TheModule.get());
+            legacy::PassManager modulePasses;
+            passes.populateFunctionPassManager(functionPasses);
+            passes.populateModulePassManager(modulePasses);
+            functionPasses.doInitialization();
+            for (auto &f : *TheModule) functionPasses.run(f);
+            functionPasses.doFinalization();
+            modulePasses.run(*TheModule);
+        }
+
+        // Runtime functions are taken from the compiler itself
+        sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+        std::string error;
+        EngineBuilder builder(std::move(TheModule));
+        builder.setErrorStr(&error)
+               .setEngineKind(EngineKind::JIT)
+               .setOptLevel(optLevel == 0 ? CodeGenOpt::None : optLevel == 1 ? CodeGenOpt::Less
+                          : optLevel == 2 ? CodeGenOpt::Default : CodeGenOpt::Aggressive);
+        if (! TargetCPUName.empty()) builder.setMCPU(TargetCPUName);
+        m_engine.reset(builder.create());
+        if (m_engine == nullptr) runtimeError("failed creating JIT: " + error);
+        m_engine->finalizeObject();
+        m_engine->runStaticConstructorsDestructors(false);
+
+        for (auto &f : m_functions)
+            f->native = reinterpret_cast<NativeEntry>(m_engine->getFunctionAddress(f->name + ".vm_entry"));
+    }
+
+    const std::vector<StmtAST*>* m_program;
+    std::vector<std::unique_ptr<VmFunction>> m_functions;
+    std::map<std::string, unsigned> m_indices;
+    std::vector<Slot> m_stack;
+    unsigned m_threshold;
+    std::unique_ptr<ExecutionEngine> m_engine;
+
+    bool m_evaluating;
+    bool m_failed;
+    unsigned m_budget;
+    unsigned m_depth;
+    std::vector<bool> m_pure;
+};
+
+} // ;anonymous
+
+int RunProgram(const std::vector<StmtAST*>* program) {
+    Interpreter interpreter(program);
+    return interpreter.run();
+}
+
+unsigned EvaluateConstantCalls(const std::vector<StmtAST*>* program,
+                               const std::vector<const FunctionCallExprAST*>& calls, unsigned budget) {
+    Interpreter interpreter(program);
+    unsigned evaluated = 0;
+    for (auto &call : calls) {
+        ExprAST* value = interpreter.evaluate(call, budget);
+        if (value == nullptr) continue;
+        ConstantCalls[call].reset(value);
+        ++evaluated;
+    }
+    return evaluated;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
@@ -0,0 +1,47 @@
+/*
+ * Interpreter.hpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef INTERPRETER_HPP
+#define INTERPRETER_HPP
+
+#include "Statement.hpp"
+
+#include <vector>
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// Running programs right away (--run).
+//
+// Functions are compiled straight from the AST into a register bytecode and executed by an
+// interpreter loop, so short programs start without paying for LLVM. Calls and loop backedges
+// make a function hotter, once it reaches --jit-threshold the whole program is generated and
+// compiled by MCJIT (once) and further calls of hot functions run native code. Values cross
+// between the tiers through an entry wrapper generated for every function (name.vm_entry).
+//
+// Bytecode covers functions working with int, double and bool: arithmetic, comparisons, locals,
+// if/while/for, calls and stdout.printf(). Functions using anything else (strings, arrays,
+// objects, vectors...) and programs with classes run native code from the start. Frames which
+// already run in the interpreter stay there, a loop in main doesn't switch to native code.
+
+/// \brief Runs given (analyzed) program, returns the exit code of its main.
+int RunProgram(const std::vector<StmtAST*>* program);
+
+/// \brief Evaluates given calls at compile time and puts their values into ConstantCalls.
+/// Only calls of pure functions (no output, no globals, calling only pure functions) whose
+/// arguments are constants are evaluated, each may take at most budget steps (calls and loop
+/// iterations). Calls used as arguments of other calls should come first. Returns the number
+/// of evaluated calls.
+unsigned EvaluateConstantCalls(const std::vector<StmtAST*>* program,
+                               const std::vector<const FunctionCallExprAST*>& calls, unsigned budget);
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+#endif /* ifndef INTERPRETER_HPP */
@@ -8,10 +8,27 @@
 #include "LLVMCodegen.hpp"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Pass.h"
+#include "llvm/Config/llvm-config.h"
+#if LLVM_VERSION_MAJOR >= 7
+#include "llvm/Transforms/Utils.h"
+#endif
+#if LLVM_VERSION_MAJOR >= 14
+#include "llvm/MC/TargetRegistry.h"
+#else
+#include "llvm/Support/TargetRegistry.h"
+#endif
+#include "llvm/Support/Host.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+#include "llvm/ADT/Triple.h"
 #include "ProgramOptions.hpp"
+#include "DebugInfo.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <thread>
 
 std::unique_ptr<Module> TheModule;
 LLVMContext TheContext;
@@ -20,9 +37,115 @@ std::map<std::string, GlobalVariable*> GlobalValues;
 IRBuilder<> Builder(TheContext);
 std::unique_ptr<legacy::FunctionPassManager> TheFPM;
 
+// Pooled string literals of current module
+std::map<std::string, Constant*> StringLiteralPool;
+
+// Target machine of the module (--march), it gives the data layout
+std::unique_ptr<TargetMachine> TheTargetMachine;
+std::string TargetCPUName;
+std::string TargetCPUFeatures;
+
 Function* mainFunction = nullptr;
 
+// C sources of vlang runtime which are linked with every program.
+const std::string RuntimeSources = "lib/io.c lib/array.c lib/string.c lib/object.c lib/alloc.c lib/cpu.c lib/profile.c lib/instrument.c lib/memo.c lib/parallel.c";
+
+// Options of llc matching the fast-math flags (see getFastMathFlags()).
+static std::string getFloatingPointFlags() {
+    std::string model = vlang::util::ProgramOptions::get().fp_model();
+    if (model == "fast")
+        return " -fp-contract=fast -enable-unsafe-fp-math -enable-no-nans-fp-math -enable-no-infs-fp-math";
+    if (model == "reassoc")
+        return " -fp-contract=fast";
+    return " -fp-contract=off";
+}
+
+// Options of opt and llc selecting the target CPU (see InitializeTarget()).
+static std::string getTargetFlags() {
+    std::string flags;
+    if (! TargetCPUName.empty()) flags += " -mcpu=" + TargetCPUName;
+    if (! TargetCPUFeatures.empty()) flags += " -mattr=" + TargetCPUFeatures;
+    return flags;
+}
+
+// Functions are compiled for the target CPU, unless they already have their own one
+// (clones of [Multiversion] functions).
+static void applyTargetAttributes() {
+    if (TargetCPUName.empty()) return;
+    for (auto &f : *TheModule) {
+        if (f.isDeclaration() || f.hasFnAttribute("target-cpu")) continue;
+        f.addFnAttr("target-cpu", TargetCPUName);
+        if (! TargetCPUFeatures.empty()) f.addFnAttr("target-features", TargetCPUFeatures);
+    }
+}
+
+// Runs an external tool (opt, llvm-split, llc, gcc), returns false if it couldn't run or failed.
+static bool runTool(const std::string& cmd) {
+    return system(cmd.c_str()) == 0;
+}
+
+[[noreturn]] static void toolFailed(const std::string& cmd) {
+    std::cerr << "error: '" << cmd << "' failed, compilation aborted" << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+static void runToolOrAbort(const std::string& cmd) {
+    if (! runTool(cmd)) toolFailed(cmd);
+}
+
+// Modules smaller than this many functions per partition aren't worth splitting.
+static const unsigned MinFunctionsPerPartition = 64;
+
+// Number of partitions the backend translates in parallel (one per -j thread, as long as
+// each one gets enough functions).
+static unsigned getPartitionCount() {
+    unsigned functions = 0;
+    for (auto &f : *TheModule)
+        if (! f.isDeclaration()) ++functions;
+    unsigned partitions = std::min(vlang::util::ProgramOptions::get().jobs(), functions / MinFunctionsPerPartition);
+    return partitions == 0 ? 1 : partitions;
+}
+
+// Translates the optimized module into assembly files, returns their paths. Large modules are
+// split by llvm-split after optimization (so inlining still sees the whole program) and the
+// partitions run through llc on worker threads, machine code generation dominates the time.
+static std::string translateToAssembly(const std::string& flags) {
+    unsigned partitions = getPartitionCount();
+    if (partitions == 1) {
+        std::cerr << "[cc]: Translating to assembly." << std::endl;
+        runToolOrAbort("llc" + flags + " build/tmp.bc -o build/tmp.s");
+        return " build/tmp.s";
+    }
+
+    std::cerr << "[cc]: Translating to assembly (" << partitions << " partitions)." << std::endl;
+    runToolOrAbort("llvm-split -j " + std::to_string(partitions) + " build/tmp.bc -o build/tmp.part");
+
+    std::string assembly;
+    std::vector<std::string> commands;
+    std::vector<char> succeeded(partitions, false);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < partitions; ++i) {
+        std::string part = "build/tmp.part" + std::to_string(i);
+        assembly += " " + part + ".s";
+        commands.push_back("llc" + flags + " " + part + " -o " + part + ".s");
+    }
+    for (unsigned i = 0; i < partitions; ++i)
+        workers.emplace_back([&commands, &succeeded, i]() { succeeded[i] = runTool(commands[i]); });
+    for (auto &w : workers)
+        w.join();
+    for (unsigned i = 0; i < partitions; ++i)
+        if (! succeeded[i]) toolFailed(commands[i]);
+    return assembly;
+}
+
+void FinalizeModule() {
+    vlang::FinalizeDebugInfo();
+    applyTargetAttributes();
+}
+
 void write_llvm_to_bitcode() {
+    FinalizeModule();
+
     std::string output;
     llvm::raw_string_ostream out(output);
     std::cout << output << std::endl;
@@ -38,13 +161,25 @@ void write_llvm_to_bitcode() {
     // Perform translation to assembly and link with glibc
     // llc build/tmp.bc -o build/tmp.s
     // gcc build/tmp.s lib/io.c -o outputPath
-    std::cerr << "[cc]: Translating to assembly." << std::endl;
-    std::string cmd = "llc build/tmp.bc -o build/tmp.s";
-    system(cmd.c_str());
+    // Run LLVM optimizations (loop vectorizer, unroller...) before translation. opt runs on the
+    // whole module, not on the partitions: inlining and interprocedural passes need to see every
+    // function, and it takes a fraction of the time llc does.
+    unsigned optLevel = vlang::util::ProgramOptions::get().optimization_level();
+    std::string optFlag = " -O" + std::to_string(optLevel);
+    if (optLevel > 0) {
+        std::cerr << "[cc]: Optimizing (" << optFlag << ")." << std::endl;
+        runToolOrAbort("opt" + optFlag + getTargetFlags() + " build/tmp.bc -o build/tmp.bc");
+    }
+
+    std::string assembly = translateToAssembly(optFlag + getTargetFlags() + getFloatingPointFlags());
 
-    std::cerr << "Linking with io lib." << std::endl;
-    cmd = "gcc build/tmp.s lib/io.c -o " + outputPath;
-    system(cmd.c_str());
+    std::cerr << "Linking with vlang runtime." << std::endl;
+    std::string runtimeFlags = " -pthread";
+    if (vlang::util::ProgramOptions::get().system_malloc())
+        runtimeFlags += " -DVLANG_USE_MALLOC";
+    if (vlang::util::ProgramOptions::get().debug_info())
+        runtimeFlags += " -g";
+    runToolOrAbort("gcc -O2" + runtimeFlags + assembly + " " + RuntimeSources + " -o " + outputPath + " -lm");
 
     //llvm::raw_fd_ostream OS("module", EC
     //WriteBitcodeToFile(TheModule, OS);
@@ -56,10 +191,70 @@ Value* logError(std::string err_msg) {
     return nullptr;
 }
 
+// Fast-math flags put on every floating point instruction, depending on --fp-model:
+//  strict  - IEEE semantics, operations are neither reordered nor fused,
+//  reassoc - reductions may be reordered (so they vectorize) and multiply-adds fused,
+//  fast    - moreover NaNs, infinities and signed zeros are assumed not to occur.
+static FastMathFlags getFastMathFlags() {
+    FastMathFlags flags;
+    std::string model = vlang::util::ProgramOptions::get().fp_model();
+#if LLVM_VERSION_MAJOR >= 6
+    if (model == "fast") {
+        flags.setFast();
+    } else if (model == "reassoc") {
+        flags.setAllowReassoc();
+        flags.setAllowContract(true);
+    }
+#else
+    // Older LLVM knows only unsafe-algebra, which is what reassociation needs
+    if (model == "fast" || model == "reassoc")
+        flags.setUnsafeAlgebra();
+#endif
+    return flags;
+}
+
+// Resolves the target CPU (--march) and sets the triple and data layout of the module, so
+// the optimizer knows the vector width and costs of the CPU. With native, features are taken
+// from the host, so CPUs which LLVM doesn't know by name still get all their extensions.
+static void InitializeTarget() {
+    std::string triple = sys::getDefaultTargetTriple();
+    TheModule->setTargetTriple(triple);
+
+    TargetCPUName = vlang::util::ProgramOptions::get().target_cpu();
+    TargetCPUFeatures.clear();
+    if (TargetCPUName == "native") {
+        TargetCPUName = sys::getHostCPUName();
+        StringMap<bool> hostFeatures;
+        if (sys::getHostCPUFeatures(hostFeatures))
+            for (auto &feature : hostFeatures) {
+                if (! TargetCPUFeatures.empty()) TargetCPUFeatures += ",";
+                TargetCPUFeatures += (feature.getValue() ? "+" : "-") + feature.getKey().str();
+            }
+    }
+
+    std::string error;
+    const Target* target = TargetRegistry::lookupTarget(triple, error);
+    if (target == nullptr) {
+        std::cerr << "warning: " << error << ", module has no data layout" << std::endl;
+        return;
+    }
+    TheTargetMachine.reset(target->createTargetMachine(triple, TargetCPUName.empty() ? "generic" : TargetCPUName,
+                                                       TargetCPUFeatures, TargetOptions(), Reloc::PIC_));
+    TheModule->setDataLayout(TheTargetMachine->createDataLayout());
+}
+
 void InitializeModuleAndPassManager() {
+    Builder.setFastMathFlags(getFastMathFlags());
     TheModule = make_unique<Module>("VLANG MODULE", TheContext);
+    InitializeTarget();
+    vlang::InitializeDebugInfo();
     TheFPM = make_unique<legacy::FunctionPassManager>(TheModule.get());
+    // Locals are promoted into registers before reference counts are optimized, so retains
+    // and releases of the same value can be matched
+    TheFPM->add(createPromoteMemoryToRegisterPass());
+    TheFPM->add(createCFGSimplificationPass());
     TheFPM->doInitialization();
+    StringLiteralPool.clear();
 }
 
 Function* GetFunction(const std::string& name) {
@@ -85,6 +280,29 @@ AllocaInst* CreateEntryBlockAllocaDouble(Function* TheFunction, const std::strin
     return b.CreateAlloca(Type::getDoubleTy(TheContext), 0, name.c_str());
 }
 
+MDNode* CreateLoopMetadata() {
+    // Loop ID must be distinct and self-referencing, so we create it with a placeholder
+    // operand which is later replaced with the node itself.
+    SmallVector<Metadata*, 4> ops;
+    ops.push_back(nullptr);
+    Metadata* vectorize[] = {
+        MDString::get(TheContext, "llvm.loop.vectorize.enable"),
+        ConstantAsMetadata::get(LLVM_BOOL(true))
+    };
+    ops.push_back(MDNode::get(TheContext, vectorize));
+    Metadata* unroll[] = { MDString::get(TheContext, "llvm.loop.unroll.enable") };
+    ops.push_back(MDNode::get(TheContext, unroll));
+
+    MDNode* loopID = MDNode::getDistinct(TheContext, ops);
+    loopID->replaceOperandWith(0, loopID);
+    return loopID;
+}
+
+AllocaInst* CreateEntryBlockAllocaPtr(Function* TheFunction, Type* type, const std::string& name) {
+    IRBuilder<> b(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
+    return b.CreateAlloca(type, 0, name.c_str());
+}
+
 AllocaInst* GetEntryBlockAllocaForType(Function* TheFunction, Type* type, const std::string& name) {
     if (type == LLVM_INTTY())
         return CreateEntryBlockAllocaInt32(TheFunction, name);
@@ -92,8 +310,234 @@ AllocaInst* GetEntryBlockAllocaForType(Function* TheFunction, Type* type, const
         return CreateEntryBlockAllocaDouble(TheFunction, name);
     else if (type == LLVM_BOOLTY())
         return CreateEntryBlockAllocaBool(TheFunction, name);
+    else if (type->isPointerTy() || type->isStructTy() || type->isIntegerTy() || type->isVectorTy())
+        return CreateEntryBlockAllocaPtr(TheFunction, type, name);
     else {
         std::cerr << "UNKNOWN LLVM TYPE in GetEntryBlockAllocaForType()" << std::endl;
         return nullptr;
     }
 }
+
+StructType* GetArrayStructType(Type* elementType) {
+    std::string name = "vlang.array.";
+    if (elementType->isDoubleTy()) name += "f64";
+    else name += "i" + std::to_string(elementType->getIntegerBitWidth());
+    StructType* arrayTy = TheModule->getTypeByName(name);
+    if (arrayTy != nullptr) return arrayTy;
+
+    Type* fields[] = {
+        Type::getInt64Ty(TheContext),               // length
+        Type::getInt64Ty(TheContext),               // reference count (keeps data 16 byte aligned)
+        llvm::ArrayType::get(elementType, 0)        // data
+    };
+    return StructType::create(TheContext, fields, name);
+}
+
+StructType* GetStringStructType() {
+    StructType* stringTy = TheModule->getTypeByName("vlang.string");
+    if (stringTy != nullptr) return stringTy;
+
+    Type* fields[] = { Type::getInt8PtrTy(TheContext), Type::getInt64Ty(TheContext) };
+    return StructType::create(TheContext, fields, "vlang.string");
+}
+
+Constant* GetStringLiteral(const std::string& str) {
+    auto finder = StringLiteralPool.find(str);
+    if (finder != StringLiteralPool.end()) return finder->second;
+
+    // Literal data is NUL terminated so it can be passed to C as well
+    Constant* data = ConstantDataArray::getString(TheContext, str, true);
+    GlobalVariable* global = new GlobalVariable(*TheModule, data->getType(), true,
+            GlobalValue::PrivateLinkage, data, ".str");
+    global->setUnnamedAddr(true);
+    global->setAlignment(1);
+
+    Constant* idx[] = { LLVM_INT(0), LLVM_INT(0) };
+    Constant* fields[] = {
+        ConstantExpr::getInBoundsGetElementPtr(data->getType(), global, idx),
+        LLVM_INT_SIZE(64, str.size())
+    };
+    Constant* literal = ConstantStruct::get(GetStringStructType(), fields);
+    StringLiteralPool[str] = literal;
+    return literal;
+}
+
+Function* GetRuntimeFunction(const std::string& name, FunctionType* type) {
+    Function* f = TheModule->getFunction(name);
+    if (f != nullptr) return f;
+    return Function::Create(type, Function::ExternalLinkage, name, TheModule.get());
+}
+
+Value* CreateNumericCast(Value* val, Type* type, bool isUnsigned) {
+    Type* from = val->getType();
+    if (from == type) return val;
+    // Scalar operand of a vector operation is converted to the lane type and splatted
+    if (type->isVectorTy() && ! from->isVectorTy()) {
+#if LLVM_VERSION_MAJOR >= 11
+        unsigned lanes = cast<FixedVectorType>(type)->getNumElements();
+#else
+        unsigned lanes = type->getVectorNumElements();
+#endif
+        return Builder.CreateVectorSplat(lanes, CreateNumericCast(val, type->getScalarType(), isUnsigned), "splat");
+    }
+    isUnsigned = isUnsigned || from == LLVM_BOOLTY();
+    if (from->isIntegerTy() && type->isDoubleTy())
+        return isUnsigned ? Builder.CreateUIToFP(val, type, "conv")
+                          : Builder.CreateSIToFP(val, type, "conv");
+    if (from->isDoubleTy() && type->isIntegerTy())
+        return Builder.CreateFPToSI(val, type, "conv");
+    if (from->isIntegerTy() && type->isIntegerTy())
+        return isUnsigned ? Builder.CreateZExtOrTrunc(val, type, "conv")
+                          : Builder.CreateSExtOrTrunc(val, type, "conv");
+    return val;
+}
+
+// Clones of [Multiversion] functions, index + 1 is the level returned by vlang_cpu_level()
+// (lib/cpu.c): x86-64-v3 (AVX2, FMA) and x86-64-v4 (AVX-512).
+static const struct { const char* suffix; const char* cpu; } MultiversionTargets[] = {
+    { "avx2",   "haswell" },
+    { "avx512", "skylake-avx512" },
+};
+
+// Module constructor which picks clones of [Multiversion] functions
+static Function* getMultiversionInit() {
+    Function* init = TheModule->getFunction("vlang.multiversion.init");
+    if (init != nullptr) return init;
+    init = Function::Create(FunctionType::get(LLVM_VOIDTY(), false), Function::InternalLinkage,
+                            "vlang.multiversion.init", TheModule.get());
+    IRBuilder<> b(BasicBlock::Create(TheContext, "entry", init));
+    b.CreateRetVoid();
+    appendToGlobalCtors(*TheModule, init, 0);
+    return init;
+}
+
+static Function* cloneFunction(Function* f, const std::string& name) {
+    ValueToValueMapTy vmap;
+#if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR < 9
+    Function* clone = CloneFunction(f, vmap, false);
+    TheModule->getFunctionList().push_back(clone);
+#else
+    Function* clone = CloneFunction(f, vmap);
+#endif
+    clone->setName(name);
+    clone->setLinkage(Function::InternalLinkage);
+    return clone;
+}
+
+void CreateMultiversion(Function* f) {
+    Triple triple(TheModule->getTargetTriple());
+    if (triple.getArch() != Triple::x86_64 && triple.getArch() != Triple::x86) {
+        std::cerr << "warning: [Multiversion] is ignored on " << triple.str() << std::endl;
+        return;
+    }
+    std::string name = f->getName().str();
+
+    // Clones: the default one is compiled for the target CPU (--march), others for their level
+    std::vector<Function*> versions = { cloneFunction(f, name + ".default") };
+    for (auto &target : MultiversionTargets) {
+        Function* clone = cloneFunction(f, name + "." + target.suffix);
+        clone->addFnAttr("target-cpu", target.cpu);
+        versions.push_back(clone);
+    }
+
+    // Pointer to the selected clone, set once by the module constructor
+    PointerType* fnPtrTy = f->getFunctionType()->getPointerTo();
+    GlobalVariable* impl = new GlobalVariable(*TheModule, fnPtrTy, false, GlobalValue::InternalLinkage,
+                                              versions[0], name + ".impl");
+    Function* init = getMultiversionInit();
+    IRBuilder<> b(init->getEntryBlock().getTerminator());
+    Function* cpuLevel = GetRuntimeFunction("vlang_cpu_level", FunctionType::get(LLVM_INTTY(), false));
+    Value* level = b.CreateCall(cpuLevel, {}, "cpu_level");
+    Value* selected = versions[0];
+    for (unsigned i = 1; i < versions.size(); ++i)
+        selected = b.CreateSelect(b.CreateICmpSGE(level, LLVM_INT(i)), versions[i], selected, name + ".select");
+    b.CreateStore(selected, impl);
+
+    // The function itself only forwards to the selected clone
+    f->deleteBody();
+    b.SetInsertPoint(BasicBlock::Create(TheContext, "entry", f));
+    std::vector<Value*> args;
+    for (auto &arg : f->args()) args.push_back(&arg);
+    CallInst* call = b.CreateCall(b.CreateLoad(impl, name + ".fn"), args);
+    call->setTailCall();
+    if (f->getReturnType()->isVoidTy()) b.CreateRetVoid();
+    else b.CreateRet(call);
+}
+
+// Words of [Memoize] cache keys and values: integers are zero extended, doubles reinterpreted.
+static bool isMemoWord(Type* type) {
+    return type->isDoubleTy() || (type->isIntegerTy() && type->getIntegerBitWidth() <= 64);
+}
+
+static Value* toMemoWord(IRBuilder<>& b, Value* val) {
+    Type* wordTy = Type::getInt64Ty(TheContext);
+    if (val->getType()->isDoubleTy()) return b.CreateBitCast(val, wordTy, "memo_word");
+    return b.CreateZExtOrBitCast(val, wordTy, "memo_word");
+}
+
+static Value* fromMemoWord(IRBuilder<>& b, Value* word, Type* type) {
+    if (type->isDoubleTy()) return b.CreateBitCast(word, type, "memo_value");
+    return b.CreateTruncOrBitCast(word, type, "memo_value");
+}
+
+void CreateMemoize(Function* f) {
+    std::string name = f->getName().str();
+    bool supported = isMemoWord(f->getReturnType());
+    for (auto &arg : f->args()) supported = supported && isMemoWord(arg.getType());
+    if (! supported) {
+        std::cerr << "warning: [Memoize] is ignored on '" << name
+                  << "', only functions of numbers returning a number are memoized" << std::endl;
+        return;
+    }
+    Function* compute = cloneFunction(f, name + ".compute");
+
+    // Cache of the function (lib/memo.c): { i64* entries, i32 capacity, i32 arity }
+    unsigned capacity = 1;
+    while (capacity < vlang::util::ProgramOptions::get().memo_capacity()) capacity <<= 1;
+    Type* wordTy = Type::getInt64Ty(TheContext);
+    PointerType* wordPtrTy = wordTy->getPointerTo();
+    StructType* memoTy = StructType::get(TheContext, { wordPtrTy, LLVM_INTTY(), LLVM_INTTY() });
+    Constant* empty = ConstantStruct::get(memoTy, { ConstantPointerNull::get(wordPtrTy),
+                                                    LLVM_INT(capacity), LLVM_INT(f->arg_size()) });
+    GlobalVariable* memo = new GlobalVariable(*TheModule, memoTy, false, GlobalValue::InternalLinkage,
+                                              empty, name + ".memo");
+    PointerType* memoPtrTy = memoTy->getPointerTo();
+    Function* find = GetRuntimeFunction("vlang_memo_find",
+        FunctionType::get(LLVM_INTTY(), { memoPtrTy, wordPtrTy, wordPtrTy }, false));
+    Function* insert = GetRuntimeFunction("vlang_memo_insert",
+        FunctionType::get(LLVM_VOIDTY(), { memoPtrTy, wordPtrTy, wordTy }, false));
+
+    // The function looks arguments up in the cache, the clone computes missing values.
+    // Recursive calls of the clone go through the cache as well.
+    f->deleteBody();
+    IRBuilder<> b(BasicBlock::Create(TheContext, "entry", f));
+    ArrayType* keyTy = ArrayType::get(wordTy, std::max<size_t>(f->arg_size(), 1));
+    Value* key = b.CreateAlloca(keyTy, nullptr, name + ".key");
+    Value* cached = b.CreateAlloca(wordTy, nullptr, name + ".cached");
+    std::vector<Value*> args;
+    for (auto &arg : f->args()) {
+        b.CreateStore(toMemoWord(b, &arg), b.CreateConstInBoundsGEP2_32(keyTy, key, 0, args.size()));
+        args.push_back(&arg);
+    }
+    Value* keyPtr = b.CreateConstInBoundsGEP2_32(keyTy, key, 0, 0);
+    Value* hit = b.CreateCall(find, { memo, keyPtr, cached }, "memo_hit");
+    BasicBlock* hitBB = BasicBlock::Create(TheContext, "memo_hit", f);
+    BasicBlock* missBB = BasicBlock::Create(TheContext, "memo_miss", f);
+    b.CreateCondBr(b.CreateICmpNE(hit, LLVM_INT(0)), hitBB, missBB);
+
+    b.SetInsertPoint(hitBB);
+    b.CreateRet(fromMemoWord(b, b.CreateLoad(cached, "cached"), f->getReturnType()));
+
+    b.SetInsertPoint(missBB);
+    Value* res = b.CreateCall(compute, args, "computed");
+    b.CreateCall(insert, { memo, keyPtr, toMemoWord(b, res) });
+    b.CreateRet(res);
+}
+
+Value* CreateCondition(Value* cond, const std::string& name) {
+    Type* type = cond->getType();
+    if (type == LLVM_BOOLTY()) return cond;
+    if (type->isDoubleTy())
+        return Builder.CreateFCmpUNE(cond, ConstantFP::get(type, 0.0), name);
+    return Builder.CreateICmpNE(cond, Constant::getNullValue(type), name);
+}
@@ -43,6 +43,7 @@ extern std::map<std::string, AllocaInst*> NamedValues;
 extern std::map<std::string, GlobalVariable*> GlobalValues;
 extern IRBuilder<> Builder;
 extern std::unique_ptr<legacy::FunctionPassManager> TheFPM;
+extern std::string TargetCPUName;
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // Helper functions
@@ -57,6 +58,45 @@ AllocaInst* CreateEntryBlockAllocaIntDouble(Function* TheFunction, const std::st
 
 AllocaInst* GetEntryBlockAllocaForType(Function* TheFunction, Type* type, const std::string& name);
 
+/// \brief Creates a distinct llvm.loop node which enables vectorization and unrolling of loop.
+MDNode* CreateLoopMetadata();
+
+/// \brief Returns (creates if needed) the struct type of an array with given element type:
+/// { i64 length, i64 refcount, [0 x elementType] }
+StructType* GetArrayStructType(Type* elementType);
+
+/// \brief Returns the type of string values: { i8* data, i64 length }
+/// Strings up to 15 bytes built at runtime are stored inline in the value itself (see lib/vlang.h).
+StructType* GetStringStructType();
+
+/// \brief Returns a constant string value for given literal.
+/// Identical literals share one read-only global per module.
+Constant* GetStringLiteral(const std::string& str);
+
+/// \brief Returns (declares if needed) a function from vlang runtime (lib/).
+Function* GetRuntimeFunction(const std::string& name, FunctionType* type);
+
+/// \brief Converts numeric value into given type (int <-> double, bool -> int...).
+/// isUnsigned tells whether the value is of an unsigned integer type (it's zero extended).
+Value* CreateNumericCast(Value* val, Type* type, bool isUnsigned = false);
+
+/// \brief Turns a generated function into a [Multiversion] one: its body is cloned for
+/// newer CPUs (AVX2, AVX-512) and calls are dispatched to the best clone the CPU running the
+/// program supports, picked once at startup.
+void CreateMultiversion(Function* f);
+
+/// \brief Turns a generated function into a [Memoize] one: its body is moved into a clone and
+/// the function returns values cached by arguments, calling the clone only for new ones.
+/// Functions taking or returning anything else than numbers are left as they are.
+void CreateMemoize(Function* f);
+
+/// \brief Converts a condition of if/while/for into i1. Comparisons already are i1, so they
+/// feed the branch directly, numbers are compared against zero.
+Value* CreateCondition(Value* cond, const std::string& name);
+
+/// \brief Finishes the module once all code is generated (debug info, target attributes).
+void FinalizeModule();
+
 void write_llvm_to_bitcode();
 
 #endif /* ifndef LLVM_CODEGEN_HPP */
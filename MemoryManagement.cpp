@@ -0,0 +1,456 @@
+/*
+ * MemoryManagement.cpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "MemoryManagement.hpp"
+#include "AstVisitor.hpp"
+#include "GlobalContainers.hpp"
+#include "ProgramOptions.hpp"
+#include "llvm/IR/MDBuilder.h"
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// Bit of string length which marks a reference counted heap buffer (see lib/vlang.h).
+static const uint64_t StringHeapFlag = 1ULL << 62;
+
+// Managed locals and stack allocated objects of current function.
+static std::vector<std::pair<AllocaInst*, VLANG_TYPE>> ManagedLocals;
+static std::vector<std::pair<AllocaInst*, const ClassAST*>> StackObjects;
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Reference count updates
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Adds delta to the count at given address and returns the new count. Counts are updated
+// atomically only if asked for (--atomic-rc), single threaded programs don't pay for it.
+// [Parallel] loops sharing counted values are rejected without it (see ParallelCheck).
+static Value* createCountUpdate(IRBuilder<>& b, Value* counter, int delta) {
+    Value* d = ConstantInt::get(Type::getInt64Ty(TheContext), delta, true);
+    if (util::ProgramOptions::get().atomic_refcount()) {
+        Value* old = b.CreateAtomicRMW(AtomicRMWInst::Add, counter, d,
+                delta > 0 ? AtomicOrdering::Monotonic : AtomicOrdering::AcquireRelease);
+        return b.CreateAdd(old, d, "count");
+    }
+    Value* count = b.CreateAdd(b.CreateLoad(counter, "old_count"), d, "count");
+    b.CreateStore(count, counter);
+    return count;
+}
+
+// Creates an always inlined helper with given parameters. Helpers are internal to the module,
+// so they disappear once they are inlined into their callers.
+static Function* createHelper(const std::string& name, std::vector<Type*> params) {
+    FunctionType* type = FunctionType::get(LLVM_VOIDTY(), params, false);
+    Function* f = Function::Create(type, Function::InternalLinkage, name, TheModule.get());
+    f->addFnAttr(Attribute::AlwaysInline);
+    f->addFnAttr(Attribute::NoUnwind);
+    return f;
+}
+
+// vlang.retain(i8* object, i64 counterOffset)
+static Function* getRetainHelper() {
+    Function* f = TheModule->getFunction("vlang.retain");
+    if (f != nullptr) return f;
+    Type* i64 = Type::getInt64Ty(TheContext);
+    f = createHelper("vlang.retain", { Type::getInt8PtrTy(TheContext), i64 });
+    auto arg = f->arg_begin();
+    Value* object = &*arg++;
+    Value* offset = &*arg;
+
+    BasicBlock* entryBB = BasicBlock::Create(TheContext, "entry", f);
+    BasicBlock* incBB = BasicBlock::Create(TheContext, "inc", f);
+    BasicBlock* doneBB = BasicBlock::Create(TheContext, "done", f);
+    IRBuilder<> b(entryBB);
+    b.CreateCondBr(b.CreateIsNull(object), doneBB, incBB);
+    b.SetInsertPoint(incBB);
+    Value* counter = b.CreateBitCast(b.CreateInBoundsGEP(object, offset), i64->getPointerTo(), "counter");
+    createCountUpdate(b, counter, 1);
+    b.CreateBr(doneBB);
+    b.SetInsertPoint(doneBB);
+    b.CreateRetVoid();
+    return f;
+}
+
+// vlang.release(i8* object, i64 counterOffset, void (i8*)* destroy)
+static Function* getReleaseHelper() {
+    Function* f = TheModule->getFunction("vlang.release");
+    if (f != nullptr) return f;
+    Type* i8p = Type::getInt8PtrTy(TheContext);
+    Type* i64 = Type::getInt64Ty(TheContext);
+    Type* destroyTy = FunctionType::get(LLVM_VOIDTY(), { i8p }, false)->getPointerTo();
+    f = createHelper("vlang.release", { i8p, i64, destroyTy });
+    auto arg = f->arg_begin();
+    Value* object = &*arg++;
+    Value* offset = &*arg++;
+    Value* destroy = &*arg;
+
+    BasicBlock* entryBB = BasicBlock::Create(TheContext, "entry", f);
+    BasicBlock* decBB = BasicBlock::Create(TheContext, "dec", f);
+    BasicBlock* destroyBB = BasicBlock::Create(TheContext, "destroy", f);
+    BasicBlock* doneBB = BasicBlock::Create(TheContext, "done", f);
+    IRBuilder<> b(entryBB);
+    b.CreateCondBr(b.CreateIsNull(object), doneBB, decBB);
+    b.SetInsertPoint(decBB);
+    Value* counter = b.CreateBitCast(b.CreateInBoundsGEP(object, offset), i64->getPointerTo(), "counter");
+    Value* count = createCountUpdate(b, counter, -1);
+    MDBuilder md(TheContext);
+    b.CreateCondBr(b.CreateICmpEQ(count, ConstantInt::get(i64, 0)), destroyBB, doneBB, md.createBranchWeights(1, 16));
+    b.SetInsertPoint(destroyBB);
+    b.CreateCall(destroy, { object });
+    b.CreateBr(doneBB);
+    b.SetInsertPoint(doneBB);
+    b.CreateRetVoid();
+    return f;
+}
+
+// vlang.retain.string(vlang.string) and vlang.release.string(vlang.string), only strings
+// with a heap buffer are counted.
+static Function* getStringHelper(bool retain) {
+    std::string name = retain ? "vlang.retain.string" : "vlang.release.string";
+    Function* f = TheModule->getFunction(name);
+    if (f != nullptr) return f;
+    Type* i8p = Type::getInt8PtrTy(TheContext);
+    Type* i64 = Type::getInt64Ty(TheContext);
+    f = createHelper(name, { GetStringStructType() });
+    Value* str = &*f->arg_begin();
+
+    BasicBlock* entryBB = BasicBlock::Create(TheContext, "entry", f);
+    BasicBlock* updateBB = BasicBlock::Create(TheContext, "update", f);
+    BasicBlock* doneBB = BasicBlock::Create(TheContext, "done", f);
+    IRBuilder<> b(entryBB);
+    Value* data = b.CreateExtractValue(str, 0, "data");
+    Value* length = b.CreateExtractValue(str, 1, "length");
+    Value* isHeap = b.CreateICmpNE(b.CreateAnd(length, ConstantInt::get(i64, StringHeapFlag)),
+                                   ConstantInt::get(i64, 0), "is_heap");
+    b.CreateCondBr(isHeap, updateBB, doneBB);
+
+    // Count is stored in front of the data
+    b.SetInsertPoint(updateBB);
+    Value* counter = b.CreateBitCast(b.CreateInBoundsGEP(data, ConstantInt::get(i64, -8, true)),
+                                     i64->getPointerTo(), "counter");
+    Value* count = createCountUpdate(b, counter, retain ? 1 : -1);
+    if (retain) {
+        b.CreateBr(doneBB);
+    } else {
+        BasicBlock* freeBB = BasicBlock::Create(TheContext, "free", f, doneBB);
+        MDBuilder md(TheContext);
+        b.CreateCondBr(b.CreateICmpEQ(count, ConstantInt::get(i64, 0)), freeBB, doneBB, md.createBranchWeights(1, 16));
+        b.SetInsertPoint(freeBB);
+        Type* params[] = { i8p, i64 };
+        Function* stringFree = GetRuntimeFunction("vlang_string_free", FunctionType::get(LLVM_VOIDTY(), params, false));
+        Value* args[] = { data, b.CreateAnd(length, ConstantInt::get(i64, ~StringHeapFlag)) };
+        b.CreateCall(stringFree, args);
+        b.CreateBr(doneBB);
+    }
+    b.SetInsertPoint(doneBB);
+    b.CreateRetVoid();
+    return f;
+}
+
+// Destroy function of given array type, e.g. "int[].destroy", the runtime needs the element
+// size to know the size of the buffer.
+static Function* getArrayDestroy(VLANG_TYPE type) {
+    std::unique_ptr<VlangType> array(make_from_enum(type));
+    std::string name = array->str() + ".destroy";
+    Function* f = TheModule->getFunction(name);
+    if (f != nullptr) return f;
+    Type* i8p = Type::getInt8PtrTy(TheContext);
+    Type* i64 = Type::getInt64Ty(TheContext);
+    f = createHelper(name, { i8p });
+
+    IRBuilder<> b(BasicBlock::Create(TheContext, "entry", f));
+    std::unique_ptr<VlangType> elem(make_from_enum(element_of(type)));
+    Type* params[] = { i8p, i64 };
+    Function* arrayFree = GetRuntimeFunction("vlang_array_free", FunctionType::get(LLVM_VOIDTY(), params, false));
+    Value* args[] = { &*f->arg_begin(), ConstantExpr::getSizeOf(elem->llvm_type()) };
+    b.CreateCall(arrayFree, args);
+    b.CreateRetVoid();
+    return f;
+}
+
+// Offset of the reference count inside objects (header) and arrays (after length).
+static Value* counterOffset(VLANG_TYPE type) {
+    return LLVM_INT_SIZE(64, is_array(type) ? 8 : 0);
+}
+
+void CreateRetain(Value* val, VLANG_TYPE type) {
+    if (! is_managed(type)) return;
+    if (type == VLANG_TYPE::STRING) {
+        Builder.CreateCall(getStringHelper(true), { val });
+        return;
+    }
+    Value* args[] = { Builder.CreateBitCast(val, Type::getInt8PtrTy(TheContext)), counterOffset(type) };
+    Builder.CreateCall(getRetainHelper(), args);
+}
+
+void CreateRelease(Value* val, VLANG_TYPE type) {
+    if (! is_managed(type)) return;
+    if (type == VLANG_TYPE::STRING) {
+        Builder.CreateCall(getStringHelper(false), { val });
+        return;
+    }
+    Function* destroy = is_class(type) ? GetDestroyFunction(GetClass(type)) : getArrayDestroy(type);
+    Value* args[] = { Builder.CreateBitCast(val, Type::getInt8PtrTy(TheContext)), counterOffset(type), destroy };
+    Builder.CreateCall(getReleaseHelper(), args);
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Ownership
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool IsOwnedValue(const ExprAST* expr) {
+    if (! is_managed(expr->type()->vlang_type())) return false;
+    switch (expr->exp_type()) {
+    case EXP_TYPE::NEW_OBJECT_EXP:
+        return StackAllocatedObjects.count(expr) == 0;
+    case EXP_TYPE::CALL_EXP:
+    case EXP_TYPE::METHOD_EXP:
+    case EXP_TYPE::ARRAY_NEW_EXP:
+    case EXP_TYPE::ARRAY_LITERAL_EXP:
+        return true;
+    case EXP_TYPE::BINARY_EXP:
+        return static_cast<const BinaryExprAST*>(expr)->operation() == "+";
+    default:
+        return false;
+    }
+}
+
+// Returns true if a borrowed value of expression can't be released while it's being used.
+// Callees can't change locals of their caller and literals aren't counted at all, anything
+// else (fields...) can be overwritten by a call, so it has to be retained while it's used.
+static bool isPinnedValue(const ExprAST* expr) {
+    if (expr->exp_type() == EXP_TYPE::STRING_EXP) return true;
+    if (expr->exp_type() != EXP_TYPE::VARIABLE_EXP) return false;
+    return NamedValues.count(static_cast<const VariableExprAST*>(expr)->name()) != 0;
+}
+
+// Counts reads of given variable, reads inside loops count twice (they can happen many times).
+class ReadCounter : public AstVisitor {
+public:
+    ReadCounter(const AstWalker& walker, const std::string& name)
+        : m_walker(walker), m_name(name), m_reads(0)
+    {}
+
+    virtual void visit(const ExprAST* expr) {
+        long weight = 1l << std::min(m_walker.loop_depth(), 16u);
+        switch (expr->exp_type()) {
+        case EXP_TYPE::VARIABLE_EXP:
+            if (static_cast<const VariableExprAST*>(expr)->name() == m_name) m_reads += weight;
+            break;
+        case EXP_TYPE::INDEX_EXP:
+            if (static_cast<const ArrayIndexExprAST*>(expr)->name() == m_name) m_reads += weight;
+            break;
+        case EXP_TYPE::LENGTH_EXP:
+            if (static_cast<const ArrayLengthExprAST*>(expr)->name() == m_name) m_reads += weight;
+            break;
+        case EXP_TYPE::BINARY_EXP: {
+            // Target of an assignment is walked as an operand, but it isn't read
+            const BinaryExprAST* bin = static_cast<const BinaryExprAST*>(expr);
+            if (bin->operation() == "=" && bin->left()->exp_type() == EXP_TYPE::VARIABLE_EXP
+                    && static_cast<const VariableExprAST*>(bin->left())->name() == m_name)
+                m_reads -= weight;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    unsigned reads() const { return static_cast<unsigned>(m_reads); }
+
+private:
+    const AstWalker& m_walker;
+    const std::string& m_name;
+    long m_reads;
+};
+
+static unsigned countStmtReads(const StmtAST* stmt, const std::string& name) {
+    AstWalker walker;
+    ReadCounter counter(walker, name);
+    walker.add(&counter);
+    walker.walk(stmt);
+    return counter.reads();
+}
+
+Value* CreateOwnedValue(const ExprAST* expr, bool isReturn) {
+    VLANG_TYPE type = expr->type()->vlang_type();
+    if (is_managed(type) && expr->exp_type() == EXP_TYPE::VARIABLE_EXP) {
+        // Local which is read only here (outside of loops) or which is returned doesn't need
+        // its value anymore, so the value is moved out of it instead of being retained.
+        const std::string& name = static_cast<const VariableExprAST*>(expr)->name();
+        auto finder = NamedValues.find(name);
+        if (finder != NamedValues.end() && IsManagedLocal(finder->second)
+                && (isReturn || countStmtReads(CurrentFunctionBody, name) == 1)) {
+            Value* val = Builder.CreateLoad(finder->second, name + "_moved");
+            Builder.CreateStore(Constant::getNullValue(val->getType()), finder->second);
+            return val;
+        }
+    }
+    Value* val = expr->codegen();
+    if (val != nullptr && ! IsOwnedValue(expr)) CreateRetain(val, type);
+    return val;
+}
+
+Value* CreateOperand(const ExprAST* expr, Temporaries& temporaries) {
+    Value* val = expr->codegen();
+    VLANG_TYPE type = expr->type()->vlang_type();
+    if (val == nullptr || ! is_managed(type)) return val;
+    if (IsOwnedValue(expr)) {
+        temporaries.push_back(std::make_pair(val, type));
+    } else if (! isPinnedValue(expr)) {
+        CreateRetain(val, type);
+        temporaries.push_back(std::make_pair(val, type));
+    }
+    return val;
+}
+
+void ReleaseTemporaries(Temporaries& temporaries) {
+    for (auto &t : temporaries)
+        CreateRelease(t.first, t.second);
+    temporaries.clear();
+}
+
+Value* CreateOwnedStore(Value* val, Value* addr, VLANG_TYPE type) {
+    // New value is already retained, so storing a variable into itself is fine
+    Value* old = Builder.CreateLoad(addr, "old");
+    Value* store = Builder.CreateStore(val, addr);
+    CreateRelease(old, type);
+    return store;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Locals and objects
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Stores given value right after an alloca in the entry block.
+static void storeAfterAlloca(AllocaInst* addr, Value* val) {
+    IRBuilder<> b(TheContext);
+    Instruction* next = addr->getNextNode();
+    if (next != nullptr) b.SetInsertPoint(next);
+    else b.SetInsertPoint(addr->getParent());
+    b.CreateStore(val, addr);
+}
+
+static bool hasManagedFields(const ClassAST* c) {
+    for (auto &f : c->fields())
+        if (is_managed(f.type)) return true;
+    return false;
+}
+
+void RegisterManagedLocal(AllocaInst* addr, VLANG_TYPE type) {
+    storeAfterAlloca(addr, Constant::getNullValue(addr->getAllocatedType()));
+    ManagedLocals.push_back(std::make_pair(addr, type));
+}
+
+bool IsManagedLocal(Value* addr) {
+    for (auto &local : ManagedLocals)
+        if (local.first == addr) return true;
+    return false;
+}
+
+void RegisterStackObject(AllocaInst* object, const ClassAST* c) {
+    if (! hasManagedFields(c)) return;
+    storeAfterAlloca(object, Constant::getNullValue(object->getAllocatedType()));
+    StackObjects.push_back(std::make_pair(object, c));
+}
+
+void CreateReleaseFields(Value* object, const ClassAST* c) {
+    for (auto &f : c->fields()) {
+        if (! is_managed(f.type)) continue;
+        Value* addr = Builder.CreateStructGEP(nullptr, object, c->field_index(f.name), f.name + "_addr");
+        CreateRelease(Builder.CreateLoad(addr, f.name), f.type);
+    }
+}
+
+void ResetFunctionCleanup() {
+    ManagedLocals.clear();
+    StackObjects.clear();
+}
+
+void CreateFunctionCleanup() {
+    for (auto &local : ManagedLocals)
+        CreateRelease(Builder.CreateLoad(local.first, local.first->getName()), local.second);
+    for (auto &object : StackObjects)
+        CreateReleaseFields(object.first, object.second);
+}
+
+Function* GetDestroyFunction(const ClassAST* c) {
+    std::string name = c->name() + ".destroy";
+    Function* f = TheModule->getFunction(name);
+    if (f != nullptr) return f;
+    FunctionType* type = FunctionType::get(LLVM_VOIDTY(), { Type::getInt8PtrTy(TheContext) }, false);
+    return Function::Create(type, Function::ExternalLinkage, name, TheModule.get());
+}
+
+void CreateDestroyFunction(const ClassAST* c) {
+    Function* f = GetDestroyFunction(c);
+    if (! f->empty()) return;
+    Value* raw = &*f->arg_begin();
+    raw->setName("raw");
+
+    Builder.SetInsertPoint(BasicBlock::Create(TheContext, "entry", f));
+    CreateReleaseFields(Builder.CreateBitCast(raw, c->llvm_type()->getPointerTo(), "object"), c);
+    Type* params[] = { Type::getInt8PtrTy(TheContext), Type::getInt64Ty(TheContext) };
+    Function* objectFree = GetRuntimeFunction("vlang_object_free", FunctionType::get(LLVM_VOIDTY(), params, false));
+    Value* args[] = { raw, ConstantExpr::getSizeOf(c->llvm_type()) };
+    Builder.CreateCall(objectFree, args);
+    Builder.CreateRetVoid();
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Redundant retain/release elimination
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Returns the name of reference counting helper called by given instruction ("" if none).
+static std::string refCountHelper(const Instruction* inst) {
+    const CallInst* call = dyn_cast<CallInst>(inst);
+    if (call == nullptr || call->getCalledFunction() == nullptr) return "";
+    StringRef name = call->getCalledFunction()->getName();
+    return name.startswith("vlang.retain") || name.startswith("vlang.release") ? name.str() : "";
+}
+
+static Value* refCountOperand(const Instruction* inst) {
+    return cast<CallInst>(inst)->getArgOperand(0)->stripPointerCasts();
+}
+
+// A retain can be dropped together with a later release of the same value if nothing between
+// them can destroy the value: no release of another value (it could own the last reference)
+// and no call which writes memory. Arguments are kept alive by the caller during the whole
+// call, so their pairs are removed regardless of what's between them.
+unsigned OptimizeRefCounts(Function* f) {
+    unsigned removed = 0;
+    for (auto &bb : *f) {
+        for (auto it = bb.begin(); it != bb.end(); ) {
+            Instruction* retain = &*it++;
+            std::string helper = refCountHelper(retain);
+            if (helper != "vlang.retain" && helper != "vlang.retain.string") continue;
+
+            Value* val = refCountOperand(retain);
+            bool pinned = isa<Argument>(val);
+            Instruction* release = nullptr;
+            for (Instruction* inst = retain->getNextNode(); inst != nullptr; inst = inst->getNextNode()) {
+                std::string h = refCountHelper(inst);
+                if (h.compare(0, 13, "vlang.release") == 0) {
+                    if (refCountOperand(inst) == val) {
+                        release = inst;
+                        break;
+                    }
+                    if (! pinned) break;
+                } else if (h.empty() && isa<CallInst>(inst) && ! pinned
+                        && ! cast<CallInst>(inst)->onlyReadsMemory()) {
+                    break;
+                }
+            }
+            if (release == nullptr) continue;
+            if (&*it == release) ++it;
+            retain->eraseFromParent();
+            release->eraseFromParent();
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
@@ -0,0 +1,97 @@
+/*
+ * MemoryManagement.hpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef MEMORY_MANAGEMENT_HPP
+#define MEMORY_MANAGEMENT_HPP
+
+#include "LLVMCodegen.hpp"
+#include "Statement.hpp"
+
+#include <vector>
+#include <utility>
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// Reference counting of objects, arrays and heap strings.
+//
+// Every managed value has a reference count: objects in their header word, arrays in the
+// word after length and long strings built at runtime in the 8 bytes before their data
+// (literals and short inline strings aren't counted at all).
+//
+// Ownership rules used by the code generator:
+//  * variables and fields own their values, they are released when overwritten and
+//    locals are released when the function returns,
+//  * values produced by new, calls, concatenation... are owned (+1), reading a variable
+//    or field gives a borrowed value (+0) which is retained only when it's stored,
+//  * parameters are borrowed, the caller keeps its reference until the call returns,
+//  * returned values are owned by the caller, returning a local moves it out of the local.
+
+/// \brief Managed values which have to be released once an expression is evaluated.
+typedef std::vector<std::pair<Value*, VLANG_TYPE>> Temporaries;
+
+/// \brief Returns true if expression produces a new reference (+1) to a managed value.
+bool IsOwnedValue(const ExprAST* expr);
+
+/// \brief Emits an increment of reference count of given managed value (null is ignored).
+void CreateRetain(Value* val, VLANG_TYPE type);
+
+/// \brief Emits a decrement of reference count of given managed value, value is destroyed
+/// when the count drops to zero (null is ignored).
+void CreateRelease(Value* val, VLANG_TYPE type);
+
+/// \brief Generates expression as an owned value: borrowed values are retained, locals
+/// which are not read anywhere else (or are returned) are moved out of their variable.
+Value* CreateOwnedValue(const ExprAST* expr, bool isReturn = false);
+
+/// \brief Generates expression used as an operand (call argument, receiver...). Value stays
+/// valid until temporaries are released with ReleaseTemporaries().
+Value* CreateOperand(const ExprAST* expr, Temporaries& temporaries);
+
+/// \brief Releases temporaries collected by CreateOperand().
+void ReleaseTemporaries(Temporaries& temporaries);
+
+/// \brief Stores an owned value into given variable or field, releasing the old value.
+/// Returns the store instruction.
+Value* CreateOwnedStore(Value* val, Value* addr, VLANG_TYPE type);
+
+/// \brief Registers a local variable which owns its value: it's initialized to null in the
+/// entry block and released by CreateFunctionCleanup().
+void RegisterManagedLocal(AllocaInst* addr, VLANG_TYPE type);
+
+/// \brief Returns true if given local variable owns its value (it's not a borrowed parameter).
+bool IsManagedLocal(Value* addr);
+
+/// \brief Registers a stack allocated object, its fields are released by CreateFunctionCleanup().
+void RegisterStackObject(AllocaInst* object, const ClassAST* c);
+
+/// \brief Releases managed fields of given object.
+void CreateReleaseFields(Value* object, const ClassAST* c);
+
+/// \brief Forgets managed locals of the previous function.
+void ResetFunctionCleanup();
+
+/// \brief Releases all managed locals and stack objects of current function (emitted once,
+/// in the block all returns branch to).
+void CreateFunctionCleanup();
+
+/// \brief Returns (declares if needed) the destroy function of given class.
+Function* GetDestroyFunction(const ClassAST* c);
+
+/// \brief Generates the body of class destroy function: releases fields and frees the object.
+void CreateDestroyFunction(const ClassAST* c);
+
+/// \brief Removes redundant retain/release pairs from given (already promoted) function.
+/// Returns the number of removed pairs.
+unsigned OptimizeRefCounts(Function* f);
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+#endif /* ifndef MEMORY_MANAGEMENT_HPP */
@@ -0,0 +1,227 @@
+/*
+ * Profile.cpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "Profile.hpp"
+#include "ProgramOptions.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <limits>
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// Profile of current function
+static Function* ProfiledFunction = nullptr;
+static std::vector<BranchInst*> ProfiledBranches;
+// --profile-generate: counters are sized once all sites are known, until then they are
+// addressed through a placeholder
+static GlobalVariable* CountersPlaceholder = nullptr;
+
+// --instrument: { calls, cycles } of current function and the cycle counter at its entry
+static GlobalVariable* InstrumentCounters = nullptr;
+static AllocaInst* InstrumentStart = nullptr;
+
+// --profile-use: counters of functions read from the profile file
+static std::map<std::string, std::vector<uint64_t>> ProfileCounts;
+static bool ProfileLoaded = false;
+
+// Reads the profile file: "# vlang profile" line, then "name n c0 ... cn-1" per function.
+static void loadProfile(const std::string& path) {
+    ProfileLoaded = true;
+    std::ifstream in(path);
+    if (! in) {
+        std::cerr << "warning: can't read profile '" << path
+                  << "', compiling without it" << std::endl;
+        return;
+    }
+    std::string line;
+    if (! std::getline(in, line) || line != "# vlang profile") {
+        std::cerr << "warning: '" << path << "' isn't a vlang profile, compiling without it" << std::endl;
+        return;
+    }
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        size_t count = 0;
+        if (! (fields >> name >> count)) continue;
+        std::vector<uint64_t> counts(count);
+        for (auto &c : counts) fields >> c;
+        if (fields) ProfileCounts[name] = counts;
+    }
+}
+
+// Module constructor which registers counters of all functions with the runtime (profile
+// and instrumentation)
+static Function* getProfileInit() {
+    Function* init = TheModule->getFunction("vlang.profile.init");
+    if (init != nullptr) return init;
+    init = Function::Create(FunctionType::get(LLVM_VOIDTY(), false), Function::InternalLinkage,
+                            "vlang.profile.init", TheModule.get());
+    IRBuilder<> b(BasicBlock::Create(TheContext, "entry", init));
+    b.CreateRetVoid();
+    appendToGlobalCtors(*TheModule, init, 0);
+    return init;
+}
+
+// Adds delta to a counter. Updates are atomic, bodies of [Parallel] loops and functions called
+// from them run on several threads and plain increments would lose counts of the hottest code.
+static void createCounterAdd(Value* addr, Value* delta) {
+#if LLVM_VERSION_MAJOR >= 13
+    Builder.CreateAtomicRMW(AtomicRMWInst::Add, addr, delta, MaybeAlign(8), AtomicOrdering::Monotonic);
+#else
+    Builder.CreateAtomicRMW(AtomicRMWInst::Add, addr, delta, AtomicOrdering::Monotonic);
+#endif
+}
+
+// Increments counter with given index (i64) of current function.
+static void createCounterIncrement(Value* index) {
+    Value* idx[] = { LLVM_INT_SIZE(64, 0), index };
+    createCounterAdd(Builder.CreateInBoundsGEP(CountersPlaceholder, idx, "prof_counter"), LLVM_INT_SIZE(64, 1));
+}
+
+void BeginFunctionProfile(Function* f) {
+    const util::ProgramOptions& options = util::ProgramOptions::get();
+    ProfiledFunction = f;
+    ProfiledBranches.clear();
+    CountersPlaceholder = nullptr;
+    if (! options.profile_generate().empty()) {
+        Type* countersTy = llvm::ArrayType::get(Type::getInt64Ty(TheContext), 0);
+        CountersPlaceholder = new GlobalVariable(*TheModule, countersTy, false, GlobalValue::ExternalLinkage,
+                                                 nullptr, f->getName() + ".prof.tmp");
+        createCounterIncrement(LLVM_INT_SIZE(64, 0));
+    }
+    if (! options.profile_use().empty() && ! ProfileLoaded)
+        loadProfile(options.profile_use());
+}
+
+BranchInst* CreateProfiledCondBr(Value* cond, BasicBlock* trueBB, BasicBlock* falseBB) {
+    // Counters of a site are 1 + 2 * site (true) and the one after it (false)
+    uint64_t site = ProfiledBranches.size();
+    if (CountersPlaceholder != nullptr) {
+        Value* isFalse = Builder.CreateZExt(Builder.CreateNot(cond), Type::getInt64Ty(TheContext));
+        createCounterIncrement(Builder.CreateAdd(LLVM_INT_SIZE(64, 1 + 2 * site), isFalse, "prof_index"));
+    }
+    BranchInst* br = Builder.CreateCondBr(cond, trueBB, falseBB);
+    ProfiledBranches.push_back(br);
+    return br;
+}
+
+// Branch weights are 32 bit, counts are scaled down so the larger one fits.
+static MDNode* createBranchWeights(uint64_t taken, uint64_t notTaken) {
+    uint64_t scale = std::max(taken, notTaken) / std::numeric_limits<uint32_t>::max() + 1;
+    MDBuilder md(TheContext);
+    return md.createBranchWeights(taken / scale, notTaken / scale);
+}
+
+void EndFunctionProfile() {
+    if (ProfiledFunction == nullptr) return;
+    std::string name = ProfiledFunction->getName().str();
+    uint64_t numCounters = 1 + 2 * ProfiledBranches.size();
+
+    if (CountersPlaceholder != nullptr) {
+        Type* countersTy = llvm::ArrayType::get(Type::getInt64Ty(TheContext), numCounters);
+        GlobalVariable* counters = new GlobalVariable(*TheModule, countersTy, false, GlobalValue::InternalLinkage,
+                                                      ConstantAggregateZero::get(countersTy), name + ".prof");
+        CountersPlaceholder->replaceAllUsesWith(ConstantExpr::getBitCast(counters, CountersPlaceholder->getType()));
+        CountersPlaceholder->eraseFromParent();
+        CountersPlaceholder = nullptr;
+
+        Function* init = getProfileInit();
+        IRBuilder<> b(init->getEntryBlock().getTerminator());
+        Type* i8ptr = Type::getInt8PtrTy(TheContext);
+        Type* i64 = Type::getInt64Ty(TheContext);
+        Type* params[] = { i8ptr, i64->getPointerTo(), i64, i8ptr };
+        Function* reg = GetRuntimeFunction("vlang_profile_register", FunctionType::get(LLVM_VOIDTY(), params, false));
+        Value* args[] = {
+            b.CreateGlobalStringPtr(name, "prof_name"),
+            b.CreateConstInBoundsGEP2_64(counters, 0, 0),
+            LLVM_INT_SIZE(64, numCounters),
+            b.CreateGlobalStringPtr(util::ProgramOptions::get().profile_generate(), "prof_path")
+        };
+        b.CreateCall(reg, args);
+    }
+
+    if (ProfileLoaded) {
+        auto finder = ProfileCounts.find(name);
+        if (finder != ProfileCounts.end() && finder->second.size() == numCounters) {
+            const std::vector<uint64_t>& counts = finder->second;
+            ProfiledFunction->setEntryCount(counts[0]);
+            for (unsigned i = 0; i < ProfiledBranches.size(); ++i)
+                ProfiledBranches[i]->setMetadata(LLVMContext::MD_prof, createBranchWeights(counts[1 + 2 * i], counts[2 + 2 * i]));
+        } else if (finder != ProfileCounts.end()) {
+            std::cerr << "warning: profile of '" << name
+                      << "' doesn't match its code, it's ignored" << std::endl;
+        }
+    }
+    ProfiledFunction = nullptr;
+    ProfiledBranches.clear();
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Function instrumentation
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Flags of vlang_instrument_register(), they tell the runtime which columns are measured.
+static const int InstrumentCalls = 1;
+static const int InstrumentTime = 2;
+
+void BeginFunctionInstrumentation(Function* f) {
+    const util::ProgramOptions& options = util::ProgramOptions::get();
+    InstrumentCounters = nullptr;
+    InstrumentStart = nullptr;
+    if (! options.instrument_calls() && ! options.instrument_time()) return;
+
+    Type* i64 = Type::getInt64Ty(TheContext);
+    Type* countersTy = llvm::ArrayType::get(i64, 2);
+    InstrumentCounters = new GlobalVariable(*TheModule, countersTy, false, GlobalValue::InternalLinkage,
+                                            ConstantAggregateZero::get(countersTy), f->getName() + ".instr");
+
+    Function* init = getProfileInit();
+    IRBuilder<> b(init->getEntryBlock().getTerminator());
+    Type* i8ptr = Type::getInt8PtrTy(TheContext);
+    Type* params[] = { i8ptr, i64->getPointerTo(), LLVM_INTTY() };
+    Function* reg = GetRuntimeFunction("vlang_instrument_register", FunctionType::get(LLVM_VOIDTY(), params, false));
+    int flags = (options.instrument_calls() ? InstrumentCalls : 0) | (options.instrument_time() ? InstrumentTime : 0);
+    Value* args[] = {
+        b.CreateGlobalStringPtr(f->getName(), "instr_name"),
+        b.CreateConstInBoundsGEP2_64(InstrumentCounters, 0, 0),
+        LLVM_INT(flags)
+    };
+    b.CreateCall(reg, args);
+
+    if (options.instrument_calls()) {
+        Value* calls = Builder.CreateConstInBoundsGEP2_64(InstrumentCounters, 0, 0, "instr_calls");
+        createCounterAdd(calls, LLVM_INT_SIZE(64, 1));
+    }
+    if (options.instrument_time()) {
+        InstrumentStart = GetEntryBlockAllocaForType(f, i64, "instr_start");
+        Function* readCycles = Intrinsic::getDeclaration(TheModule.get(), Intrinsic::readcyclecounter);
+        Builder.CreateStore(Builder.CreateCall(readCycles, {}, "cycles"), InstrumentStart);
+    }
+}
+
+void EndFunctionInstrumentation() {
+    if (InstrumentStart != nullptr) {
+        Function* readCycles = Intrinsic::getDeclaration(TheModule.get(), Intrinsic::readcyclecounter);
+        Value* elapsed = Builder.CreateSub(Builder.CreateCall(readCycles, {}, "cycles"),
+                                           Builder.CreateLoad(InstrumentStart), "elapsed");
+        Value* cycles = Builder.CreateConstInBoundsGEP2_64(InstrumentCounters, 0, 1, "instr_cycles");
+        createCounterAdd(cycles, elapsed);
+    }
+    InstrumentCounters = nullptr;
+    InstrumentStart = nullptr;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
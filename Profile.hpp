@@ -0,0 +1,55 @@
+/*
+ * Profile.hpp
+ * Copyright (C) 2016 Nemanja Mićović <nmicovic@outlook.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include "LLVMCodegen.hpp"
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace vlang {
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// Profile guided optimization.
+//
+// Programs compiled with --profile-generate count entries of every function and directions
+// taken by every if and loop condition (the branch sites, numbered in codegen order). Counters
+// of a function live in a zero initialized global { entries, site0 true, site0 false, ... }
+// registered with the runtime (lib/profile.c), which adds them to the profile file at exit.
+//
+// Compiling the same sources with --profile-use reads the file back: functions get their
+// entry counts and branches !prof weights, so LLVM lays out hot paths, inlines hot calls and
+// moves cold code away. Profiles of functions whose number of sites changed are ignored.
+
+/// \brief Starts profiling of given function, called before its body is generated.
+void BeginFunctionProfile(Function* f);
+
+/// \brief Emits the conditional branch of an if or a loop (a branch site of current function).
+BranchInst* CreateProfiledCondBr(Value* cond, BasicBlock* trueBB, BasicBlock* falseBB);
+
+/// \brief Finishes profiling of current function, called once its body is generated.
+void EndFunctionProfile();
+
+// Function instrumentation (--instrument=calls,time).
+//
+// Each function gets a global { calls, cycles } registered with the runtime (lib/instrument.c),
+// the entry increments calls and the exit adds cycles (llvm.readcyclecounter, rdtsc on x86)
+// spent since the entry. Time is inclusive, so callers include their callees and recursive
+// calls are counted more than once. At exit the runtime prints a report of the hottest
+// functions, or writes all of them into VLANG_INSTRUMENT_FILE.
+
+/// \brief Emits the entry part of instrumentation of given function (into its entry block).
+void BeginFunctionInstrumentation(Function* f);
+
+/// \brief Emits the exit part of instrumentation of current function, before it returns.
+void EndFunctionInstrumentation();
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+} // ;vlang
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+#endif /* ifndef PROFILE_HPP */
@@ -11,6 +11,7 @@
 
 #include <sstream>
 #include <iomanip>
+#include <thread>
 
 namespace opt = boost::program_options;
 
@@ -90,6 +91,87 @@ bool ProgramOptions::emit_llvm() const {
     return m_vm["emit-llvm"].as<bool>();
 }
 
+unsigned ProgramOptions::optimization_level() const {
+    unsigned level = m_vm["optimization"].as<unsigned>();
+    return level > 3 ? 3 : level;
+}
+
+bool ProgramOptions::atomic_refcount() const {
+    return m_vm["atomic-rc"].as<bool>();
+}
+
+bool ProgramOptions::system_malloc() const {
+    return m_vm["malloc"].as<bool>();
+}
+
+std::string ProgramOptions::fp_model() const {
+    return m_vm["fp-model"].as<std::string>();
+}
+
+std::string ProgramOptions::target_cpu() const {
+    std::string cpu = m_vm["march"].as<std::string>();
+    return cpu.empty() ? m_vm["mcpu"].as<std::string>() : cpu;
+}
+
+std::string ProgramOptions::profile_generate() const {
+    return m_vm["profile-generate"].as<std::string>();
+}
+
+std::string ProgramOptions::profile_use() const {
+    return m_vm["profile-use"].as<std::string>();
+}
+
+// Items of --instrument are separated by commas
+static bool hasInstrumentItem(const std::string& items, const std::string& item) {
+    std::stringstream ss(items);
+    std::string i;
+    while (std::getline(ss, i, ','))
+        if (i == item) return true;
+    return false;
+}
+
+bool ProgramOptions::instrument_calls() const {
+    return hasInstrumentItem(m_vm["instrument"].as<std::string>(), "calls");
+}
+
+bool ProgramOptions::instrument_time() const {
+    return hasInstrumentItem(m_vm["instrument"].as<std::string>(), "time");
+}
+
+std::vector<std::string> ProgramOptions::exported_functions() const {
+    std::vector<std::string> names;
+    std::stringstream ss(m_vm["export"].as<std::string>());
+    for (std::string name; std::getline(ss, name, ',');)
+        if (! name.empty()) names.push_back(name);
+    return names;
+}
+
+unsigned ProgramOptions::memo_capacity() const {
+    return m_vm["memo-capacity"].as<unsigned>();
+}
+
+unsigned ProgramOptions::const_eval_budget() const {
+    return m_vm["const-eval-budget"].as<unsigned>();
+}
+
+bool ProgramOptions::run() const {
+    return m_vm["run"].as<bool>();
+}
+
+unsigned ProgramOptions::jit_threshold() const {
+    return m_vm["jit-threshold"].as<unsigned>();
+}
+
+unsigned ProgramOptions::jobs() const {
+    unsigned jobs = m_vm["jobs"].as<unsigned>();
+    if (jobs == 0) jobs = std::thread::hardware_concurrency();
+    return jobs == 0 ? 1 : jobs;
+}
+
+bool ProgramOptions::debug_info() const {
+    return m_vm["debug"].as<bool>();
+}
+
 void ProgramOptions::init(int argc, char** argv) {
     if (ProgramOptions::get().is_init) {
         std::cerr << "Warning! Detected multiple init of ProgramOptions!" << std::endl;
@@ -99,12 +181,32 @@ void ProgramOptions::init(int argc, char** argv) {
     opt::options_description desc("All options");
     desc.add_options()
         ("help", "produce help message")
-        //("optimization", opt::value<std::string>()->default_value(""), "optimization level")
+        ("optimization,O", opt::value<unsigned>()->default_value(2), " optimization level (0-3)")
         ("input-file,i", opt::value<std::vector<std::string> >(), "input .vala file")
         ("output,o", opt::value<std::string>()->default_value("a.out"), " executable output path and name")
         ("emit-source,s", opt::value<bool>()->default_value(false), " shows the parsed source code")
         ("color-dump,C", opt::value<bool>()->default_value(false), " if code is shown, this option gives it syntax highlight")
         ("emit-llvm,l", opt::value<bool>()->default_value(true), " shows llvm ir on stdout")
+        ("atomic-rc", opt::value<bool>()->default_value(false), " update reference counts atomically (thread safe)")
+        ("malloc", opt::value<bool>()->default_value(false), " allocate with malloc instead of the vlang allocator (debugging)")
+        ("fp-model", opt::value<std::string>()->default_value("strict"), " floating point model: strict, reassoc or fast")
+        ("march", opt::value<std::string>()->default_value(""), " generate code for given CPU (haswell, znver2...), native for this one")
+        ("mcpu", opt::value<std::string>()->default_value(""), " same as --march")
+        ("profile-generate", opt::value<std::string>()->default_value("")->implicit_value("vlang.profile"),
+            " instrument the program, it writes a profile into given file at exit")
+        ("profile-use", opt::value<std::string>()->default_value("")->implicit_value("vlang.profile"),
+            " optimize using a profile written by a --profile-generate build")
+        ("instrument", opt::value<std::string>()->default_value("")->implicit_value("calls,time"),
+            " count calls and/or time of every function: calls, time or calls,time")
+        ("export", opt::value<std::string>()->default_value(""), " functions kept even if main doesn't call them (name,name...)")
+        ("memo-capacity", opt::value<unsigned>()->default_value(16384),
+            " entries of the cache of every [Memoize] function, 1 to 2^30 (rounded up to a power of two)")
+        ("const-eval-budget", opt::value<unsigned>()->default_value(100000),
+            " calls and loop iterations a pure function call with constant arguments may take to be evaluated at compile time, 0 disables it")
+        ("run,r", opt::bool_switch(), " run the program right away (bytecode interpreter, hot functions are JIT compiled)")
+        ("jit-threshold", opt::value<unsigned>()->default_value(10000), " calls and loop iterations after which --run compiles a function")
+        ("jobs,j", opt::value<unsigned>()->default_value(0), " threads the compiler uses, 0 for one per core")
+        ("debug,g", opt::bool_switch(), " emit DWARF debug info mapping code to .vala lines (debuggers, profilers)")
     ;
 
     // Let's make any given unspecified argument as input file
@@ -128,6 +230,41 @@ void ProgramOptions::init(int argc, char** argv) {
         exit(0);
     }
 
+    std::string fpModel = vm["fp-model"].as<std::string>();
+    if (fpModel != "strict" && fpModel != "reassoc" && fpModel != "fast") {
+        std::cerr << BOLDRED << "error: " << RESET << "unknown --fp-model '" << fpModel
+                  << "' (expected strict, reassoc or fast)" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string march = vm["march"].as<std::string>(), mcpu = vm["mcpu"].as<std::string>();
+    if (! march.empty() && ! mcpu.empty() && march != mcpu) {
+        std::cerr << BOLDRED << "error: " << RESET << "--march=" << march << " conflicts with --mcpu=" << mcpu << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (! vm["profile-generate"].as<std::string>().empty() && ! vm["profile-use"].as<std::string>().empty()) {
+        std::cerr << BOLDRED << "error: " << RESET << "--profile-generate and --profile-use can't be used together" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::stringstream instrument(vm["instrument"].as<std::string>());
+    for (std::string item; std::getline(instrument, item, ',');) {
+        if (item != "calls" && item != "time") {
+            std::cerr << BOLDRED << "error: " << RESET << "unknown --instrument item '" << item
+                      << "' (expected calls or time)" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Rounded up to a power of two, which must fit the i32 capacity of the cache (lib/memo.c)
+    unsigned memoCapacity = vm["memo-capacity"].as<unsigned>();
+    if (memoCapacity < 1 || memoCapacity > (1u << 30)) {
+        std::cerr << BOLDRED << "error: " << RESET << "--memo-capacity=" << memoCapacity
+                  << " is out of range (expected 1 to " << (1u << 30) << ")" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
     ProgramOptions::get().is_init = true;
     ProgramOptions::get().set_input(vm);
 }
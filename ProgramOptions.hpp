@@ -61,6 +61,59 @@ public:
     /// \brief Returns true if compiler should emit llvm code.
     bool emit_llvm() const;
 
+    /// \brief Returns the optimization level (0-3) used for opt and llc.
+    unsigned optimization_level() const;
+
+    /// \brief Returns true if reference counts are updated with atomic instructions.
+    bool atomic_refcount() const;
+
+    /// \brief Returns true if programs allocate with malloc instead of the pooled allocator.
+    bool system_malloc() const;
+
+    /// \brief Returns the floating point model: "strict", "reassoc" or "fast".
+    std::string fp_model() const;
+
+    /// \brief Returns the CPU code is generated for (--march or --mcpu): empty for a generic
+    /// CPU of the target, "native" for the CPU vlang runs on, otherwise an LLVM CPU name.
+    std::string target_cpu() const;
+
+    /// \brief Returns the profile file programs write at exit (--profile-generate), empty if
+    /// programs aren't instrumented.
+    std::string profile_generate() const;
+
+    /// \brief Returns the profile file used to optimize the program (--profile-use), empty if
+    /// there is none.
+    std::string profile_use() const;
+
+    /// \brief Returns true if programs count calls of every function (--instrument=calls).
+    bool instrument_calls() const;
+
+    /// \brief Returns true if programs measure time spent in every function (--instrument=time).
+    bool instrument_time() const;
+
+    /// \brief Returns functions which are compiled even if main doesn't reach them (--export).
+    std::vector<std::string> exported_functions() const;
+
+    /// \brief Returns the number of entries in the cache of a [Memoize] function.
+    unsigned memo_capacity() const;
+
+    /// \brief Returns the number of steps (calls and loop iterations) a call may take to be
+    /// evaluated at compile time, 0 if compile-time evaluation is disabled.
+    unsigned const_eval_budget() const;
+
+    /// \brief Returns true if the program is run right away instead of being compiled (--run).
+    bool run() const;
+
+    /// \brief Returns the hotness (calls and loop iterations) after which a function run by
+    /// the interpreter is compiled into native code.
+    unsigned jit_threshold() const;
+
+    /// \brief Returns the number of threads the compiler uses (-j), one per core by default.
+    unsigned jobs() const;
+
+    /// \brief Returns true if programs carry debug info with lines of .vala sources (-g).
+    bool debug_info() const;
+
     /// \brief Done for testing, to be removed.
     void write_llvm_to_bitcode() const;
 
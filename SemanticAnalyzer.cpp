@@ -8,18 +8,34 @@
 #include "SemanticAnalyzer.hpp"
 #include "color.h"
 #include "ProgramOptions.hpp"
+#include "AstVisitor.hpp"
+#include "Interpreter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <sstream>
+#include <thread>
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 namespace vlang {
 namespace semant {
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
+// Implicit conversions never lose information, except for integer -> double (as in Vala)
 bool SemanticAnalyzer::isAllowedAssignment(VLANG_TYPE variableType, VLANG_TYPE exprType) {
-    if (variableType == VLANG_TYPE::DOUBLE && exprType == VLANG_TYPE::INT32) return true;
+    if (variableType == VLANG_TYPE::DOUBLE && is_integer(exprType)) return true;
+    if (is_integer_widening(exprType, variableType)) return true;
     if (variableType != exprType) return false;
     else return true;
 }
 
+bool SemanticAnalyzer::isAllowedAssignment(VLANG_TYPE variableType, const ExprAST* expr) {
+    if (expr->exp_type() == EXP_TYPE::INT_EXP && static_cast<const ConstIntExprAST*>(expr)->fits_into(variableType))
+        return true;
+    return isAllowedAssignment(variableType, expr->type()->vlang_type());
+}
+
 std::vector<StmtAST*>* SemanticAnalyzer::performAnalysis() {
     std::cerr << BOLDRED << DRAGON_SEPARATOR() << RESET << std::endl;
     std::cerr << BOLDBLUE << "Semantic analysis initiated." << RESET << std::endl;
@@ -34,13 +50,27 @@ std::vector<StmtAST*>* SemanticAnalyzer::performAnalysis() {
     // Cast types into required values
     typeCastRun();
 
-    // --------------- //
-    //  Typechecking   //
-    // --------------- //
-    if (! typeCheckRun(&numberOfErrors))
+    // ------------------------------------------- //
+    //  Types, printf formats and reachability     //
+    // ------------------------------------------- //
+    if (! checkRun(&numberOfErrors))
         std::cerr << BOLDRED << "fatal error: " << RESET << " errors: "
                   << BOLDWHITE << numberOfErrors  << RESET << std::endl;
-    else reportSuccess("Type check was successful.");
+    else reportSuccess("Type and format checks were successful.");
+
+    // ------------------------------ //
+    //  Compile-time evaluation       //
+    // ------------------------------ //
+    unsigned evaluated = constantCallRun();
+    if (evaluated > 0)
+        reportSuccess("Evaluated " + std::to_string(evaluated) + " calls at compile time.");
+
+    // -------------------- //
+    //  Unused functions    //
+    // -------------------- //
+    unsigned removed = reachabilityRun();
+    if (removed > 0)
+        reportSuccess("Skipping " + std::to_string(removed) + " functions unreachable from main.");
 
     // ------------ //
     // UNKNOWN TYPE //
@@ -69,49 +99,288 @@ void SemanticAnalyzer::reportAssignmentError(std::string err) const {
     std::cerr << RED << err << RESET << std::endl;
 }
 
-void SemanticAnalyzer::reportAssignmentError(std::string statement, unsigned long long line, VLANG_TYPE left, VLANG_TYPE right) const {
-    std::cerr << util::ProgramOptions::get().first_input_file() << ":" << line << ":" << BOLDRED << " error:" << RESET;
-    std::cerr << " Assignment: Cannot convert from " << BOLDWHITE << "'" << to_str(right) << "'" << RESET
-              << " to " << BOLDWHITE << "'" << to_str(left) << "'" << std::endl;
-    std::cerr << statement << RESET << std::endl << std::endl;
+unsigned SemanticAnalyzer::runOnFunctions(const FunctionCheck& check) const {
+    std::vector<const FunctionAST*> all = functions();
+    std::vector<std::ostringstream> diagnostics(all.size());
+    std::vector<unsigned> errors(all.size(), 0);
+
+    // Workers take functions one by one, so a few big functions don't leave threads idle
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < all.size(); i = next++)
+            errors[i] = check(all[i], diagnostics[i]);
+    };
+    size_t jobs = std::min<size_t>(util::ProgramOptions::get().jobs(), all.size());
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < jobs; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &t : threads)
+        t.join();
+
+    unsigned numberOfErrors = 0;
+    for (size_t i = 0; i < all.size(); ++i) {
+        std::cerr << diagnostics[i].str();
+        numberOfErrors += errors[i];
+    }
+    return numberOfErrors;
 }
 
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Checks of function bodies, all of them run in a single walk (see checkRun())
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+/// \brief Check reporting diagnostics of one function into its buffer.
+class BodyCheck : public AstVisitor {
+public:
+    BodyCheck(std::ostream& out) : m_out(out), m_errors(0) {}
+
+    unsigned errors() const { return m_errors; }
+
+protected:
+    /// \brief Starts an error message on given line, caller finishes it.
+    std::ostream& error(unsigned long long line) {
+        ++m_errors;
+        return m_out << util::ProgramOptions::get().first_input_file() << ":" << line << ":"
+                     << BOLDRED << " error:" << RESET;
+    }
+
+    std::ostream& m_out;
+    unsigned m_errors;
+};
+
 // TODO: Prettier error reporting (once I conclude everything works well)
-bool SemanticAnalyzer::typeCheckRun(unsigned int* numberOfErrors) {
-    bool allFine = true;
+class TypeCheck : public BodyCheck {
+public:
+    TypeCheck(std::ostream& out) : BodyCheck(out) {}
+
+    virtual void enter(const StmtAST* stmt) {
+        if (stmt->stmt_type() == STMT_TYPE::ASSIGNMENT) {
+            const AssignmentStmtAST* ass = static_cast<const AssignmentStmtAST*>(stmt);
+            if (! ass->isAllowed())
+                report(stmt, ass->assignmentTypes());
+        } else if (stmt->stmt_type() == STMT_TYPE::ASSIGNMENT_LIST) {
+            const AssignmentListStmtAST* ptr = static_cast<const AssignmentListStmtAST*>(stmt);
+            std::unique_ptr<std::vector<bool>> res = ptr->isAllowed();
+            for (unsigned i = 0; i < res->size(); ++i)
+                // i-th assignment in assignment list has an error
+                if (! (*res)[i]) report(stmt, ptr->assignmentTypesIth(i));
+        }
+    }
+
+private:
+    void report(const StmtAST* stmt, std::pair<VLANG_TYPE, VLANG_TYPE> types) {
+        error(stmt->line()) << " Assignment: Cannot convert from " << BOLDWHITE << "'" << to_str(types.second) << "'"
+                            << RESET << " to " << BOLDWHITE << "'" << to_str(types.first) << "'" << std::endl;
+        m_out << stmt->dump() << RESET << std::endl << std::endl;
+    }
+};
+
+class FormatCheck : public BodyCheck {
+public:
+    FormatCheck(std::ostream& out) : BodyCheck(out) {}
+
+    virtual void enter(const StmtAST* stmt) {
+        if (stmt->stmt_type() != STMT_TYPE::EXPRESSION) return;
+        const ExprAST* expr = static_cast<const ExpressionStmtAST*>(stmt)->expr();
+        if (expr->exp_type() != EXP_TYPE::PRINTF_EXP) return;
+        std::string err = static_cast<const PrintfExprAST*>(expr)->checkFormat();
+        if (err.empty()) return;
+        error(stmt->line()) << " Format: " << err << std::endl;
+        m_out << stmt->dump() << RESET << std::endl << std::endl;
+    }
+};
+
+/// \brief Warns about statements following a return in the same block (once per block).
+class ReachabilityCheck : public BodyCheck {
+public:
+    ReachabilityCheck(std::ostream& out) : BodyCheck(out) {}
+
+    virtual void enter(const StmtAST* stmt) {
+        if (! m_blocks.empty() && m_blocks.back() == RETURNED && stmt->stmt_type() != STMT_TYPE::EMPTY) {
+            m_out << util::ProgramOptions::get().first_input_file() << ":" << stmt->line() << ":"
+                  << BOLDYELLOW << " warning:" << RESET << " statement is never executed" << std::endl;
+            m_blocks.back() = REPORTED;
+        }
+        if (stmt->stmt_type() == STMT_TYPE::BLOCK) m_blocks.push_back(REACHABLE);
+    }
+
+    virtual void leave(const StmtAST* stmt) {
+        if (stmt->stmt_type() == STMT_TYPE::BLOCK) m_blocks.pop_back();
+        if (stmt->stmt_type() == STMT_TYPE::RETURN && ! m_blocks.empty() && m_blocks.back() == REACHABLE)
+            m_blocks.back() = RETURNED;
+    }
+
+private:
+    enum BlockState { REACHABLE, RETURNED, REPORTED };
+    // States of blocks enclosing current statement
+    std::vector<BlockState> m_blocks;
+};
+
+/// \brief Checks that iterations of [Parallel] loops neither write the same variables (other
+/// than reductions) nor array elements of each other, and that loops sharing reference counted
+/// values are compiled with --atomic-rc. Aliased arrays and data changed by called functions
+/// are not checked, see AnalyzeParallelLoop().
+class ParallelCheck : public BodyCheck {
+public:
+    ParallelCheck(std::ostream& out) : BodyCheck(out) {}
 
-    // For each program statement, like function definition, declaration...
+    virtual void enter(const StmtAST* stmt) {
+        if (stmt->stmt_type() != STMT_TYPE::FOR || ! static_cast<const ForStmtAST*>(stmt)->has_attribute("Parallel"))
+            return;
+        ParallelLoop loop;
+        std::string err = AnalyzeParallelLoop(static_cast<const ForStmtAST*>(stmt), &loop);
+        if (! err.empty()) {
+            error(stmt->line()) << " Parallel: " << err << std::endl;
+            return;
+        }
+        // Retains and releases of different threads would lose updates of the counts
+        if (loop.sharesManaged && ! util::ProgramOptions::get().atomic_refcount())
+            error(stmt->line()) << " Parallel: iterations of [Parallel] loop share reference counted values,"
+                                << " compile it with --atomic-rc" << std::endl;
+    }
+};
+
+bool SemanticAnalyzer::checkRun(unsigned int* numberOfErrors) {
+    // So far, we only check functions definitions
+    unsigned errors = runOnFunctions([](const FunctionAST* function, std::ostream& out) {
+        TypeCheck typeCheck(out);
+        FormatCheck formatCheck(out);
+        ReachabilityCheck reachabilityCheck(out);
+        ParallelCheck parallelCheck(out);
+        AstWalker walker;
+        walker.add(&typeCheck);
+        walker.add(&formatCheck);
+        walker.add(&reachabilityCheck);
+        walker.add(&parallelCheck);
+        walker.walk(function->body());
+        return typeCheck.errors() + formatCheck.errors() + parallelCheck.errors();
+    });
+    *numberOfErrors += errors;
+    return errors == 0;
+}
+
+/// \brief Collects names of called functions.
+class CallCollector : public AstVisitor {
+public:
+    CallCollector(std::vector<std::string>& callees) : m_callees(callees) {}
+
+    virtual void visit(const ExprAST* expr) {
+        // Calls evaluated at compile time don't need their callee
+        if (expr->exp_type() == EXP_TYPE::CALL_EXP && ConstantCalls.count(expr) == 0)
+            m_callees.push_back(static_cast<const FunctionCallExprAST*>(expr)->name());
+    }
+
+private:
+    std::vector<std::string>& m_callees;
+};
+
+/// \brief Collects call expressions.
+class CallSiteCollector : public AstVisitor {
+public:
+    CallSiteCollector(std::vector<const FunctionCallExprAST*>& calls) : m_calls(calls) {}
+
+    virtual void visit(const ExprAST* expr) {
+        if (expr->exp_type() == EXP_TYPE::CALL_EXP)
+            m_calls.push_back(static_cast<const FunctionCallExprAST*>(expr));
+    }
+
+private:
+    std::vector<const FunctionCallExprAST*>& m_calls;
+};
+
+/// \brief Drops values of evaluated calls inside removed functions.
+class ConstantCallEraser : public AstVisitor {
+public:
+    virtual void visit(const ExprAST* expr) { ConstantCalls.erase(expr); }
+};
+
+unsigned SemanticAnalyzer::constantCallRun() {
+    unsigned budget = util::ProgramOptions::get().const_eval_budget();
+    if (budget == 0) return 0;
+
+    // Functions, global initializers, methods of classes and initializers of their fields
+    std::vector<const FunctionCallExprAST*> calls;
+    CallSiteCollector collector(calls);
+    AstWalker walker;
+    walker.add(&collector);
+    for (auto &stmt : *m_ast) {
+        if (stmt->stmt_type() != STMT_TYPE::CLASS_DEF) {
+            walker.walk(stmt);
+            continue;
+        }
+        const ClassAST* c = static_cast<ClassAST*>(stmt);
+        walker.walk(c->constructor());
+        for (auto &method : c->methods()) walker.walk(method);
+        for (auto &field : c->fields()) walker.walk(field.init);
+    }
+
+    // Operands are visited after their expression, so reversed order evaluates arguments first
+    std::reverse(calls.begin(), calls.end());
+    return EvaluateConstantCalls(m_ast, calls, budget);
+}
+
+unsigned SemanticAnalyzer::reachabilityRun() {
+    std::map<std::string, const FunctionAST*> definitions;
+    for (auto &stmt : *m_ast)
+        if (stmt->stmt_type() == STMT_TYPE::FUNCTION)
+            definitions[static_cast<FunctionAST*>(stmt)->name()] = static_cast<FunctionAST*>(stmt);
+    if (definitions.count("main") == 0) return 0;
+
+    // Methods are generated with their classes and field initializers inside new, so functions
+    // they call are roots as well
+    std::vector<std::string> worklist = util::ProgramOptions::get().exported_functions();
+    worklist.push_back("main");
+    CallCollector collector(worklist);
+    AstWalker walker;
+    walker.add(&collector);
+    for (auto &function : functions())
+        if (definitions.count(function->name()) == 0) walker.walk(function->body());
+    for (auto &stmt : *m_ast)
+        if (stmt->stmt_type() == STMT_TYPE::CLASS_DEF)
+            for (auto &field : static_cast<ClassAST*>(stmt)->fields()) walker.walk(field.init);
+
+    std::set<std::string> reachable;
+    while (! worklist.empty()) {
+        std::string name = worklist.back();
+        worklist.pop_back();
+        if (! reachable.insert(name).second) continue;
+        auto finder = definitions.find(name);
+        if (finder != definitions.end()) walker.walk(finder->second->body());
+    }
+
+    unsigned removed = 0;
+    std::vector<StmtAST*> kept;
+    for (auto &stmt : *m_ast) {
+        bool isFunction = stmt->stmt_type() == STMT_TYPE::FUNCTION;
+        if ((isFunction || stmt->stmt_type() == STMT_TYPE::PROTOTYPE)
+                && reachable.count(static_cast<ProtoDefContainer*>(stmt)->name()) == 0) {
+            if (isFunction) {
+                ConstantCallEraser eraser;
+                AstWalker erasing;
+                erasing.add(&eraser);
+                erasing.walk(stmt);
+                ++removed;
+            }
+            delete stmt;
+        } else kept.push_back(stmt);
+    }
+    m_ast->swap(kept);
+    return removed;
+}
+
+std::vector<const FunctionAST*> SemanticAnalyzer::functions() const {
+    std::vector<const FunctionAST*> res;
     for (auto& programStatement : *m_ast) {
-        // So far, we only check functions definitions
         if (programStatement->stmt_type() == STMT_TYPE::FUNCTION) {
-            // We iterate over each statement inside function body
-            auto functionBody = static_cast<FunctionAST*>(programStatement)->body()->blockStatements();
-            for (auto &stmt : functionBody) {
-                if (stmt->stmt_type() == STMT_TYPE::ASSIGNMENT) {
-                    if (! static_cast<AssignmentStmtAST*>(stmt)->isAllowed()) {
-                        (*numberOfErrors)++;
-                        std::pair<VLANG_TYPE, VLANG_TYPE> t = static_cast<AssignmentStmtAST*>(stmt)->assignmentTypes();
-                        reportAssignmentError(stmt->dump(), stmt->line(), t.first, t.second);
-                        allFine = false;
-                    } else { /* assignment is correct */ }
-                } else if (stmt->stmt_type() == STMT_TYPE::ASSIGNMENT_LIST) {
-                    AssignmentListStmtAST* ptr = static_cast<AssignmentListStmtAST*>(stmt);
-                    std::unique_ptr<std::vector<bool>> res = ptr->isAllowed();
-                    for (unsigned i = 0; i < res->size(); ++i) {
-                        if (! (*res)[i]) {
-                            // i-th assignment in assignment list has an error
-                            std::pair<VLANG_TYPE, VLANG_TYPE> t = ptr->assignmentTypesIth(i);
-                            reportAssignmentError(ptr->dump(), ptr->line(), t.first, t.second);
-                            allFine = false;
-                            (*numberOfErrors)++;
-                        }
-                    }
-                }
-            }
+            res.push_back(static_cast<FunctionAST*>(programStatement));
+        } else if (programStatement->stmt_type() == STMT_TYPE::CLASS_DEF) {
+            const ClassAST* c = static_cast<ClassAST*>(programStatement);
+            if (c->constructor() != nullptr) res.push_back(c->constructor());
+            for (auto &method : c->methods()) res.push_back(method);
         }
     }
-
-    return allFine;
+    return res;
 }
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
@@ -10,6 +10,8 @@
 
 #include <vector>
 #include <map>
+#include <functional>
+#include <ostream>
 #include "Expression.hpp"
 #include "Statement.hpp"
 #include "GlobalContainers.hpp"
@@ -23,6 +25,11 @@ namespace semant {
 /// \brief Performs semantic analysis.
 /// Does NOT deallocate given AST (because obviously it's needed after it finishes working)
 /// It can also change AST (for example, double x = 1 -> double x = 1.0)
+///
+/// Functions are checked independently of each other (prototypes are known once the program
+/// is parsed), so per-function checks run on -j threads. Each function writes its diagnostics
+/// into its own buffer and buffers are printed in source order, output doesn't depend on
+/// scheduling. Checks must only read the AST and global containers.
 class SemanticAnalyzer {
 public:
     SemanticAnalyzer(std::vector<StmtAST*>* ast)
@@ -36,22 +43,47 @@ public:
     /// \brief Checks if an assignment is allowed.
     static bool isAllowedAssignment(VLANG_TYPE variableType, VLANG_TYPE exprType);
 
+    /// \brief Checks if an assignment of given expression is allowed. Integer literals can be
+    /// assigned to any integer type they fit into (int8 x = 100).
+    static bool isAllowedAssignment(VLANG_TYPE variableType, const ExprAST* expr);
+
 private:
+    /// \brief Check of a single function: reports diagnostics into given stream and returns
+    /// the number of errors.
+    typedef std::function<unsigned(const FunctionAST*, std::ostream&)> FunctionCheck;
+
+    /// \brief Runs given check on all functions in parallel, then prints their diagnostics
+    /// in source order. Returns the number of errors.
+    unsigned runOnFunctions(const FunctionCheck& check) const;
+
     /// \brief Functions traverses the AST and does some basic upcasting.
     /// For example: double x = 1; where 1 is an int will get transformed into:
     /// double x = 1.0 where 1.0 is an double.
     void typeCastRun();
 
-    /// \brief Traverses the AST and performs type checking. Reports errors if found.
+    /// \brief Walks every function once with all checks of function bodies (assignment types,
+    /// stdout.printf() formats, unreachable statements, [Parallel] loops). Reports errors if found.
     /// \return Returns true if compilation can proceed further.
-    bool typeCheckRun(unsigned int* numberOfErrrors);
+    bool checkRun(unsigned int* numberOfErrrors);
+
+    /// \brief Evaluates calls of pure functions with constant arguments (square(10)) at compile
+    /// time, codegen replaces them with their values (see EvaluateConstantCalls()).
+    /// \return Returns the number of evaluated calls.
+    unsigned constantCallRun();
+
+    /// \brief Removes functions which main can't call and prototypes of unused external
+    /// functions, so they aren't generated. Calls are followed from main, exported functions
+    /// (--export), methods of classes and initializers of their fields. Programs without main
+    /// are kept whole.
+    /// \return Returns the number of removed functions.
+    unsigned reachabilityRun();
+
+    /// \brief Returns all function definitions of the program, including methods of classes.
+    std::vector<const FunctionAST*> functions() const;
 
     /// \brief Reports an assignment error with given error message.
     void reportAssignmentError(std::string err) const;
 
-    /// \brief Reports an assignment error with given error message and on given line.
-    void reportAssignmentError(std::string statement, unsigned long long line, VLANG_TYPE left, VLANG_TYPE right) const;
-
     /// \brief Reports an sucessful operation with given message.
     void reportSuccess(std::string msg) const;
 
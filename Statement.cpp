@@ -6,11 +6,16 @@
  */
 
 #include "Statement.hpp"
+#include "MemoryManagement.hpp"
+#include "Profile.hpp"
+#include "DebugInfo.hpp"
+#include "AstVisitor.hpp"
 #include "SemanticAnalyzer.hpp"
 #include "color.h"
 #include "ProgramOptions.hpp"
 
 #include <map>
+#include <algorithm>
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 namespace vlang {
@@ -19,6 +24,13 @@ namespace vlang {
 std::map<std::string, PrototypeAST> FunctionProtos;
 std::string indent_style = "    ";
 
+const BlockStmtAST* CurrentFunctionBody = nullptr;
+
+// All returns of current function store their value into the slot and branch to the exit
+// block, which releases managed locals before it returns.
+static BasicBlock* CurrentExitBlock = nullptr;
+static AllocaInst* CurrentReturnSlot = nullptr;
+
 std::string getStrWithIndent(int level = 0) {
     if (level < 0) return "";
     std::string res = "";
@@ -33,13 +45,23 @@ std::string getStrWithIndent(int level = 0) {
 // LLVM CODEGEN
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 Value* ReturnStmtAST::codegen() const {
-    Value* retVal = m_retVal->codegen();
+    // Returned value is owned by the caller
+    Value* retVal = CreateOwnedValue(m_retVal, true);
     if (retVal == nullptr)
         return logError("Failed m_retVal->codegen() in ReturnStmtAST::codegen()");
-    return Builder.CreateRet(retVal);
+    if (CurrentReturnSlot == nullptr) return logError("Returning a value from a void function");
+    Builder.CreateStore(CreateNumericCast(retVal, CurrentReturnSlot->getAllocatedType(),
+                                          is_unsigned(m_retVal->type()->vlang_type())), CurrentReturnSlot);
+    Value* br = Builder.CreateBr(CurrentExitBlock);
+
+    // Code after return is never executed, but it still needs a block
+    Function* TheFunction = Builder.GetInsertBlock()->getParent();
+    Builder.SetInsertPoint(BasicBlock::Create(TheContext, "after_return", TheFunction));
+    return br;
 }
 Value* BlockStmtAST::codegen() const {
     for (auto & cmd : m_cmds) {
+        SetDebugLocation(cmd->line());
         Value* val = cmd->codegen();
         if (val == nullptr) return logError("Failed m_cmds[i]->codegen() in BlockStmtAST::codegen()");
     }
@@ -68,10 +90,13 @@ Value* BlockStmtAST::codegen() const {
 Value* handleAssignment(std::string varName, ExprAST* expr, VLANG_TYPE type) {
     Function* TheFunction = Builder.GetInsertBlock()->getParent();
     AllocaInst* addr = NamedValues[varName];
+    // Variable holding a stack allocated object doesn't own it
+    bool managed = is_managed(type) && ! (expr != nullptr && StackAllocatedObjects.count(expr));
     if (addr == nullptr) {
         // We allocate memory for variable
         std::unique_ptr<VlangType> t(make_from_enum(type));
         addr = GetEntryBlockAllocaForType(TheFunction, t->llvm_type(), varName);
+        if (addr != nullptr && managed) RegisterManagedLocal(addr, type);
 
         // And put it in named values
         NamedValues[varName] = addr;
@@ -82,10 +107,25 @@ Value* handleAssignment(std::string varName, ExprAST* expr, VLANG_TYPE type) {
     if (expr == nullptr) {
         return LLVM_BOOL(true);
     }
-    Value* assignMe = expr->codegen();
+    Value* assignMe = managed ? CreateOwnedValue(expr) : expr->codegen();
     if (assignMe == nullptr) return logError("Failed m_expr->codegen() in AssignmentStmtAST::codegen()");
 
-    Builder.CreateStore(assignMe, addr);
+    if (managed) CreateOwnedStore(assignMe, addr, type);
+    else Builder.CreateStore(CreateNumericCast(assignMe, addr->getAllocatedType(),
+                                               is_unsigned(expr->type()->vlang_type())), addr);
+
+    // Length of an array which is bound only once inside function is known at compile time
+    // if it is initialized with {...} or new T[constant]
+    ArrayStaticLength.erase(varName);
+    if (is_array(type) && CurrentFunctionBody != nullptr && CountVariableWrites(CurrentFunctionBody, varName) == 1) {
+        if (expr->exp_type() == EXP_TYPE::ARRAY_LITERAL_EXP)
+            ArrayStaticLength[varName] = static_cast<ArrayLiteralExprAST*>(expr)->elements().size();
+        else if (expr->exp_type() == EXP_TYPE::ARRAY_NEW_EXP) {
+            const ExprAST* size = static_cast<ArrayNewExprAST*>(expr)->size();
+            if (size->exp_type() == EXP_TYPE::INT_EXP)
+                ArrayStaticLength[varName] = static_cast<const ConstIntExprAST*>(size)->val();
+        }
+    }
     return LLVM_BOOL(true);
 }
 
@@ -103,6 +143,8 @@ Value* AssignmentListStmtAST::codegen() const {
 Value* ExpressionStmtAST::codegen() const {
     Value* val = m_expr->codegen();
     if (val == nullptr) return logError("Failed m_expr->codegen() in ExpressionStmtAST::codegen()");
+    // Result nobody uses is released right away
+    if (IsOwnedValue(m_expr)) CreateRelease(val, m_expr->type()->vlang_type());
     return val;
 }
 Value* EmptyStmtAST::codegen() const {
@@ -113,19 +155,18 @@ Value* EmptyStmtAST::codegen() const {
 Value* handleIf(ExprAST* condExpr, StmtAST* thenStmt) {
     Value* cond = condExpr->codegen();
     if (cond == nullptr) return logError("Failed m_condExpr->codegen() in IfStmtAST::codegen()");
-
-    if (cond->getType() == LLVM_DOUBLETY())
-        cond = Builder.CreateFCmpONE(cond, LLVM_DOUBLE(0.0), "ifcond");
+    cond = CreateCondition(cond, "ifcond");
 
     Function* TheFunction = Builder.GetInsertBlock()->getParent();
 
     BasicBlock* thenBB = BasicBlock::Create(TheContext, "ifthen", TheFunction);
     BasicBlock* mergeBB = BasicBlock::Create(TheContext, "ifmerge");
 
-    Builder.CreateCondBr(cond, thenBB, mergeBB);
+    CreateProfiledCondBr(cond, thenBB, mergeBB);
 
     // Handling then
     Builder.SetInsertPoint(thenBB);
+    SetDebugLocation(thenStmt->line());
     Value* thenVal = thenStmt->codegen();
     if (! thenVal) return logError("Failed m_thenStmt->codegen() in IfStmtAST::codegen()");
     Builder.CreateBr(mergeBB);
@@ -141,6 +182,7 @@ Value* handleIf(ExprAST* condExpr, StmtAST* thenStmt) {
 }
 
 Value* IfStmtAST::codegen() const {
+    SetDebugLocation(line());
     return handleIf(m_condExpr, m_thenStmt);
 }
 
@@ -174,11 +216,10 @@ Value* IfStmtAST::codegen() const {
 //    return LLVM_BOOL(true);
 //}
 Value* IfElseStmtAST::codegen() const {
+    SetDebugLocation(line());
     Value* cond = m_condExpr->codegen();
     if (cond == nullptr) return logError("Failed m_condExpr->codegen() in IfStmtAST::codegen()");
-
-    if (cond->getType() == LLVM_DOUBLETY())
-        cond = Builder.CreateFCmpONE(cond, LLVM_DOUBLE(0.0), "ifcond");
+    cond = CreateCondition(cond, "ifcond");
 
     Function* TheFunction = Builder.GetInsertBlock()->getParent();
 
@@ -186,10 +227,11 @@ Value* IfElseStmtAST::codegen() const {
     BasicBlock* elseBB = BasicBlock::Create(TheContext, "ifelse");
     BasicBlock* mergeBB = BasicBlock::Create(TheContext, "ifmerge");
 
-    Builder.CreateCondBr(cond, thenBB, elseBB);
+    CreateProfiledCondBr(cond, thenBB, elseBB);
 
     // Handling then
     Builder.SetInsertPoint(thenBB);
+    SetDebugLocation(m_thenStmt->line());
     Value* thenVal = m_thenStmt->codegen();
     if (! thenVal) return logError("Failed m_thenStmt->codegen() in IfStmtAST::codegen()");
     Builder.CreateBr(mergeBB);
@@ -198,6 +240,7 @@ Value* IfElseStmtAST::codegen() const {
     // Handling else
     TheFunction->getBasicBlockList().push_back(elseBB);
     Builder.SetInsertPoint(elseBB);
+    SetDebugLocation(m_elseStmt->line());
     Value* elseVal = m_elseStmt->codegen();
     if (! elseVal) return logError("Failed m_thenStmt->codegen() in IfStmtAST::codegen()");
     Builder.CreateBr(mergeBB);
@@ -223,11 +266,11 @@ Value* WhileStmtAST::codegen() const {
     // HANDLE LOOP ENTRY
     // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
     Builder.SetInsertPoint(entryBB);
+    SetDebugLocation(line());
     Value* condVal = m_condExpr->codegen();
     if (! condVal) return logError("Failed m_cond->codegen() in WhileExprAST::codegen()");
-    if (condVal->getType() == LLVM_DOUBLETY())
-        condVal = Builder.CreateFCmpONE(condVal, LLVM_DOUBLE(0.0), "while_cmp");
-    Builder.CreateCondBr(condVal, loopBB, endBB);
+    condVal = CreateCondition(condVal, "while_cmp");
+    CreateProfiledCondBr(condVal, loopBB, endBB);
     entryBB = Builder.GetInsertBlock();
 
     // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
@@ -235,6 +278,7 @@ Value* WhileStmtAST::codegen() const {
     // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
     TheFunction->getBasicBlockList().push_back(loopBB);
     Builder.SetInsertPoint(loopBB);
+    SetDebugLocation(m_bodyStmt->line());
     Value* bodyVal = m_bodyStmt->codegen();
     if (! bodyVal) return logError("Failed m_body->codegen() in WhileExprAST::codegen()");
     Builder.CreateBr(entryBB);
@@ -247,6 +291,950 @@ Value* WhileStmtAST::codegen() const {
 
     return LLVM_BOOL(true);
 }
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Range analysis
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Counts assignments, increments and decrements of given variable (declarations included).
+class WriteCounter : public AstVisitor {
+public:
+    WriteCounter(const std::string& name) : m_name(name), m_writes(0) {}
+
+    virtual void enter(const StmtAST* stmt) {
+        if (stmt->stmt_type() == STMT_TYPE::ASSIGNMENT) {
+            if (static_cast<const AssignmentStmtAST*>(stmt)->var_name() == m_name) ++m_writes;
+        } else if (stmt->stmt_type() == STMT_TYPE::ASSIGNMENT_LIST) {
+            for (auto &ass : static_cast<const AssignmentListStmtAST*>(stmt)->assignments())
+                if (ass.first == m_name) ++m_writes;
+        }
+    }
+
+    virtual void visit(const ExprAST* expr) {
+        if (expr->exp_type() == EXP_TYPE::BINARY_EXP) {
+            const BinaryExprAST* bin = static_cast<const BinaryExprAST*>(expr);
+            if (bin->operation() != "=") return;
+            if (isVariable(bin->left())) ++m_writes;
+            // v[i] = x writes the whole vector variable
+            if (bin->left()->exp_type() == EXP_TYPE::LANE_EXP
+                    && isVariable(static_cast<const LaneExprAST*>(bin->left())->vector()))
+                ++m_writes;
+        } else if (expr->exp_type() == EXP_TYPE::UNARY_EXP) {
+            const UnaryExprAST* un = static_cast<const UnaryExprAST*>(expr);
+            if ((un->operation() == "++" || un->operation() == "--") && isVariable(un->operand()))
+                ++m_writes;
+        }
+    }
+
+    unsigned writes() const { return m_writes; }
+
+private:
+    bool isVariable(const ExprAST* expr) const {
+        return expr->exp_type() == EXP_TYPE::VARIABLE_EXP
+            && static_cast<const VariableExprAST*>(expr)->name() == m_name;
+    }
+
+    const std::string& m_name;
+    unsigned m_writes;
+};
+
+unsigned CountVariableWrites(const StmtAST* stmt, const std::string& name) {
+    AstWalker walker;
+    WriteCounter counter(name);
+    walker.add(&counter);
+    walker.walk(stmt);
+    return counter.writes();
+}
+
+// Finds calls which may run code of the program: functions (except Math.*), methods of classes
+// and constructors. Such code may assign global variables.
+class CallFinder : public AstVisitor {
+public:
+    CallFinder() : m_found(false) {}
+
+    virtual void visit(const ExprAST* expr) {
+        switch (expr->exp_type()) {
+        case EXP_TYPE::CALL_EXP:
+            if (static_cast<const FunctionCallExprAST*>(expr)->name().compare(0, 5, "Math.") != 0) m_found = true;
+            break;
+        case EXP_TYPE::METHOD_EXP:
+            if (is_class(static_cast<const MethodCallExprAST*>(expr)->object()->type()->vlang_type())) m_found = true;
+            break;
+        case EXP_TYPE::NEW_OBJECT_EXP:
+            m_found = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool found() const { return m_found; }
+
+private:
+    bool m_found;
+};
+
+static bool containsCall(const StmtAST* stmt) {
+    AstWalker walker;
+    CallFinder finder;
+    walker.add(&finder);
+    walker.walk(stmt);
+    return finder.found();
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Escape analysis
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool stmtLetsEscape(const StmtAST* stmt, const std::string& name);
+
+// Methods whose 'this' may escape, computed once per method.
+// Methods which are being analyzed are assumed to let 'this' escape (recursion).
+static std::map<const FunctionAST*, bool> ThisEscapes;
+
+static bool thisEscapes(const FunctionAST* method) {
+    if (method == nullptr) return true;
+    auto finder = ThisEscapes.find(method);
+    if (finder != ThisEscapes.end()) return finder->second;
+    ThisEscapes[method] = true;
+    return ThisEscapes[method] = stmtLetsEscape(method->body(), "this");
+}
+
+static bool isVariable(const ExprAST* expr, const std::string& name) {
+    return expr != nullptr && expr->exp_type() == EXP_TYPE::VARIABLE_EXP
+        && static_cast<const VariableExprAST*>(expr)->name() == name;
+}
+
+// Returns true if value of variable with given name (an object) can escape through expr.
+// Only accessing fields of the object and calling its methods (which don't let 'this'
+// escape) is safe, any other use of the value (passing, returning, storing...) escapes.
+bool exprLetsEscape(const ExprAST* expr, const std::string& name) {
+    if (expr == nullptr) return false;
+    switch (expr->exp_type()) {
+    case EXP_TYPE::VARIABLE_EXP:
+        return isVariable(expr, name);
+    case EXP_TYPE::FIELD_EXP: {
+        const ExprAST* object = static_cast<const FieldExprAST*>(expr)->object();
+        return ! isVariable(object, name) && exprLetsEscape(object, name);
+    }
+    case EXP_TYPE::METHOD_EXP: {
+        const MethodCallExprAST* call = static_cast<const MethodCallExprAST*>(expr);
+        for (auto &arg : call->args())
+            if (exprLetsEscape(arg, name)) return true;
+        if (! isVariable(call->object(), name)) return exprLetsEscape(call->object(), name);
+        const ClassAST* c = GetClass(call->object()->type()->vlang_type());
+        return c == nullptr || thisEscapes(c->method(call->method()));
+    }
+    case EXP_TYPE::BINARY_EXP: {
+        const BinaryExprAST* bin = static_cast<const BinaryExprAST*>(expr);
+        // Writing the variable itself (counted by CountVariableWrites) isn't an escape
+        if (bin->operation() == "=" && isVariable(bin->left(), name))
+            return exprLetsEscape(bin->right(), name);
+        return exprLetsEscape(bin->left(), name) || exprLetsEscape(bin->right(), name);
+    }
+    case EXP_TYPE::UNARY_EXP:
+        return exprLetsEscape(static_cast<const UnaryExprAST*>(expr)->operand(), name);
+    case EXP_TYPE::CAST_EXP:
+        return exprLetsEscape(static_cast<const CastExprAST*>(expr)->operand(), name);
+    case EXP_TYPE::VECTOR_EXP:
+        // Arrays are only read by loads, objects can't be lanes
+        return false;
+    case EXP_TYPE::LANE_EXP:
+        return exprLetsEscape(static_cast<const LaneExprAST*>(expr)->index(), name);
+    case EXP_TYPE::INDEX_EXP:
+        return exprLetsEscape(static_cast<const ArrayIndexExprAST*>(expr)->index(), name);
+    case EXP_TYPE::ARRAY_NEW_EXP:
+        return exprLetsEscape(static_cast<const ArrayNewExprAST*>(expr)->size(), name);
+    case EXP_TYPE::ARRAY_LITERAL_EXP:
+        for (auto &e : static_cast<const ArrayLiteralExprAST*>(expr)->elements())
+            if (exprLetsEscape(e, name)) return true;
+        return false;
+    case EXP_TYPE::CALL_EXP:
+        for (auto &arg : static_cast<const FunctionCallExprAST*>(expr)->args())
+            if (exprLetsEscape(arg, name)) return true;
+        return false;
+    case EXP_TYPE::NEW_OBJECT_EXP:
+        for (auto &arg : static_cast<const NewObjectExprAST*>(expr)->args())
+            if (exprLetsEscape(arg, name)) return true;
+        return false;
+    case EXP_TYPE::PRINTF_EXP:
+        for (auto &arg : static_cast<const PrintfExprAST*>(expr)->args())
+            if (exprLetsEscape(arg, name)) return true;
+        return false;
+    default:
+        return false;
+    }
+}
+
+bool stmtLetsEscape(const StmtAST* stmt, const std::string& name) {
+    if (stmt == nullptr) return false;
+    switch (stmt->stmt_type()) {
+    case STMT_TYPE::RETURN:
+        return exprLetsEscape(static_cast<const ReturnStmtAST*>(stmt)->value(), name);
+    case STMT_TYPE::BLOCK:
+        for (auto &s : static_cast<const BlockStmtAST*>(stmt)->blockStatements())
+            if (stmtLetsEscape(s, name)) return true;
+        return false;
+    case STMT_TYPE::ASSIGNMENT:
+        return exprLetsEscape(static_cast<const AssignmentStmtAST*>(stmt)->expr(), name);
+    case STMT_TYPE::ASSIGNMENT_LIST:
+        for (auto &ass : static_cast<const AssignmentListStmtAST*>(stmt)->assignments())
+            if (exprLetsEscape(ass.second, name)) return true;
+        return false;
+    case STMT_TYPE::EXPRESSION:
+        return exprLetsEscape(static_cast<const ExpressionStmtAST*>(stmt)->expr(), name);
+    case STMT_TYPE::IF: {
+        const IfStmtAST* ifStmt = static_cast<const IfStmtAST*>(stmt);
+        return exprLetsEscape(ifStmt->cond(), name) || stmtLetsEscape(ifStmt->then_stmt(), name);
+    }
+    case STMT_TYPE::IF_ELSE: {
+        const IfElseStmtAST* ifStmt = static_cast<const IfElseStmtAST*>(stmt);
+        return exprLetsEscape(ifStmt->cond(), name) || stmtLetsEscape(ifStmt->then_stmt(), name)
+            || stmtLetsEscape(ifStmt->else_stmt(), name);
+    }
+    case STMT_TYPE::WHILE: {
+        const WhileStmtAST* whileStmt = static_cast<const WhileStmtAST*>(stmt);
+        return exprLetsEscape(whileStmt->cond(), name) || stmtLetsEscape(whileStmt->body(), name);
+    }
+    case STMT_TYPE::FOR: {
+        const ForStmtAST* forStmt = static_cast<const ForStmtAST*>(stmt);
+        return stmtLetsEscape(forStmt->init(), name) || exprLetsEscape(forStmt->cond(), name)
+            || exprLetsEscape(forStmt->step(), name) || stmtLetsEscape(forStmt->body(), name);
+    }
+    default:
+        return false;
+    }
+}
+
+// Collects variables initialized by an object allocation: Point p = new Point(...)
+static void collectAllocations(const StmtAST* stmt, std::vector<std::pair<std::string, const ExprAST*>>& res) {
+    if (stmt == nullptr) return;
+    switch (stmt->stmt_type()) {
+    case STMT_TYPE::BLOCK:
+        for (auto &s : static_cast<const BlockStmtAST*>(stmt)->blockStatements())
+            collectAllocations(s, res);
+        break;
+    case STMT_TYPE::ASSIGNMENT: {
+        const AssignmentStmtAST* ass = static_cast<const AssignmentStmtAST*>(stmt);
+        if (ass->expr()->exp_type() == EXP_TYPE::NEW_OBJECT_EXP)
+            res.push_back(std::make_pair(ass->var_name(), ass->expr()));
+        break;
+    }
+    case STMT_TYPE::ASSIGNMENT_LIST:
+        for (auto &ass : static_cast<const AssignmentListStmtAST*>(stmt)->assignments())
+            if (ass.second != nullptr && ass.second->exp_type() == EXP_TYPE::NEW_OBJECT_EXP)
+                res.push_back(std::make_pair(ass.first, ass.second));
+        break;
+    case STMT_TYPE::IF:
+        collectAllocations(static_cast<const IfStmtAST*>(stmt)->then_stmt(), res);
+        break;
+    case STMT_TYPE::IF_ELSE:
+        collectAllocations(static_cast<const IfElseStmtAST*>(stmt)->then_stmt(), res);
+        collectAllocations(static_cast<const IfElseStmtAST*>(stmt)->else_stmt(), res);
+        break;
+    case STMT_TYPE::WHILE:
+        collectAllocations(static_cast<const WhileStmtAST*>(stmt)->body(), res);
+        break;
+    case STMT_TYPE::FOR:
+        collectAllocations(static_cast<const ForStmtAST*>(stmt)->init(), res);
+        collectAllocations(static_cast<const ForStmtAST*>(stmt)->body(), res);
+        break;
+    default:
+        break;
+    }
+}
+
+void FindStackAllocatedObjects(const StmtAST* body) {
+    std::vector<std::pair<std::string, const ExprAST*>> allocations;
+    collectAllocations(body, allocations);
+    for (auto &alloc : allocations) {
+        // Variable written only by the allocation holds the object until the function (or the
+        // loop iteration) ends. If its value doesn't escape, neither does the object.
+        const NewObjectExprAST* newExpr = static_cast<const NewObjectExprAST*>(alloc.second);
+        const ClassAST* c = GetClass(newExpr->type()->vlang_type());
+        if (c->constructor() != nullptr && thisEscapes(c->constructor())) continue;
+        if (CountVariableWrites(body, alloc.first) == 1 && ! stmtLetsEscape(body, alloc.first))
+            StackAllocatedObjects.insert(alloc.second);
+    }
+}
+
+// Recognizes loops of form: for (i = C; i < a.length (or constant); ++i) body
+// where C >= 0 and neither i nor a are written inside body. Unless both are locals, body
+// must not call functions either, they could assign the globals.
+// Returns true and fills the range of i if loop has such form.
+bool findInductionRange(const ForStmtAST* loop, std::string* var, InductionRange* range) {
+    // init: i = C
+    const StmtAST* init = loop->init();
+    const ExprAST* initVal = nullptr;
+    if (init == nullptr) return false;
+    if (init->stmt_type() == STMT_TYPE::ASSIGNMENT) {
+        *var = static_cast<const AssignmentStmtAST*>(init)->var_name();
+        initVal = static_cast<const AssignmentStmtAST*>(init)->expr();
+    } else if (init->stmt_type() == STMT_TYPE::ASSIGNMENT_LIST) {
+        auto &list = static_cast<const AssignmentListStmtAST*>(init)->assignments();
+        if (list.size() != 1) return false;
+        *var = list[0].first;
+        initVal = list[0].second;
+    }
+    if (initVal == nullptr || initVal->exp_type() != EXP_TYPE::INT_EXP) return false;
+    range->lower = static_cast<const ConstIntExprAST*>(initVal)->val();
+
+    // step: ++i or i++
+    const ExprAST* step = loop->step();
+    if (step == nullptr || step->exp_type() != EXP_TYPE::UNARY_EXP) return false;
+    const UnaryExprAST* inc = static_cast<const UnaryExprAST*>(step);
+    if (inc->operation() != "++" || inc->operand()->exp_type() != EXP_TYPE::VARIABLE_EXP
+            || static_cast<const VariableExprAST*>(inc->operand())->name() != *var)
+        return false;
+    // Narrower variables (int8 i...) could wrap around before reaching the bound
+    if (integer_bits(inc->operand()->type()->vlang_type()) < 32) return false;
+
+    // cond: i < a.length or i < N
+    const ExprAST* cond = loop->cond();
+    if (cond == nullptr || cond->exp_type() != EXP_TYPE::BINARY_EXP) return false;
+    const BinaryExprAST* cmp = static_cast<const BinaryExprAST*>(cond);
+    if (cmp->operation() != "<" || cmp->left()->exp_type() != EXP_TYPE::VARIABLE_EXP
+            || static_cast<const VariableExprAST*>(cmp->left())->name() != *var)
+        return false;
+    range->boundConst = -1;
+    if (cmp->right()->exp_type() == EXP_TYPE::LENGTH_EXP) {
+        range->boundArray = static_cast<const ArrayLengthExprAST*>(cmp->right())->name();
+        if (CountVariableWrites(loop->body(), range->boundArray) != 0) return false;
+    } else if (cmp->right()->exp_type() == EXP_TYPE::INT_EXP) {
+        range->boundConst = static_cast<const ConstIntExprAST*>(cmp->right())->val();
+    } else return false;
+
+    // Induction variable has to be changed only by step
+    if (CountVariableWrites(loop->body(), *var) != 0) return false;
+    auto isLocal = [](const std::string& name) {
+        auto finder = NamedValues.find(name);
+        return finder != NamedValues.end() && finder->second != nullptr;
+    };
+    bool locals = isLocal(*var) && (range->boundArray.empty() || isLocal(range->boundArray));
+    return locals || ! containsCall(loop->body());
+}
+
+// For loop is lowered into canonical loop form so LLVM loop passes can pick it up:
+// preheader (init) -> header (cond) -> body -> latch (step, single backedge) -> header
+// Backedge carries llvm.loop metadata which enables vectorization and unrolling.
+Value* ForStmtAST::codegen() const {
+    if (has_attribute("Parallel")) return codegenParallel();
+    Function* TheFunction = Builder.GetInsertBlock()->getParent();
+
+    BasicBlock* preheaderBB = BasicBlock::Create(TheContext, "for_preheader", TheFunction);
+    BasicBlock* headerBB = BasicBlock::Create(TheContext, "for_cond");
+    BasicBlock* bodyBB = BasicBlock::Create(TheContext, "for_body");
+    BasicBlock* latchBB = BasicBlock::Create(TheContext, "for_latch");
+    BasicBlock* endBB = BasicBlock::Create(TheContext, "for_end");
+
+    Builder.CreateBr(preheaderBB);
+
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    // HANDLE LOOP PREHEADER (init)
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    Builder.SetInsertPoint(preheaderBB);
+    SetDebugLocation(line());
+    if (m_initStmt != nullptr && m_initStmt->codegen() == nullptr)
+        return logError("Failed m_initStmt->codegen() in ForStmtAST::codegen()");
+    Builder.CreateBr(headerBB);
+
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    // HANDLE LOOP HEADER (cond)
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    TheFunction->getBasicBlockList().push_back(headerBB);
+    Builder.SetInsertPoint(headerBB);
+    SetDebugLocation(line());
+    Value* condVal = LLVM_BOOL(true);
+    if (m_condExpr != nullptr) {
+        condVal = m_condExpr->codegen();
+        if (! condVal) return logError("Failed m_condExpr->codegen() in ForStmtAST::codegen()");
+        condVal = CreateCondition(condVal, "for_cmp");
+    }
+    CreateProfiledCondBr(condVal, bodyBB, endBB);
+
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    // HANDLE LOOP BODY
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    TheFunction->getBasicBlockList().push_back(bodyBB);
+    Builder.SetInsertPoint(bodyBB);
+
+    // Range of induction variable is known inside body (used for bounds check elimination)
+    std::string inductionVar;
+    InductionRange range;
+    bool hasRange = findInductionRange(this, &inductionVar, &range);
+    std::map<std::string, InductionRange> outerRanges = InductionRanges;
+    if (hasRange) InductionRanges[inductionVar] = range;
+    else InductionRanges.erase(inductionVar);
+
+    SetDebugLocation(m_bodyStmt->line());
+    Value* bodyVal = m_bodyStmt->codegen();
+    InductionRanges = outerRanges;
+    if (! bodyVal) return logError("Failed m_bodyStmt->codegen() in ForStmtAST::codegen()");
+    // Body could have ended with a return
+    if (Builder.GetInsertBlock()->getTerminator() == nullptr)
+        Builder.CreateBr(latchBB);
+
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    // HANDLE LOOP LATCH (step)
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    TheFunction->getBasicBlockList().push_back(latchBB);
+    Builder.SetInsertPoint(latchBB);
+    SetDebugLocation(line());
+    if (m_stepExpr != nullptr && m_stepExpr->codegen() == nullptr)
+        return logError("Failed m_stepExpr->codegen() in ForStmtAST::codegen()");
+    BranchInst* backedge = Builder.CreateBr(headerBB);
+    backedge->setMetadata("llvm.loop", CreateLoopMetadata());
+
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    // HANDLE LOOP END
+    // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+    TheFunction->getBasicBlockList().push_back(endBB);
+    Builder.SetInsertPoint(endBB);
+
+    return LLVM_BOOL(true);
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Parallel loops
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+Value* getVariableAddress(const std::string& name);
+
+// Recognizes the value of a reduction assigned to name: name + e, e + name, name - e, name * e,
+// e * name, Math.fmin(name, e) and Math.fmax(name, e) (arguments in any order).
+static bool reductionOf(const std::string& name, const ExprAST* value, Reduction* op) {
+    if (value->exp_type() == EXP_TYPE::BINARY_EXP) {
+        const BinaryExprAST* bin = static_cast<const BinaryExprAST*>(value);
+        std::string operation = bin->operation();
+        bool either = isVariable(bin->left(), name) || isVariable(bin->right(), name);
+        if ((operation == "+" && either) || (operation == "-" && isVariable(bin->left(), name))) {
+            *op = Reduction::SUM;
+            return true;
+        }
+        if (operation == "*" && either) {
+            *op = Reduction::PRODUCT;
+            return true;
+        }
+    } else if (value->exp_type() == EXP_TYPE::CALL_EXP) {
+        const FunctionCallExprAST* call = static_cast<const FunctionCallExprAST*>(value);
+        if ((call->name() != "Math.fmin" && call->name() != "Math.fmax") || call->args().size() != 2) return false;
+        if (! isVariable(call->args()[0], name) && ! isVariable(call->args()[1], name)) return false;
+        *op = call->name() == "Math.fmin" ? Reduction::MIN : Reduction::MAX;
+        return true;
+    }
+    return false;
+}
+
+// Returns true if a and b are the same expression, so they have the same value as long as no
+// variable changes in between. Calls (which may return something else each time), assignments,
+// increments and expressions which aren't simple values are never the same.
+static bool sameValue(const ExprAST* a, const ExprAST* b) {
+    if (a->exp_type() != b->exp_type()) return false;
+    switch (a->exp_type()) {
+    case EXP_TYPE::INT_EXP:
+        return static_cast<const ConstIntExprAST*>(a)->val() == static_cast<const ConstIntExprAST*>(b)->val()
+            && a->type()->vlang_type() == b->type()->vlang_type();
+    case EXP_TYPE::DOUBLE_EXP:
+        return static_cast<const ConstDoubleExprAST*>(a)->val() == static_cast<const ConstDoubleExprAST*>(b)->val();
+    case EXP_TYPE::VARIABLE_EXP:
+        return static_cast<const VariableExprAST*>(a)->name() == static_cast<const VariableExprAST*>(b)->name();
+    case EXP_TYPE::INDEX_EXP: {
+        const ArrayIndexExprAST* l = static_cast<const ArrayIndexExprAST*>(a);
+        const ArrayIndexExprAST* r = static_cast<const ArrayIndexExprAST*>(b);
+        return l->name() == r->name() && sameValue(l->index(), r->index());
+    }
+    case EXP_TYPE::LENGTH_EXP:
+        return static_cast<const ArrayLengthExprAST*>(a)->name() == static_cast<const ArrayLengthExprAST*>(b)->name();
+    case EXP_TYPE::FIELD_EXP: {
+        const FieldExprAST* l = static_cast<const FieldExprAST*>(a);
+        const FieldExprAST* r = static_cast<const FieldExprAST*>(b);
+        return l->field() == r->field() && sameValue(l->object(), r->object());
+    }
+    case EXP_TYPE::CAST_EXP: {
+        const CastExprAST* l = static_cast<const CastExprAST*>(a);
+        const CastExprAST* r = static_cast<const CastExprAST*>(b);
+        return l->type()->vlang_type() == r->type()->vlang_type() && sameValue(l->operand(), r->operand());
+    }
+    case EXP_TYPE::UNARY_EXP: {
+        const UnaryExprAST* l = static_cast<const UnaryExprAST*>(a);
+        const UnaryExprAST* r = static_cast<const UnaryExprAST*>(b);
+        if (l->operation() == "++" || l->operation() == "--") return false;
+        return l->operation() == r->operation() && sameValue(l->operand(), r->operand());
+    }
+    case EXP_TYPE::BINARY_EXP: {
+        const BinaryExprAST* l = static_cast<const BinaryExprAST*>(a);
+        const BinaryExprAST* r = static_cast<const BinaryExprAST*>(b);
+        if (l->operation() == "=") return false;
+        return l->operation() == r->operation() && sameValue(l->left(), r->left())
+            && sameValue(l->right(), r->right());
+    }
+    default:
+        return false;
+    }
+}
+
+// Recognizes if (e > name) name = e; as a maximum (also e >= name, name < e and name <= e)
+// and the other comparisons as a minimum.
+static bool conditionalReductionOf(const IfStmtAST* stmt, std::string* name, Reduction* op) {
+    if (stmt->then_stmt()->stmt_type() != STMT_TYPE::ASSIGNMENT || stmt->cond()->exp_type() != EXP_TYPE::BINARY_EXP)
+        return false;
+    const AssignmentStmtAST* ass = static_cast<const AssignmentStmtAST*>(stmt->then_stmt());
+    const BinaryExprAST* cmp = static_cast<const BinaryExprAST*>(stmt->cond());
+    std::string operation = cmp->operation();
+    bool less = operation == "<" || operation == "<=";
+    if (! less && operation != ">" && operation != ">=") return false;
+    *name = ass->var_name();
+    if (isVariable(cmp->right(), *name) && sameValue(cmp->left(), ass->expr())) {
+        *op = less ? Reduction::MIN : Reduction::MAX;
+        return true;
+    }
+    if (isVariable(cmp->left(), *name) && sameValue(cmp->right(), ass->expr())) {
+        *op = less ? Reduction::MAX : Reduction::MIN;
+        return true;
+    }
+    return false;
+}
+
+// Collects what the body of a [Parallel] loop does with variables.
+class ParallelBodyScanner : public AstVisitor {
+public:
+    ParallelBodyScanner(const std::string& var) : returns(0), managedLocals(false), m_var(var) {}
+
+    virtual void enter(const StmtAST* stmt) {
+        switch (stmt->stmt_type()) {
+        case STMT_TYPE::RETURN:
+            ++returns;
+            break;
+        case STMT_TYPE::ASSIGNMENT_LIST: {
+            const AssignmentListStmtAST* list = static_cast<const AssignmentListStmtAST*>(stmt);
+            for (auto &ass : list->assignments())
+                declared.insert(ass.first);
+            managedLocals = managedLocals || is_managed(list->type());
+            break;
+        }
+        case STMT_TYPE::ASSIGNMENT: {
+            // Assignment of a conditional reduction was already recognized by its if
+            if (conditional.count(stmt)) break;
+            const AssignmentStmtAST* ass = static_cast<const AssignmentStmtAST*>(stmt);
+            Reduction op;
+            if (reductionOf(ass->var_name(), ass->expr(), &op)) reductions[ass->var_name()].push_back(op);
+            break;
+        }
+        case STMT_TYPE::IF: {
+            const IfStmtAST* ifStmt = static_cast<const IfStmtAST*>(stmt);
+            std::string name;
+            Reduction op;
+            if (conditionalReductionOf(ifStmt, &name, &op)) {
+                reductions[name].push_back(op);
+                conditional.insert(ifStmt->then_stmt());
+            }
+            break;
+        }
+        case STMT_TYPE::EXPRESSION: {
+            // ++name and --name are sums
+            const ExprAST* expr = static_cast<const ExpressionStmtAST*>(stmt)->expr();
+            if (expr->exp_type() != EXP_TYPE::UNARY_EXP) break;
+            const UnaryExprAST* un = static_cast<const UnaryExprAST*>(expr);
+            if ((un->operation() == "++" || un->operation() == "--") && un->operand()->exp_type() == EXP_TYPE::VARIABLE_EXP)
+                reductions[static_cast<const VariableExprAST*>(un->operand())->name()].push_back(Reduction::SUM);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    virtual void visit(const ExprAST* expr) {
+        switch (expr->exp_type()) {
+        case EXP_TYPE::VARIABLE_EXP: {
+            std::string name = static_cast<const VariableExprAST*>(expr)->name();
+            ++uses[name];
+            types[name] = expr->type()->vlang_type();
+            break;
+        }
+        case EXP_TYPE::INDEX_EXP: {
+            const ArrayIndexExprAST* index = static_cast<const ArrayIndexExprAST*>(expr);
+            std::string name = index->name();
+            types.insert(std::make_pair(name, VLANG_TYPE::UNKNOWN));
+            if (is_managed(expr->type()->vlang_type())) managedElements.insert(name);
+            if (! isVariable(index->index(), m_var)) otherElements.insert(name);
+            break;
+        }
+        case EXP_TYPE::BINARY_EXP: {
+            const BinaryExprAST* bin = static_cast<const BinaryExprAST*>(expr);
+            if (bin->operation() == "=" && bin->left()->exp_type() == EXP_TYPE::INDEX_EXP)
+                writtenArrays.insert(static_cast<const ArrayIndexExprAST*>(bin->left())->name());
+            break;
+        }
+        case EXP_TYPE::LENGTH_EXP:
+            types.insert(std::make_pair(static_cast<const ArrayLengthExprAST*>(expr)->name(), VLANG_TYPE::UNKNOWN));
+            break;
+        default:
+            break;
+        }
+    }
+
+    unsigned returns;
+    bool managedLocals;
+    std::set<std::string> declared;
+    std::set<std::string> managedElements;
+    // Arrays whose elements are assigned, arrays accessed by other index than the induction variable
+    std::set<std::string> writtenArrays;
+    std::set<std::string> otherElements;
+    std::map<std::string, unsigned> uses;
+    std::map<std::string, VLANG_TYPE> types;
+    std::map<std::string, std::vector<Reduction>> reductions;
+    std::set<const StmtAST*> conditional;
+
+private:
+    std::string m_var;
+};
+
+std::string AnalyzeParallelLoop(const ForStmtAST* loop, ParallelLoop* res) {
+    const std::string shape = "[Parallel] loop has to have the form 'for (int i = begin; i < end; ++i)'";
+
+    // init: T i = begin
+    const StmtAST* init = loop->init();
+    if (init == nullptr || init->stmt_type() != STMT_TYPE::ASSIGNMENT_LIST) return shape;
+    const AssignmentListStmtAST* decl = static_cast<const AssignmentListStmtAST*>(init);
+    if (decl->assignments().size() != 1 || decl->assignments()[0].second == nullptr || ! is_integer(decl->type()))
+        return shape;
+    res->var = decl->assignments()[0].first;
+    res->varType = decl->type();
+    res->begin = decl->assignments()[0].second;
+
+    // cond: i < end or i <= end
+    const ExprAST* cond = loop->cond();
+    if (cond == nullptr || cond->exp_type() != EXP_TYPE::BINARY_EXP) return shape;
+    const BinaryExprAST* cmp = static_cast<const BinaryExprAST*>(cond);
+    if ((cmp->operation() != "<" && cmp->operation() != "<=") || ! isVariable(cmp->left(), res->var)) return shape;
+    res->end = cmp->right();
+    res->inclusive = cmp->operation() == "<=";
+
+    // step: ++i, i++ or i = i + 1
+    const ExprAST* step = loop->step();
+    bool increment = false;
+    if (step != nullptr && step->exp_type() == EXP_TYPE::UNARY_EXP) {
+        const UnaryExprAST* inc = static_cast<const UnaryExprAST*>(step);
+        increment = inc->operation() == "++" && isVariable(inc->operand(), res->var);
+    } else if (step != nullptr && step->exp_type() == EXP_TYPE::BINARY_EXP) {
+        const BinaryExprAST* ass = static_cast<const BinaryExprAST*>(step);
+        const ExprAST* value = ass->right();
+        if (ass->operation() == "=" && isVariable(ass->left(), res->var) && value->exp_type() == EXP_TYPE::BINARY_EXP) {
+            const BinaryExprAST* add = static_cast<const BinaryExprAST*>(value);
+            increment = add->operation() == "+" && isVariable(add->left(), res->var)
+                && add->right()->exp_type() == EXP_TYPE::INT_EXP
+                && static_cast<const ConstIntExprAST*>(add->right())->val() == 1;
+        }
+    }
+    if (! increment) return shape;
+    if (CountVariableWrites(loop->body(), res->var) != 0)
+        return "induction variable '" + res->var + "' of [Parallel] loop can't be changed by its body";
+
+    AstWalker walker;
+    ParallelBodyScanner scanner(res->var);
+    walker.add(&scanner);
+    walker.walk(loop->body());
+    if (scanner.returns != 0) return "[Parallel] loop can't return from its body";
+
+    // An iteration may access only its own element of arrays the loop writes (arrays declared
+    // by the body are its own). Aliases of arrays and writes made by called functions aren't
+    // seen here, keeping them apart is up to the programmer.
+    for (auto &name : scanner.writtenArrays)
+        if (! scanner.declared.count(name) && scanner.otherElements.count(name))
+            return "elements of '" + name + "' are written by iterations of [Parallel] loop, they can only be"
+                " accessed as " + name + "[" + res->var + "]";
+
+    // Iterations share outer variables, those they write have to be reductions: every write
+    // is a reduction with the same operation and the variable isn't read anywhere else
+    res->outer.clear();
+    res->reductions.clear();
+    res->sharesManaged = false;
+    bool outerManaged = false;
+    for (auto &used : scanner.types) {
+        const std::string& name = used.first;
+        if (name == res->var || scanner.declared.count(name)) continue;
+        res->outer[name] = used.second;
+        if (is_class(used.second) || used.second == VLANG_TYPE::STRING || scanner.managedElements.count(name))
+            res->sharesManaged = true;
+        if (used.second == VLANG_TYPE::UNKNOWN || is_managed(used.second)) outerManaged = true;
+
+        unsigned writes = CountVariableWrites(loop->body(), name);
+        if (writes == 0) continue;
+        const std::vector<Reduction>& ops = scanner.reductions[name];
+        if (ops.size() != writes || scanner.uses[name] != writes
+                || std::count(ops.begin(), ops.end(), ops[0]) != static_cast<long>(ops.size()))
+            return "'" + name + "' is written by iterations of [Parallel] loop, only reductions (" + name + " = "
+                + name + " + e, " + name + " * e, min and max) can be";
+        if (! is_integer(used.second) && used.second != VLANG_TYPE::DOUBLE)
+            return "reduction '" + name + "' of [Parallel] loop has to be a number";
+        res->reductions[name] = ops[0];
+    }
+    // Managed locals of iterations can take references to shared values
+    if (scanner.managedLocals && outerManaged) res->sharesManaged = true;
+
+    // Bounds are evaluated once, before any iteration
+    ParallelBodyScanner bounds(res->var);
+    AstWalker boundsWalker;
+    boundsWalker.add(&bounds);
+    boundsWalker.walk(res->begin);
+    boundsWalker.walk(res->end);
+    for (auto &used : bounds.types)
+        if (res->reductions.count(used.first))
+            return "bounds of [Parallel] loop can't use its reduction '" + used.first + "'";
+    return "";
+}
+
+// Body of a [Parallel] loop, outlined once the function containing the loop is generated.
+// Shared variables are passed to it by value in an environment struct, reductions by address.
+struct OutlinedLoop {
+    const ForStmtAST* loop;
+    ParallelLoop info;
+    Function* function;
+    StructType* env;
+    std::vector<std::string> captured;
+};
+static std::vector<OutlinedLoop> OutlinedLoops;
+// Outlined bodies (generated or not) of the function being generated
+static std::vector<Function*> ParallelLoopBodies;
+
+Value* ForStmtAST::codegenParallel() const {
+    OutlinedLoop outlined;
+    outlined.loop = this;
+    std::string err = AnalyzeParallelLoop(this, &outlined.info);
+    if (! err.empty()) return logError(err);
+    const ParallelLoop& info = outlined.info;
+    Function* TheFunction = Builder.GetInsertBlock()->getParent();
+    SetDebugLocation(line());
+
+    // Iterations [begin, end) in 64 bits, bounds are converted as if they were assigned to i
+    Type* i64 = Type::getInt64Ty(TheContext);
+    std::unique_ptr<VlangType> varType(make_from_enum(info.varType));
+    Value* begin = info.begin->codegen();
+    Value* end = info.end->codegen();
+    if (begin == nullptr || end == nullptr) return logError("Failed bounds codegen in ForStmtAST::codegenParallel()");
+    bool isUnsigned = is_unsigned(info.varType);
+    begin = CreateNumericCast(CreateNumericCast(begin, varType->llvm_type(), is_unsigned(info.begin->type()->vlang_type())),
+                              i64, isUnsigned);
+    end = CreateNumericCast(end, i64, is_unsigned(info.end->type()->vlang_type()));
+    if (info.inclusive) end = Builder.CreateAdd(end, LLVM_INT_SIZE(64, 1), "end");
+
+    // Environment: values of shared locals and addresses of reductions (globals are used directly)
+    std::vector<Type*> fields;
+    std::vector<Value*> values;
+    for (auto &var : info.outer) {
+        const std::string& name = var.first;
+        if (info.reductions.count(name)) {
+            Value* addr = getVariableAddress(name);
+            if (addr == nullptr) return logError("Unknown variable: '" + name + "'");
+            fields.push_back(addr->getType());
+            values.push_back(addr);
+        } else {
+            auto finder = NamedValues.find(name);
+            if (finder == NamedValues.end() || finder->second == nullptr) continue;
+            fields.push_back(finder->second->getAllocatedType());
+            values.push_back(Builder.CreateLoad(finder->second, name));
+        }
+        outlined.captured.push_back(name);
+    }
+    outlined.env = StructType::get(TheContext, fields);
+    Type* i8ptr = Type::getInt8PtrTy(TheContext);
+    Value* env = ConstantPointerNull::get(static_cast<PointerType*>(i8ptr));
+    if (! fields.empty()) {
+        AllocaInst* envAddr = GetEntryBlockAllocaForType(TheFunction, outlined.env, "parallel_env");
+        for (unsigned i = 0; i < values.size(); ++i)
+            Builder.CreateStore(values[i], Builder.CreateStructGEP(outlined.env, envAddr, i));
+        env = Builder.CreateBitCast(envAddr, i8ptr, "env");
+    }
+
+    // void name.parallel(i8* env, i64 begin, i64 end), its body is generated after this function
+    FunctionType* bodyType = FunctionType::get(LLVM_VOIDTY(), { i8ptr, i64, i64 }, false);
+    outlined.function = Function::Create(bodyType, Function::InternalLinkage, TheFunction->getName() + ".parallel",
+                                         TheModule.get());
+    Type* params[] = { i64, i64, bodyType->getPointerTo(), i8ptr };
+    Function* parallelFor = GetRuntimeFunction("vlang_parallel_for", FunctionType::get(LLVM_VOIDTY(), params, false));
+    Value* args[] = { begin, end, outlined.function, env };
+    Builder.CreateCall(parallelFor, args);
+    OutlinedLoops.push_back(outlined);
+    ParallelLoopBodies.push_back(outlined.function);
+    return LLVM_BOOL(true);
+}
+
+// Value a private partial result of a reduction starts with.
+static Value* createReductionIdentity(Reduction op, VLANG_TYPE type, Type* llvmType) {
+    bool isDouble = type == VLANG_TYPE::DOUBLE;
+    unsigned bits = isDouble ? 64 : integer_bits(type);
+    switch (op) {
+    case Reduction::SUM:
+        return Constant::getNullValue(llvmType);
+    case Reduction::PRODUCT:
+        return isDouble ? ConstantFP::get(llvmType, 1.0) : ConstantInt::get(llvmType, 1);
+    case Reduction::MIN:
+        if (isDouble) return ConstantFP::getInfinity(llvmType, false);
+        return ConstantInt::get(TheContext, is_unsigned(type) ? APInt::getMaxValue(bits) : APInt::getSignedMaxValue(bits));
+    case Reduction::MAX:
+        if (isDouble) return ConstantFP::getInfinity(llvmType, true);
+        return ConstantInt::get(TheContext, is_unsigned(type) ? APInt::getMinValue(bits) : APInt::getSignedMinValue(bits));
+    }
+    return nullptr;
+}
+
+// Combines a partial result of a reduction with the shared value.
+static Value* createReductionCombine(Reduction op, VLANG_TYPE type, Value* shared, Value* partial) {
+    bool isDouble = type == VLANG_TYPE::DOUBLE;
+    switch (op) {
+    case Reduction::SUM:
+        return isDouble ? Builder.CreateFAdd(shared, partial, "sum") : Builder.CreateAdd(shared, partial, "sum");
+    case Reduction::PRODUCT:
+        return isDouble ? Builder.CreateFMul(shared, partial, "product") : Builder.CreateMul(shared, partial, "product");
+    case Reduction::MIN: {
+        Value* less = isDouble ? Builder.CreateFCmpOLT(partial, shared)
+                    : is_unsigned(type) ? Builder.CreateICmpULT(partial, shared) : Builder.CreateICmpSLT(partial, shared);
+        return Builder.CreateSelect(less, partial, shared, "min");
+    }
+    case Reduction::MAX: {
+        Value* greater = isDouble ? Builder.CreateFCmpOGT(partial, shared)
+                       : is_unsigned(type) ? Builder.CreateICmpUGT(partial, shared) : Builder.CreateICmpSGT(partial, shared);
+        return Builder.CreateSelect(greater, partial, shared, "max");
+    }
+    }
+    return nullptr;
+}
+
+// Generates the function running iterations [begin, end) of an outlined loop. Reductions work
+// on private partial results, which are added to the shared variables once the chunk is done.
+static bool createParallelLoopBody(const OutlinedLoop& outlined) {
+    const ParallelLoop& info = outlined.info;
+    Function* f = outlined.function;
+    auto arg = f->arg_begin();
+    Value* env = &*arg++;
+    Value* begin = &*arg++;
+    Value* end = &*arg;
+    env->setName("env");
+    begin->setName("begin");
+    end->setName("end");
+
+    Builder.SetInsertPoint(BasicBlock::Create(TheContext, "entry", f));
+    BeginFunctionDebugInfo(f, outlined.loop->line());
+    BeginFunctionProfile(f);
+    NamedValues.clear();
+    ArrayStaticLength.clear();
+    InductionRanges.clear();
+    StackAllocatedObjects.clear();
+    ResetFunctionCleanup();
+    FindStackAllocatedObjects(outlined.loop->body());
+    CurrentFunctionBody = nullptr;
+    CurrentExitBlock = BasicBlock::Create(TheContext, "exit");
+    CurrentReturnSlot = nullptr;
+
+    // Shared values are borrowed from the function running the loop, it keeps them alive
+    struct Partial { AllocaInst* addr; Value* shared; Reduction op; VLANG_TYPE type; };
+    std::vector<Partial> partials;
+    Value* fields = Builder.CreateBitCast(env, outlined.env->getPointerTo(), "fields");
+    for (unsigned i = 0; i < outlined.captured.size(); ++i) {
+        const std::string& name = outlined.captured[i];
+        Value* val = Builder.CreateLoad(Builder.CreateStructGEP(outlined.env, fields, i), name);
+        auto reduction = info.reductions.find(name);
+        if (reduction == info.reductions.end()) {
+            AllocaInst* addr = GetEntryBlockAllocaForType(f, val->getType(), name);
+            Builder.CreateStore(val, addr);
+            NamedValues[name] = addr;
+            continue;
+        }
+        VLANG_TYPE type = info.outer.at(name);
+        std::unique_ptr<VlangType> t(make_from_enum(type));
+        AllocaInst* addr = GetEntryBlockAllocaForType(f, t->llvm_type(), name);
+        Builder.CreateStore(createReductionIdentity(reduction->second, type, t->llvm_type()), addr);
+        NamedValues[name] = addr;
+        partials.push_back({ addr, val, reduction->second, type });
+    }
+
+    // for (i = begin; i < end; ++i) body, in canonical form as ForStmtAST::codegen()
+    Type* i64 = Type::getInt64Ty(TheContext);
+    bool isUnsigned = is_unsigned(info.varType);
+    std::unique_ptr<VlangType> varType(make_from_enum(info.varType));
+    AllocaInst* var = GetEntryBlockAllocaForType(f, varType->llvm_type(), info.var);
+    NamedValues[info.var] = var;
+    Builder.CreateStore(CreateNumericCast(begin, varType->llvm_type(), isUnsigned), var);
+
+    BasicBlock* headerBB = BasicBlock::Create(TheContext, "for_cond", f);
+    BasicBlock* bodyBB = BasicBlock::Create(TheContext, "for_body");
+    BasicBlock* latchBB = BasicBlock::Create(TheContext, "for_latch");
+    BasicBlock* endBB = BasicBlock::Create(TheContext, "for_end");
+    Builder.CreateBr(headerBB);
+
+    Builder.SetInsertPoint(headerBB);
+    Value* index = CreateNumericCast(Builder.CreateLoad(var, info.var), i64, isUnsigned);
+    Value* cond = isUnsigned ? Builder.CreateICmpULT(index, end, "for_cmp") : Builder.CreateICmpSLT(index, end, "for_cmp");
+    CreateProfiledCondBr(cond, bodyBB, endBB);
+
+    f->getBasicBlockList().push_back(bodyBB);
+    Builder.SetInsertPoint(bodyBB);
+    // Chunks are parts of the whole iteration space, so its range holds for them too
+    std::string inductionVar;
+    InductionRange range;
+    if (findInductionRange(outlined.loop, &inductionVar, &range)) InductionRanges[inductionVar] = range;
+    SetDebugLocation(outlined.loop->body()->line());
+    if (outlined.loop->body()->codegen() == nullptr) {
+        f->deleteBody();
+        return false;
+    }
+    if (Builder.GetInsertBlock()->getTerminator() == nullptr)
+        Builder.CreateBr(latchBB);
+
+    f->getBasicBlockList().push_back(latchBB);
+    Builder.SetInsertPoint(latchBB);
+    SetDebugLocation(outlined.loop->line());
+    Value* next = Builder.CreateAdd(Builder.CreateLoad(var, info.var), ConstantInt::get(varType->llvm_type(), 1), "next");
+    Builder.CreateStore(next, var);
+    BranchInst* backedge = Builder.CreateBr(headerBB);
+    backedge->setMetadata("llvm.loop", CreateLoopMetadata());
+
+    f->getBasicBlockList().push_back(endBB);
+    Builder.SetInsertPoint(endBB);
+    if (! partials.empty()) {
+        FunctionType* lockType = FunctionType::get(LLVM_VOIDTY(), false);
+        Builder.CreateCall(GetRuntimeFunction("vlang_parallel_lock", lockType));
+        for (auto &partial : partials) {
+            Value* shared = Builder.CreateLoad(partial.shared, "shared");
+            Value* val = Builder.CreateLoad(partial.addr, "partial");
+            Builder.CreateStore(createReductionCombine(partial.op, partial.type, shared, val), partial.shared);
+        }
+        Builder.CreateCall(GetRuntimeFunction("vlang_parallel_unlock", lockType));
+    }
+    Builder.CreateBr(CurrentExitBlock);
+
+    f->getBasicBlockList().push_back(CurrentExitBlock);
+    Builder.SetInsertPoint(CurrentExitBlock);
+    CreateFunctionCleanup();
+    Builder.CreateRetVoid();
+    EndFunctionProfile();
+    EndFunctionDebugInfo();
+
+    verifyFunction(*f);
+    TheFPM->run(*f);
+    OptimizeRefCounts(f);
+    return true;
+}
+
+// Generates bodies of [Parallel] loops of the function which was just generated (and of loops
+// nested in them). Returns false if any of them failed, the caller then discards them all.
+static bool createParallelLoopBodies() {
+    while (! OutlinedLoops.empty()) {
+        OutlinedLoop outlined = OutlinedLoops.front();
+        OutlinedLoops.erase(OutlinedLoops.begin());
+        if (! createParallelLoopBody(outlined)) return false;
+    }
+    ParallelLoopBodies.clear();
+    return true;
+}
+
+// Erases outlined bodies of a function which failed, once the function itself is erased.
+// Bodies of nested loops are called from other bodies, so references are dropped first.
+static void discardParallelLoopBodies() {
+    OutlinedLoops.clear();
+    for (Function* f : ParallelLoopBodies) f->dropAllReferences();
+    for (Function* f : ParallelLoopBodies) f->eraseFromParent();
+    ParallelLoopBodies.clear();
+}
+
 Value* PrototypeAST::codegen() const {
     std::vector<Type*> protoParameters;
     for (auto & param : m_args) {
@@ -282,40 +1270,153 @@ Value* FunctionAST::codegen() const {
     // We give our function a basic block
     BasicBlock* bodyBB = BasicBlock::Create(TheContext, "entry", theFunction);
     Builder.SetInsertPoint(bodyBB);
+    BeginFunctionDebugInfo(theFunction, m_proto.line());
+    BeginFunctionProfile(theFunction);
+    BeginFunctionInstrumentation(theFunction);
 
     // We add arguments as local variables
     NamedValues.clear();
+    ArrayStaticLength.clear();
+    InductionRanges.clear();
+    StackAllocatedObjects.clear();
+    ResetFunctionCleanup();
+    FindStackAllocatedObjects(m_definition);
+    CurrentFunctionBody = m_definition;
+    CurrentExitBlock = BasicBlock::Create(TheContext, "exit");
+    CurrentReturnSlot = nullptr;
+    if (m_proto.ret_val_type() != VLANG_TYPE::VOID)
+        CurrentReturnSlot = GetEntryBlockAllocaForType(theFunction, theFunction->getReturnType(), "retval");
+    unsigned i = 0;
     for (auto & arg : theFunction->args()) {
         // TODO: Make different allocas for different types!
         AllocaInst* argAddr = GetEntryBlockAllocaForType(theFunction, arg.getType(), arg.getName());
         NamedValues[arg.getName()] = argAddr;
         Builder.CreateStore(&arg, argAddr);
+
+        // Arguments are borrowed from the caller, only those which get overwritten need
+        // their own reference
+        VLANG_TYPE argType = m_proto.args()[i++].first;
+        if (is_managed(argType) && CountVariableWrites(m_definition, arg.getName()) > 0) {
+            RegisterManagedLocal(argAddr, argType);
+            CreateRetain(&arg, argType);
+        }
     }
 
     // Now we can generate function body
     Value* fBody = m_definition->codegen();
     if (fBody == nullptr) {
         theFunction->eraseFromParent();
+        discardParallelLoopBodies();
         return logError("Failed m_definition->codegen() in FunctionAST::codegen()");
-    } else {
-        // TODO:
-        if (m_proto.ret_val_type() == VLANG_TYPE::VOID) {
-            return Builder.CreateRetVoid();
-        } else {
-            //Builder.CreateRet(fBody);
-            verifyFunction(*theFunction);
-            TheFPM->run(*theFunction);
-            return theFunction;
-        }
+    }
+
+    // Falling off the end returns from void functions, others must have returned already
+    if (Builder.GetInsertBlock()->getTerminator() == nullptr) {
+        if (CurrentReturnSlot == nullptr) Builder.CreateBr(CurrentExitBlock);
+        else Builder.CreateUnreachable();
+    }
+    theFunction->getBasicBlockList().push_back(CurrentExitBlock);
+    Builder.SetInsertPoint(CurrentExitBlock);
+    CreateFunctionCleanup();
+    EndFunctionInstrumentation();
+    if (CurrentReturnSlot == nullptr) Builder.CreateRetVoid();
+    else Builder.CreateRet(Builder.CreateLoad(CurrentReturnSlot, "retval"));
+    EndFunctionProfile();
+    EndFunctionDebugInfo();
+
+    verifyFunction(*theFunction);
+    TheFPM->run(*theFunction);
+    OptimizeRefCounts(theFunction);
+    // Before cloning, so clones don't call bodies which may still be discarded
+    if (! createParallelLoopBodies()) {
+        theFunction->eraseFromParent();
+        discardParallelLoopBodies();
+        return logError("Failed generating [Parallel] loops of '" + m_proto.name() + "'");
+    }
+    if (has_attribute("Multiversion"))
+        CreateMultiversion(theFunction);
+    if (has_attribute("Memoize"))
+        CreateMemoize(theFunction);
+    return theFunction;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Classes
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Alignment (in bytes) of a field of given type.
+static unsigned fieldAlignment(VLANG_TYPE type) {
+    if (is_integer(type)) return integer_bits(type) / 8;
+    switch (type) {
+        case VLANG_TYPE::BOOL:  return 1;
+        default:                return 8;       // double, strings, arrays and objects
     }
 }
 
+const FieldDecl* ClassAST::field(const std::string& name) const {
+    for (auto &f : m_fields)
+        if (f.name == name) return &f;
+    return nullptr;
+}
+
+const FunctionAST* ClassAST::method(const std::string& name) const {
+    for (auto &m : m_methods)
+        if (m->name() == method_name(name)) return m;
+    return nullptr;
+}
+
+std::vector<const FieldDecl*> ClassAST::layout() const {
+    std::vector<const FieldDecl*> res;
+    for (auto &f : m_fields) res.push_back(&f);
+    std::stable_sort(res.begin(), res.end(), [](const FieldDecl* a, const FieldDecl* b) {
+        return fieldAlignment(a->type) > fieldAlignment(b->type);
+    });
+    return res;
+}
+
+unsigned ClassAST::field_index(const std::string& name) const {
+    std::vector<const FieldDecl*> fields = layout();
+    for (unsigned i = 0; i < fields.size(); ++i)
+        if (fields[i]->name == name) return i + 1;      // header is the first element
+    return 0;
+}
+
+StructType* ClassAST::llvm_type() const {
+    std::string typeName = "class." + m_name;
+    StructType* structTy = TheModule->getTypeByName(typeName);
+    if (structTy != nullptr) return structTy;
+
+    // Struct is named before its body is made, so fields can point to objects of the same class
+    structTy = StructType::create(TheContext, typeName);
+    std::vector<Type*> body = { Type::getInt64Ty(TheContext) };        // header
+    for (auto &f : layout()) {
+        std::unique_ptr<VlangType> fieldType(make_from_enum(f->type));
+        body.push_back(fieldType->llvm_type());
+    }
+    structTy->setBody(body);
+    return structTy;
+}
+
+Value* ClassAST::codegen() const {
+    llvm_type();
+
+    // Methods can call each other, so all of them are declared first
+    std::vector<const FunctionAST*> functions(m_methods.begin(), m_methods.end());
+    if (m_constructor != nullptr) functions.push_back(m_constructor);
+    for (auto &f : functions)
+        if (GetFunction(f->name()) == nullptr && f->proto().codegen() == nullptr)
+            return logError("Failed declaring method '" + f->name() + "'");
+    for (auto &f : functions)
+        if (f->codegen() == nullptr)
+            return logError("Failed generating method '" + f->name() + "'");
+    CreateDestroyFunction(this);
+    return LLVM_BOOL(true);
+}
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // Checking if assignment is valid
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 bool AssignmentStmtAST::isAllowed() const {
-    return semant::SemanticAnalyzer::isAllowedAssignment(m_type, m_expr->type()->vlang_type());
+    return semant::SemanticAnalyzer::isAllowedAssignment(m_type, m_expr);
 }
 
 std::unique_ptr<std::vector<bool>> AssignmentListStmtAST::isAllowed() const {
@@ -325,7 +1426,7 @@ std::unique_ptr<std::vector<bool>> AssignmentListStmtAST::isAllowed() const {
         if (ass.second != nullptr) {
             const VlangType* exprType = ass.second->type();
             if (exprType == nullptr) result->push_back(false);
-            else if (semant::SemanticAnalyzer::isAllowedAssignment(m_type, exprType->vlang_type()))
+            else if (semant::SemanticAnalyzer::isAllowedAssignment(m_type, ass.second))
                 result->push_back(true);
             else
                 result->push_back(false);
@@ -373,12 +1474,39 @@ std::string PrototypeAST::dump(int level) const {
 }
 
 std::string FunctionAST::dump(int level) const {
-    std::string res = m_proto.dump(level);
+    std::string res;
+    for (auto &attribute : m_attributes)
+        res += getStrWithIndent(level) + "[" + attribute + "]\n";
+    res += m_proto.dump(level);
     res.erase(res.size()-1, res.size());        // remove ';' from the end of proto
     res += " " + m_definition->dump(level+1);
     return res;
 }
 
+std::string ClassAST::dump(int level) const {
+    std::string res = getStrWithIndent(level);
+    if (util::ProgramOptions::get().syntax_highlight())
+        res += std::string(KEYWORD_C) + "class " + std::string(RESET);
+    else res += "class ";
+    res += m_name + " {\n";
+    for (auto &f : m_fields) {
+        res += getStrWithIndent(level+1) + to_str(f.type) + " " + f.name;
+        if (f.property) {
+            res += " { get; set;";
+            if (f.init != nullptr) res += " default = " + f.init->dump() + ";";
+            res += " }";
+        } else {
+            if (f.init != nullptr) res += " = " + f.init->dump();
+            res += ";";
+        }
+        res += "\n";
+    }
+    if (m_constructor != nullptr) res += m_constructor->dump(level+1) + "\n";
+    for (auto &m : m_methods) res += m->dump(level+1) + "\n";
+    res += getStrWithIndent(level) + "}";
+    return res;
+}
+
 // TODO: Multiple nested blocks are shown badly (because of indenting
 // as I wanted to avoid newline with '{' symbol.
 std::string BlockStmtAST::dump(int level) const {
@@ -458,6 +1586,27 @@ std::string WhileStmtAST::dump(int level) const {
     return res;
 }
 
+std::string ForStmtAST::dump(int level) const {
+    std::string res;
+    for (auto &attribute : m_attributes)
+        res += getStrWithIndent(level) + "[" + attribute + "]\n";
+    res += getStrWithIndent(level);
+    if (util::ProgramOptions::get().syntax_highlight())
+        res += std::string(KEYWORD_C) + "for " + std::string(RESET);
+    else
+        res += "for ";
+    res += "(";
+    res += (m_initStmt != nullptr && m_initStmt->stmt_type() != STMT_TYPE::EMPTY) ? m_initStmt->dump() : ";";
+    res += (m_condExpr != nullptr) ? " " + m_condExpr->dump() + ";" : ";";
+    res += (m_stepExpr != nullptr) ? " " + m_stepExpr->dump() : "";
+    res += ")";
+    if (m_bodyStmt->stmt_type() == STMT_TYPE::BLOCK)
+        res += " " + m_bodyStmt->dump(level+1);
+    else
+        res += "\n" + getStrWithIndent(level+1) + m_bodyStmt->dump();
+    return res;
+}
+
 std::string AssignmentStmtAST::dump(int level) const {
     std::string res = getStrWithIndent(level);
     std::string eq = (util::ProgramOptions::get().syntax_highlight() ?
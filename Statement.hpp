@@ -15,6 +15,7 @@
 
 #include <string>
 #include <vector>
+#include <set>
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 namespace vlang {
@@ -25,7 +26,7 @@ namespace vlang {
 /// -----------------------------------------------------------------------------------------------
 typedef enum {
     RETURN, BLOCK, IF, IF_ELSE, WHILE, FOR, ASSIGNMENT,
-    ASSIGNMENT_LIST, PROTOTYPE, FUNCTION, EXPRESSION, EMPTY
+    ASSIGNMENT_LIST, PROTOTYPE, FUNCTION, EXPRESSION, EMPTY, CLASS_DEF
 } STMT_TYPE;
 
 /// -----------------------------------------------------------------------------------------------
@@ -61,6 +62,7 @@ public:
         : StmtAST(line), m_retVal(retVal)
     {}
     ~ReturnStmtAST() { delete m_retVal; }
+    const ExprAST* value() const { return m_retVal; }
     virtual std::string dump(int level = 0) const;
     virtual STMT_TYPE stmt_type() const { return STMT_TYPE::RETURN; }
     virtual Value* codegen() const;
@@ -107,6 +109,8 @@ public:
     }
     std::string dump(int level = 0) const;
     STMT_TYPE stmt_type() const { return STMT_TYPE::ASSIGNMENT; }
+    std::string var_name() const { return m_varName; }
+    const ExprAST* expr() const { return m_expr; }
     bool isAllowed() const;
     std::pair<VLANG_TYPE, VLANG_TYPE> assignmentTypes() const {
         return std::pair<VLANG_TYPE, VLANG_TYPE>(m_type, m_expr->type()->vlang_type());
@@ -130,6 +134,7 @@ public:
     }
     std::string dump(int level = 0) const;
     STMT_TYPE stmt_type() const { return STMT_TYPE::ASSIGNMENT_LIST; }
+    VLANG_TYPE type() const { return m_type; }
     const std::vector<std::pair<std::string, ExprAST*>>& assignments() const { return m_list; }
     std::pair<VLANG_TYPE, VLANG_TYPE> assignmentTypesIth(unsigned i) const {
         const VlangType* exprType = m_list[i].second->type();
@@ -155,6 +160,7 @@ public:
         : StmtAST(line), m_expr(expr)
     {}
     ~ExpressionStmtAST() { delete m_expr; }
+    const ExprAST* expr() const { return m_expr; }
     std::string dump(int level = 0) const;
     STMT_TYPE stmt_type() const { return STMT_TYPE::EXPRESSION; }
     virtual Value* codegen() const;
@@ -186,6 +192,8 @@ public:
     }
     std::string dump(int level = 0) const;
     STMT_TYPE stmt_type() const { return STMT_TYPE::IF; }
+    const ExprAST* cond() const { return m_condExpr; }
+    const StmtAST* then_stmt() const { return m_thenStmt; }
     virtual Value* codegen() const;
 
 private:
@@ -208,6 +216,9 @@ public:
     }
     std::string dump(int level = 0) const;
     STMT_TYPE stmt_type() const { return STMT_TYPE::IF_ELSE; }
+    const ExprAST* cond() const { return m_condExpr; }
+    const StmtAST* then_stmt() const { return m_thenStmt; }
+    const StmtAST* else_stmt() const { return m_elseStmt; }
     virtual Value* codegen() const;
 
 private:
@@ -230,6 +241,8 @@ public:
     }
     std::string dump(int level = 0) const;
     STMT_TYPE stmt_type() const { return STMT_TYPE::WHILE; }
+    const ExprAST* cond() const { return m_condExpr; }
+    const StmtAST* body() const { return m_bodyStmt; }
     virtual Value* codegen() const;
 
 private:
@@ -237,6 +250,47 @@ private:
     StmtAST* m_bodyStmt;
 };
 
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents a C-style for statement: for (init; cond; step) body
+///
+/// Init is a statement (declaration or assignment), condition and step are expressions.
+/// Condition and step can be nullptr (for example: for (;;) {...}).
+/// Attributes written before the loop ([Parallel]) change how it's compiled.
+/// -----------------------------------------------------------------------------------------------
+class ForStmtAST : public StmtAST {
+public:
+    ForStmtAST(StmtAST* initStmt, ExprAST* condExpr, ExprAST* stepExpr, StmtAST* bodyStmt, unsigned long long line)
+        : StmtAST(line), m_initStmt(initStmt), m_condExpr(condExpr), m_stepExpr(stepExpr), m_bodyStmt(bodyStmt)
+    {}
+    ~ForStmtAST() {
+        delete m_initStmt;
+        delete m_condExpr;
+        delete m_stepExpr;
+        delete m_bodyStmt;
+    }
+    std::string dump(int level = 0) const;
+    STMT_TYPE stmt_type() const { return STMT_TYPE::FOR; }
+    const StmtAST* init() const { return m_initStmt; }
+    const ExprAST* cond() const { return m_condExpr; }
+    const ExprAST* step() const { return m_stepExpr; }
+    const StmtAST* body() const { return m_bodyStmt; }
+    virtual Value* codegen() const;
+
+    void add_attribute(const std::string& attribute) { m_attributes.insert(attribute); }
+    bool has_attribute(const std::string& attribute) const { return m_attributes.count(attribute) != 0; }
+
+private:
+    /// \brief Generates a [Parallel] loop: the body is outlined into a function running a chunk
+    /// of iterations, which the runtime calls from its threads.
+    Value* codegenParallel() const;
+
+    StmtAST* m_initStmt;
+    ExprAST* m_condExpr;
+    ExprAST* m_stepExpr;
+    StmtAST* m_bodyStmt;
+    std::set<std::string> m_attributes;
+};
+
 // TODO:
 // This class shall be dealt with later once I start compiling onto
 // LLVM IR. I leave it because LLVM requires a lot of information
@@ -268,6 +322,7 @@ public:
     {}
     std::string dump(int level = 0) const;
     std::string name() const { return m_name; }
+    const std::vector<std::pair<VLANG_TYPE, std::string>>& args() const { return m_args; }
     virtual VLANG_TYPE ret_val_type() const { return m_retVal; }
     STMT_TYPE stmt_type() const { return STMT_TYPE::PROTOTYPE; }
     virtual Value* codegen() const;
@@ -280,6 +335,7 @@ private:
 
 /// -----------------------------------------------------------------------------------------------
 /// \brief Represents a function with a definition.
+/// Attributes written before the function ([Multiversion]) change how it's compiled.
 /// -----------------------------------------------------------------------------------------------
 class FunctionAST : public ProtoDefContainer {
 public:
@@ -295,11 +351,128 @@ public:
     const BlockStmtAST* body() const { return m_definition; }
     virtual Value* codegen() const;
 
+    void add_attribute(const std::string& attribute) { m_attributes.insert(attribute); }
+    bool has_attribute(const std::string& attribute) const { return m_attributes.count(attribute) != 0; }
+
 private:
     PrototypeAST m_proto;
     BlockStmtAST* m_definition;
+    std::set<std::string> m_attributes;
 };
 
+/// \brief A field (or an auto-property) of a class.
+struct FieldDecl {
+    VLANG_TYPE type;
+    std::string name;
+    ExprAST* init;          // default value, nullptr if there is none
+    bool property;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represents a class definition.
+///
+/// Objects are heap allocated structs { i64 header, fields... } where fields are sorted by their
+/// alignment so there is no padding between them. Auto-properties are plain fields, accessing
+/// them is a direct load/store. Methods are functions named Class.method whose first argument
+/// is 'this'. There is no inheritance so no method can be overridden and every call is direct.
+/// -----------------------------------------------------------------------------------------------
+class ClassAST : public StmtAST {
+public:
+    ClassAST(std::string name, unsigned long long line)
+        : StmtAST(line), m_name(name), m_type(VLANG_TYPE::UNKNOWN), m_constructor(nullptr)
+    {}
+    ~ClassAST() {
+        for (auto &f : m_fields) delete f.init;
+        for (auto &m : m_methods) delete m;
+        delete m_constructor;
+    }
+    std::string name() const { return m_name; }
+    VLANG_TYPE type() const { return m_type; }
+    void set_type(VLANG_TYPE type) { m_type = type; }
+
+    void add_field(FieldDecl field) { m_fields.push_back(field); }
+    void add_method(FunctionAST* method) { m_methods.push_back(method); }
+    void declare_method(const std::string& name, VLANG_TYPE retType) { m_methodTypes[name] = retType; }
+    void set_constructor(FunctionAST* constructor) { m_constructor = constructor; }
+
+    const std::vector<FieldDecl>& fields() const { return m_fields; }
+    const std::vector<FunctionAST*>& methods() const { return m_methods; }
+    const FunctionAST* constructor() const { return m_constructor; }
+
+    /// \brief Returns the field with given name, nullptr if there is no such field.
+    const FieldDecl* field(const std::string& name) const;
+
+    /// \brief Returns the method with given (unmangled) name, nullptr if there is no such method.
+    const FunctionAST* method(const std::string& name) const;
+
+    /// \brief Returns the return type of given method, UNKNOWN if there is no such method.
+    /// Methods are declared before their body is parsed, so they can be called from any method.
+    VLANG_TYPE method_type(const std::string& name) const {
+        auto finder = m_methodTypes.find(name);
+        return finder == m_methodTypes.end() ? VLANG_TYPE::UNKNOWN : finder->second;
+    }
+
+    /// \brief Returns the name of LLVM function implementing given method.
+    std::string method_name(const std::string& method) const { return m_name + "." + method; }
+
+    /// \brief Returns the index of given field inside LLVM struct.
+    unsigned field_index(const std::string& name) const;
+
+    /// \brief Returns the LLVM struct type of objects (creates it if needed).
+    StructType* llvm_type() const;
+
+    std::string dump(int level = 0) const;
+    STMT_TYPE stmt_type() const { return STMT_TYPE::CLASS_DEF; }
+    virtual Value* codegen() const;
+
+private:
+    /// \brief Returns fields in the order of their layout (by alignment, largest first).
+    std::vector<const FieldDecl*> layout() const;
+
+    std::string m_name;
+    VLANG_TYPE m_type;
+    std::vector<FieldDecl> m_fields;
+    std::vector<FunctionAST*> m_methods;
+    std::map<std::string, VLANG_TYPE> m_methodTypes;
+    FunctionAST* m_constructor;
+};
+
+/// \brief Body of the function which is currently being generated.
+extern const BlockStmtAST* CurrentFunctionBody;
+
+/// \brief Returns how many times variable with given name is written (assigned, declared,
+/// incremented...) inside given statement. Used by range analysis.
+unsigned CountVariableWrites(const StmtAST* stmt, const std::string& name);
+
+/// \brief Operation combining partial results of a reduction in a [Parallel] loop.
+enum class Reduction { SUM, PRODUCT, MIN, MAX };
+
+/// \brief Shape of a [Parallel] loop: for (T i = begin; i < end (or <= end); ++i) body
+struct ParallelLoop {
+    std::string var;
+    VLANG_TYPE varType;
+    const ExprAST* begin;
+    const ExprAST* end;
+    bool inclusive;
+    /// Variables declared outside of the loop which its body uses (arrays used only through
+    /// indexing have UNKNOWN type)
+    std::map<std::string, VLANG_TYPE> outer;
+    /// Outer variables the body writes, each one is a reduction
+    std::map<std::string, Reduction> reductions;
+    /// Iterations may update reference counts of values they share
+    bool sharesManaged;
+};
+
+/// \brief Checks that iterations of given [Parallel] loop are independent, as far as variables
+/// and array elements accessed by the body itself go (aliases of arrays and functions called
+/// from the body aren't checked), and describes the loop. Returns an error message, empty if
+/// the loop can run in parallel.
+std::string AnalyzeParallelLoop(const ForStmtAST* loop, ParallelLoop* res);
+
+/// \brief Escape analysis: fills StackAllocatedObjects with allocations of given function body
+/// whose objects can't outlive the function (or the loop iteration which created them).
+void FindStackAllocatedObjects(const StmtAST* body);
+
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 } // ;vlang
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
@@ -7,7 +7,9 @@
 
 #include "Types.hpp"
 #include "ProgramOptions.hpp"
+#include "GlobalContainers.hpp"
 #include "color.h"
+#include "llvm/Config/llvm-config.h"
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 namespace vlang {
@@ -34,6 +36,35 @@ Type* Int32Type::llvm_type() const {
 int Int32Type::strength() const {
     return 20;
 }
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// INTEGER TYPES
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+std::string IntegerType::str() const {
+    return to_str(m_type);
+}
+
+VLANG_TYPE IntegerType::vlang_type() const {
+    return m_type;
+}
+
+Type* IntegerType::llvm_type() const {
+    return Type::getIntNTy(TheContext, integer_bits(m_type));
+}
+
+// Between bool (10) and double (30), int is 20: wider types are stronger, unsigned types are
+// stronger than signed ones of the same width.
+int IntegerType::strength() const {
+    switch (m_type) {
+        case VLANG_TYPE::INT8:      return 12;
+        case VLANG_TYPE::UINT8:     return 13;
+        case VLANG_TYPE::INT16:     return 14;
+        case VLANG_TYPE::UINT16:    return 15;
+        case VLANG_TYPE::UINT32:    return 21;
+        case VLANG_TYPE::INT64:     return 22;
+        default:                    return 23;
+    }
+}
+
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // DOUBLE TYPE
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -59,12 +90,14 @@ int DoubleType::strength() const {
 // STRING TYPE
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 std::string StringType::str() const {
-    return "string";
+    std::string res = "string";
+    if (util::ProgramOptions::get().syntax_highlight())
+        res = std::string(TYPE_C) + res + std::string(RESET);
+    return res;
 }
 
 Type* StringType::llvm_type() const {
-    std::cerr << "TODO: StringType::llvm_type()" << std::endl;
-    return nullptr;
+    return GetStringStructType();
 }
 
 VLANG_TYPE StringType::vlang_type() const {
@@ -97,6 +130,73 @@ int BoolType::strength() const {
     return 10;
 }
 
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// ARRAY TYPE
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+std::string ArrayType::str() const {
+    return to_str(vlang_type());
+}
+
+Type* ArrayType::llvm_type() const {
+    std::unique_ptr<VlangType> elem(make_from_enum(m_elementType));
+    if (elem == nullptr) return nullptr;
+    return GetArrayStructType(elem->llvm_type())->getPointerTo();
+}
+
+VLANG_TYPE ArrayType::vlang_type() const {
+    return array_of(m_elementType);
+}
+
+int ArrayType::strength() const {
+    return 50;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// SIMD VECTOR
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+std::string SimdType::str() const {
+    return to_str(m_type);
+}
+
+Type* SimdType::llvm_type() const {
+    std::unique_ptr<VlangType> elem(make_from_enum(vector_element(m_type)));
+#if LLVM_VERSION_MAJOR >= 11
+    return FixedVectorType::get(elem->llvm_type(), vector_lanes(m_type));
+#else
+    return VectorType::get(elem->llvm_type(), vector_lanes(m_type));
+#endif
+}
+
+VLANG_TYPE SimdType::vlang_type() const {
+    return m_type;
+}
+
+// Above double, a scalar operand is splatted to the vector
+int SimdType::strength() const {
+    return 35;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// CLASS
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+std::string ClassType::str() const {
+    return to_str(m_type);
+}
+
+Type* ClassType::llvm_type() const {
+    const ClassAST* c = GetClass(m_type);
+    if (c == nullptr) return nullptr;
+    return c->llvm_type()->getPointerTo();
+}
+
+VLANG_TYPE ClassType::vlang_type() const {
+    return m_type;
+}
+
+int ClassType::strength() const {
+    return 50;
+}
+
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // VOID
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -127,11 +227,31 @@ std::string to_str(VLANG_TYPE type) {
     switch (type) {
         case INT32:     res = "int";        break;
         case INT64:     res = "int64";      break;
+        case INT8:      res = "int8";       break;
+        case UINT8:     res = "uint8";      break;
+        case INT16:     res = "int16";      break;
+        case UINT16:    res = "uint16";     break;
+        case UINT32:    res = "uint";       break;
+        case UINT64:    res = "uint64";     break;
         case DOUBLE:    res = "double";     break;
         case BOOL:      res = "bool";       break;
         case STRING:    res = "string";     break;
+        case INT32_ARRAY:   res = "int[]";  break;
+        case DOUBLE_ARRAY:  res = "double[]"; break;
         case VOID:      res = "void";       break;
-        default:        res = "unknown_t";  break;
+        case DOUBLE2:   res = "double2";    break;
+        case DOUBLE4:   res = "double4";    break;
+        case DOUBLE8:   res = "double8";    break;
+        case INT32X4:   res = "int32x4";    break;
+        case INT32X8:   res = "int32x8";    break;
+        case INT32X16:  res = "int32x16";   break;
+        default:
+            if (is_array(type)) {
+                res = to_str(element_of(type)) + "[]";
+                break;
+            }
+            res = is_class(type) && GetClass(type) != nullptr ? GetClass(type)->name() : "unknown_t";
+            break;
     }
     if (util::ProgramOptions::get().syntax_highlight())
         return std::string(TYPE_C) + res + std::string(RESET);
@@ -148,7 +268,122 @@ std::string to_str(Type* llvm_type) {
         return "unknown_type";
 }
 
+bool is_integer(VLANG_TYPE type) {
+    return integer_bits(type) != 0;
+}
+
+bool is_unsigned(VLANG_TYPE type) {
+    return type == VLANG_TYPE::UINT8 || type == VLANG_TYPE::UINT16 ||
+           type == VLANG_TYPE::UINT32 || type == VLANG_TYPE::UINT64;
+}
+
+unsigned integer_bits(VLANG_TYPE type) {
+    switch (type) {
+        case VLANG_TYPE::INT8:   case VLANG_TYPE::UINT8:    return 8;
+        case VLANG_TYPE::INT16:  case VLANG_TYPE::UINT16:   return 16;
+        case VLANG_TYPE::INT32:  case VLANG_TYPE::UINT32:   return 32;
+        case VLANG_TYPE::INT64:  case VLANG_TYPE::UINT64:   return 64;
+        default:                                            return 0;
+    }
+}
+
+bool is_integer_widening(VLANG_TYPE from, VLANG_TYPE to) {
+    if (! is_integer(from) || ! is_integer(to)) return false;
+    if (is_unsigned(from) == is_unsigned(to)) return integer_bits(from) <= integer_bits(to);
+    // uint8 fits into int16, but no signed type fits into an unsigned one
+    return is_unsigned(from) && integer_bits(from) < integer_bits(to);
+}
+
+VLANG_TYPE common_type(VLANG_TYPE left, VLANG_TYPE right) {
+    // Scalar operand of a vector operation is converted to the lane type and splatted
+    // (int vectors take only integers)
+    if (is_vector(left) && (right == left || common_type(vector_element(left), right) == vector_element(left)))
+        return left;
+    if (is_vector(right) && common_type(left, vector_element(right)) == vector_element(right))
+        return right;
+    if (left == VLANG_TYPE::DOUBLE && (right == VLANG_TYPE::DOUBLE || is_integer(right))) return left;
+    if (right == VLANG_TYPE::DOUBLE && is_integer(left)) return right;
+    if (! is_integer(left) || ! is_integer(right)) return VLANG_TYPE::UNKNOWN;
+
+    if (integer_bits(left) < 32) left = VLANG_TYPE::INT32;
+    if (integer_bits(right) < 32) right = VLANG_TYPE::INT32;
+    if (left == right) return left;
+    if (integer_bits(left) != integer_bits(right))
+        return integer_bits(left) > integer_bits(right) ? left : right;
+    return is_unsigned(left) ? left : right;
+}
+
+// Vector types with their lane type and number of lanes
+static const struct {
+    VLANG_TYPE type;
+    VLANG_TYPE element;
+    unsigned lanes;
+} VectorTypes[] = {
+    { VLANG_TYPE::DOUBLE2,  VLANG_TYPE::DOUBLE, 2 },
+    { VLANG_TYPE::DOUBLE4,  VLANG_TYPE::DOUBLE, 4 },
+    { VLANG_TYPE::DOUBLE8,  VLANG_TYPE::DOUBLE, 8 },
+    { VLANG_TYPE::INT32X4,  VLANG_TYPE::INT32,  4 },
+    { VLANG_TYPE::INT32X8,  VLANG_TYPE::INT32,  8 },
+    { VLANG_TYPE::INT32X16, VLANG_TYPE::INT32,  16 },
+};
+
+bool is_vector(VLANG_TYPE type) {
+    return vector_lanes(type) != 0;
+}
+
+VLANG_TYPE vector_element(VLANG_TYPE vectorType) {
+    for (auto &v : VectorTypes)
+        if (v.type == vectorType) return v.element;
+    return VLANG_TYPE::UNKNOWN;
+}
+
+unsigned vector_lanes(VLANG_TYPE vectorType) {
+    for (auto &v : VectorTypes)
+        if (v.type == vectorType) return v.lanes;
+    return 0;
+}
+
+// Array types of element types, in the same order
+static const VLANG_TYPE ArrayTypes[][2] = {
+    { VLANG_TYPE::INT32,  VLANG_TYPE::INT32_ARRAY },
+    { VLANG_TYPE::DOUBLE, VLANG_TYPE::DOUBLE_ARRAY },
+    { VLANG_TYPE::INT8,   VLANG_TYPE::INT8_ARRAY },
+    { VLANG_TYPE::UINT8,  VLANG_TYPE::UINT8_ARRAY },
+    { VLANG_TYPE::INT16,  VLANG_TYPE::INT16_ARRAY },
+    { VLANG_TYPE::UINT16, VLANG_TYPE::UINT16_ARRAY },
+    { VLANG_TYPE::UINT32, VLANG_TYPE::UINT32_ARRAY },
+    { VLANG_TYPE::INT64,  VLANG_TYPE::INT64_ARRAY },
+    { VLANG_TYPE::UINT64, VLANG_TYPE::UINT64_ARRAY },
+};
+
+bool is_array(VLANG_TYPE type) {
+    return element_of(type) != VLANG_TYPE::UNKNOWN;
+}
+
+VLANG_TYPE array_of(VLANG_TYPE elementType) {
+    for (auto &types : ArrayTypes)
+        if (types[0] == elementType) return types[1];
+    return VLANG_TYPE::UNKNOWN;
+}
+
+VLANG_TYPE element_of(VLANG_TYPE arrayType) {
+    for (auto &types : ArrayTypes)
+        if (types[1] == arrayType) return types[0];
+    return VLANG_TYPE::UNKNOWN;
+}
+
+bool is_class(VLANG_TYPE type) {
+    return type >= VLANG_TYPE::CLASS && type <= VLANG_TYPE::CLASS_LAST;
+}
+
+bool is_managed(VLANG_TYPE type) {
+    return type == VLANG_TYPE::STRING || is_array(type) || is_class(type);
+}
+
 VlangType* make_from_enum(VLANG_TYPE type) {
+    if (is_class(type))
+        return new ClassType(type);
+
     switch (type) {
         case VLANG_TYPE::INT32:
             return new Int32Type();
@@ -161,6 +396,12 @@ VlangType* make_from_enum(VLANG_TYPE type) {
         case VLANG_TYPE::VOID:
             return new VoidType();
         default:
+            if (is_integer(type))
+                return new IntegerType(type);
+            if (is_array(type))
+                return new ArrayType(element_of(type));
+            if (is_vector(type))
+                return new SimdType(type);
             std::cerr << "What is this type? " << to_str(type) << std::endl;
             return nullptr;
     }
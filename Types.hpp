@@ -17,12 +17,59 @@ namespace vlang {
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
 typedef enum{
-    INT32, INT64, DOUBLE, BOOL, STRING, VOID, NO_VAR_DECL, UNKNOWN
+    INT32, INT64, DOUBLE, BOOL, STRING, INT32_ARRAY, DOUBLE_ARRAY, VOID, NO_VAR_DECL, UNKNOWN,
+    INT8, UINT8, INT16, UINT16, UINT32, UINT64,
+    INT8_ARRAY, UINT8_ARRAY, INT16_ARRAY, UINT16_ARRAY, UINT32_ARRAY, INT64_ARRAY, UINT64_ARRAY,
+    DOUBLE2, DOUBLE4, DOUBLE8, INT32X4, INT32X8, INT32X16,
+    // Class types are CLASS + index of the class inside ClassContainer
+    CLASS = 0x100, CLASS_LAST = 0xffff
 } VLANG_TYPE;
 
 std::string to_str(VLANG_TYPE type);
 std::string to_str(Type* llvm_type);
 
+/// \brief Returns true if given type is one of integer types (int8 ... uint64, not bool).
+bool is_integer(VLANG_TYPE type);
+
+/// \brief Returns true if given type is an unsigned integer type (uint8 ... uint64).
+bool is_unsigned(VLANG_TYPE type);
+
+/// \brief Returns the width in bits of given integer type (0 if it's not an integer).
+unsigned integer_bits(VLANG_TYPE type);
+
+/// \brief Returns true if every value of type from can be represented in type to (int8 -> int,
+/// uint8 -> int16, int -> int64...).
+bool is_integer_widening(VLANG_TYPE from, VLANG_TYPE to);
+
+/// \brief Returns the type both operands of an arithmetic or relational operation are converted
+/// to, same as C: integers narrower than int are promoted to int, int and double give double,
+/// signed and unsigned of the same width give unsigned (UNKNOWN if types aren't numeric).
+VLANG_TYPE common_type(VLANG_TYPE left, VLANG_TYPE right);
+
+/// \brief Returns true if given type is a SIMD vector type (double4, int32x8...).
+bool is_vector(VLANG_TYPE type);
+
+/// \brief Returns the lane type of given vector type (UNKNOWN if it's not a vector).
+VLANG_TYPE vector_element(VLANG_TYPE vectorType);
+
+/// \brief Returns the number of lanes of given vector type (0 if it's not a vector).
+unsigned vector_lanes(VLANG_TYPE vectorType);
+
+/// \brief Returns true if given type is an array type (int[], double[]...).
+bool is_array(VLANG_TYPE type);
+
+/// \brief Returns an array type with given element type (UNKNOWN if there is no such array).
+VLANG_TYPE array_of(VLANG_TYPE elementType);
+
+/// \brief Returns the element type of given array type (UNKNOWN if it's not an array).
+VLANG_TYPE element_of(VLANG_TYPE arrayType);
+
+/// \brief Returns true if given type is a class type.
+bool is_class(VLANG_TYPE type);
+
+/// \brief Returns true if values of given type are reference counted (strings, arrays, objects).
+bool is_managed(VLANG_TYPE type);
+
 // NOTE
 // Classes are not yet utilized inside the compiler.
 // For now, I have decided to stick with a simple enum for types
@@ -59,6 +106,24 @@ public:
     virtual int strength() const;
 };
 
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represenets the other integer types: int8, uint8, int16, uint16, uint32, int64, uint64.
+///
+/// Signedness isn't a part of LLVM integer types, it's carried by the vlang type and picks
+/// instructions (sdiv/udiv, sext/zext...) during codegen.
+/// -----------------------------------------------------------------------------------------------
+class IntegerType : public VlangType {
+public:
+    IntegerType(VLANG_TYPE type) : m_type(type) {}
+    virtual std::string str() const;
+    virtual Type* llvm_type() const;
+    virtual VLANG_TYPE vlang_type() const;
+    virtual int strength() const;
+
+private:
+    VLANG_TYPE m_type;
+};
+
 /// -----------------------------------------------------------------------------------------------
 /// \brief Represenets a double type.
 /// -----------------------------------------------------------------------------------------------
@@ -92,6 +157,57 @@ public:
     virtual int strength() const;
 };
 
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represenets an array type (int[], double[]).
+///
+/// Arrays are contiguous heap buffers with a 16 byte header:
+///     { i64 length, i64 refcount, [0 x T] data }
+/// so the data itself is 16 byte aligned. Array value is a pointer to the header.
+/// -----------------------------------------------------------------------------------------------
+class ArrayType : public VlangType {
+public:
+    ArrayType(VLANG_TYPE elementType) : m_elementType(elementType) {}
+    virtual std::string str() const;
+    virtual Type* llvm_type() const;
+    virtual VLANG_TYPE vlang_type() const;
+    virtual int strength() const;
+    VLANG_TYPE element_type() const { return m_elementType; }
+
+private:
+    VLANG_TYPE m_elementType;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represenets a fixed width SIMD vector (double2/4/8, int32x4/8/16), maps directly to an
+/// LLVM vector type. Vectors are values like doubles, arithmetic works lane by lane.
+/// -----------------------------------------------------------------------------------------------
+class SimdType : public VlangType {
+public:
+    SimdType(VLANG_TYPE type) : m_type(type) {}
+    virtual std::string str() const;
+    virtual Type* llvm_type() const;
+    virtual VLANG_TYPE vlang_type() const;
+    virtual int strength() const;
+
+private:
+    VLANG_TYPE m_type;
+};
+
+/// -----------------------------------------------------------------------------------------------
+/// \brief Represenets a class type. Objects are heap allocated structs, the value is a pointer.
+/// -----------------------------------------------------------------------------------------------
+class ClassType : public VlangType {
+public:
+    ClassType(VLANG_TYPE type) : m_type(type) {}
+    virtual std::string str() const;
+    virtual Type* llvm_type() const;
+    virtual VLANG_TYPE vlang_type() const;
+    virtual int strength() const;
+
+private:
+    VLANG_TYPE m_type;
+};
+
 class VoidType : public VlangType {
 public:
     virtual std::string str() const;
@@ -0,0 +1,133 @@
+/* Allocation microbenchmarks: vlang allocator (lib/alloc.c) against malloc.
+ * Built and run by run.sh, prints nanoseconds per allocation/free pair. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "../../lib/vlang.h"
+
+#define LIVE 4096
+#define ROUNDS 2000
+#define THREADS 4
+
+typedef struct {
+    const char* name;
+    void* (*alloc)(size_t);
+    void (*free)(void*, size_t);
+} allocator;
+
+static void* sys_alloc(size_t size) { return malloc(size); }
+static void sys_free(void* ptr, size_t size) { (void)size; free(ptr); }
+
+static const allocator allocators[] = {
+    { "vlang", vlang_alloc, vlang_free },
+    { "malloc", sys_alloc, sys_free },
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Sizes of objects and short strings, with an occasional array */
+static size_t mixed_size(unsigned i) {
+    static const size_t sizes[] = { 24, 32, 40, 56, 64, 96, 24, 48, 200, 32, 1040, 24 };
+    return sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+}
+
+/* Allocates and immediately frees a single block (temporaries). */
+static void bench_pairs(const allocator* a) {
+    for (unsigned r = 0; r < ROUNDS * LIVE / 8; ++r)
+        for (unsigned i = 0; i < 8; ++i) {
+            void* p = a->alloc(32);
+            *(volatile char*)p = 1;
+            a->free(p, 32);
+        }
+}
+
+/* Builds LIVE blocks, frees them in allocation order (lists, queues). */
+static void bench_fifo(const allocator* a) {
+    static void* blocks[LIVE];
+    for (unsigned r = 0; r < ROUNDS; ++r) {
+        for (unsigned i = 0; i < LIVE; ++i)
+            blocks[i] = a->alloc(mixed_size(i));
+        for (unsigned i = 0; i < LIVE; ++i)
+            a->free(blocks[i], mixed_size(i));
+    }
+}
+
+/* Replaces random live blocks (long running programs). */
+static void bench_random(const allocator* a) {
+    static void* blocks[LIVE];
+    static size_t sizes[LIVE];
+    for (unsigned i = 0; i < LIVE; ++i)
+        blocks[i] = a->alloc(sizes[i] = mixed_size(i));
+    uint32_t x = 12345;
+    for (unsigned r = 0; r < ROUNDS * LIVE; ++r) {
+        x = x * 1103515245u + 12345u;
+        unsigned i = (x >> 8) % LIVE;
+        a->free(blocks[i], sizes[i]);
+        blocks[i] = a->alloc(sizes[i] = mixed_size(x >> 20));
+    }
+    for (unsigned i = 0; i < LIVE; ++i)
+        a->free(blocks[i], sizes[i]);
+}
+
+/* Blocks are allocated by one thread and freed by another one. */
+typedef struct {
+    const allocator* a;
+    void** blocks;
+} handoff;
+
+static void* free_blocks(void* arg) {
+    handoff* h = arg;
+    for (unsigned i = 0; i < LIVE; ++i)
+        h->a->free(h->blocks[i], mixed_size(i));
+    return NULL;
+}
+
+static void* producer(void* arg) {
+    const allocator* a = arg;
+    void* blocks[LIVE];
+    for (unsigned r = 0; r < ROUNDS / 8; ++r) {
+        for (unsigned i = 0; i < LIVE; ++i)
+            blocks[i] = a->alloc(mixed_size(i));
+        handoff h = { a, blocks };
+        pthread_t consumer;
+        pthread_create(&consumer, NULL, free_blocks, &h);
+        pthread_join(consumer, NULL);
+    }
+    return NULL;
+}
+
+static void bench_threads(const allocator* a) {
+    pthread_t threads[THREADS];
+    for (unsigned t = 0; t < THREADS; ++t)
+        pthread_create(&threads[t], NULL, producer, (void*)a);
+    for (unsigned t = 0; t < THREADS; ++t)
+        pthread_join(threads[t], NULL);
+}
+
+static const struct {
+    const char* name;
+    void (*run)(const allocator*);
+    double pairs;
+} benchmarks[] = {
+    { "pairs", bench_pairs, (double)ROUNDS * LIVE },
+    { "fifo", bench_fifo, (double)ROUNDS * LIVE },
+    { "random", bench_random, (double)ROUNDS * LIVE + LIVE },
+    { "threads", bench_threads, (double)THREADS * (ROUNDS / 8) * LIVE },
+};
+
+int main(void) {
+    for (unsigned b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); ++b)
+        for (unsigned a = 0; a < sizeof(allocators) / sizeof(allocators[0]); ++a) {
+            double start = now();
+            benchmarks[b].run(&allocators[a]);
+            double ns = (now() - start) * 1e9 / benchmarks[b].pairs;
+            printf("%-8s %-7s %7.2f ns\n", benchmarks[b].name, allocators[a].name, ns);
+        }
+    return 0;
+}
@@ -0,0 +1,41 @@
+// Object-heavy program: short lived lists of objects with string and array fields.
+class Item : GLib.Object {
+    public int id;
+    public string label;
+    public int[] values;
+    public Item next;
+
+    public Item(int id) {
+        this.id = id;
+        this.label = "item number " + id.to_string();
+        this.values = new int[4 + id % 8];
+    }
+
+    public int weight() {
+        return label.length() + values.length;
+    }
+}
+
+// Builds a list of n items, only the head is returned
+Item build(int n) {
+    Item head = new Item(0);
+    for (int i = 1; i < n; ++i) {
+        Item item = new Item(i);
+        item.next = head;
+        head = item;
+    }
+    return head;
+}
+
+int main() {
+    int total = 0;
+    for (int round = 0; round < 200; ++round) {
+        Item it = build(5000);
+        for (int i = 0; i < 5000; ++i) {
+            total = (total + it.weight()) % 1000007;
+            it = it.next;
+        }
+    }
+    stdout.printf("%d\n", total);
+    return 0;
+}
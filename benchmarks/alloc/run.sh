@@ -0,0 +1,25 @@
+#!/bin/bash
+# Allocation microbenchmarks and memory footprint of object heavy programs, the vlang
+# allocator against malloc (VLANG_MALLOC=1). Footprint comes from VLANG_ALLOC_STATS=1.
+# Run from anywhere, vlang has to be built in the repository root.
+cd "$(dirname "$0")/../.." || exit 1
+mkdir -p build
+
+gcc -O2 -pthread benchmarks/alloc/alloc_bench.c lib/alloc.c -o build/bench_alloc || exit 1
+./build/bench_alloc
+
+for program in benchmarks/alloc/objects.vala tests/12_classes.vala tests/14_refcount.vala; do
+    name=$(basename "$program" .vala)
+    ./vlang -O 3 -l 0 "$program" -o "build/bench_alloc_$name" > /dev/null 2>&1 \
+        || { echo "vlang failed on $program"; exit 1; }
+
+    echo
+    echo "== $name"
+    for malloc in 0 1; do
+        start=$(date +%s.%N)
+        VLANG_MALLOC=$malloc "./build/bench_alloc_$name" > /dev/null
+        end=$(date +%s.%N)
+        printf "%-7s %8.3f s\n" "$([ $malloc = 1 ] && echo malloc || echo vlang)" "$(echo "$end - $start" | bc)"
+    done
+    VLANG_ALLOC_STATS=1 "./build/bench_alloc_$name" 2>&1 > /dev/null | grep "vlang alloc"
+done
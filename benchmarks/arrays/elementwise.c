@@ -0,0 +1,32 @@
+/* C equivalent of elementwise.vala */
+#include <stdio.h>
+#include <stdlib.h>
+
+void fma_arrays(const double* a, const double* b, double* c, int n) {
+    for (int i = 0; i < n; ++i)
+        c[i] = a[i] * b[i] + c[i];
+}
+
+void scale(int* a, int n, int k) {
+    for (int i = 0; i < n; ++i)
+        a[i] = a[i] * k;
+}
+
+int main() {
+    int n = 1000000;
+    double* a = calloc(n, sizeof(double));
+    double* b = calloc(n, sizeof(double));
+    double* c = calloc(n, sizeof(double));
+    int* d = calloc(n, sizeof(int));
+    for (int i = 0; i < n; ++i) {
+        a[i] = i * 0.5;
+        b[i] = 0.25;
+        d[i] = 1;
+    }
+    for (int r = 0; r < 1000; ++r) {
+        fma_arrays(a, b, c, n);
+        scale(d, n, 1);
+    }
+    printf("%g\n", c[n - 1]);
+    return 0;
+}
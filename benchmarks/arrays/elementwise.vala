@@ -0,0 +1,31 @@
+// Element-wise array operations: c = a * b + c, scaling.
+void print_double(double x);
+
+void fma_arrays(double[] a, double[] b, double[] c) {
+    for (int i = 0; i < c.length; ++i)
+        c[i] = a[i] * b[i] + c[i];
+}
+
+void scale(int[] a, int k) {
+    for (int i = 0; i < a.length; ++i)
+        a[i] = a[i] * k;
+}
+
+int main() {
+    int n = 1000000;
+    double[] a = new double[n];
+    double[] b = new double[n];
+    double[] c = new double[n];
+    int[] d = new int[n];
+    for (int i = 0; i < n; ++i) {
+        a[i] = i * 0.5;
+        b[i] = 0.25;
+        d[i] = 1;
+    }
+    for (int r = 0; r < 1000; ++r) {
+        fma_arrays(a, b, c);
+        scale(d, 1);
+    }
+    print_double(c[n - 1]);
+    return 0;
+}
@@ -0,0 +1,45 @@
+/* C equivalent of reduce.vala */
+#include <stdio.h>
+#include <stdlib.h>
+
+int sum_int(const int* a, int n) {
+    int s = 0;
+    for (int i = 0; i < n; ++i)
+        s = s + a[i];
+    return s;
+}
+
+int max_int(const int* a, int n) {
+    int m = a[0];
+    for (int i = 1; i < n; ++i)
+        if (a[i] > m) m = a[i];
+    return m;
+}
+
+double sum_double(const double* a, int n) {
+    double s = 0.0;
+    for (int i = 0; i < n; ++i)
+        s = s + a[i];
+    return s;
+}
+
+int main() {
+    int n = 1000000;
+    int* a = calloc(n, sizeof(int));
+    double* b = calloc(n, sizeof(double));
+    for (int i = 0; i < n; ++i) {
+        a[i] = i % 1000;
+        b[i] = i * 0.001;
+    }
+
+    int total = 0;
+    int biggest = 0;
+    double dtotal = 0.0;
+    for (int r = 0; r < 1000; ++r) {
+        total = (total + sum_int(a, n)) % 1000007;
+        biggest = biggest + max_int(a, n);
+        dtotal = dtotal + sum_double(b, n);
+    }
+    printf("%d\n%d\n%g\n", total, biggest, dtotal);
+    return 0;
+}
@@ -0,0 +1,47 @@
+// Array reductions: sum and max of int/double arrays.
+void print_int(int x);
+void print_double(double x);
+
+int sum_int(int[] a) {
+    int s = 0;
+    for (int i = 0; i < a.length; ++i)
+        s = s + a[i];
+    return s;
+}
+
+int max_int(int[] a) {
+    int m = a[0];
+    for (int i = 1; i < a.length; ++i)
+        if (a[i] > m) m = a[i];
+    return m;
+}
+
+double sum_double(double[] a) {
+    double s = 0.0;
+    for (int i = 0; i < a.length; ++i)
+        s = s + a[i];
+    return s;
+}
+
+int main() {
+    int n = 1000000;
+    int[] a = new int[n];
+    double[] b = new double[n];
+    for (int i = 0; i < n; ++i) {
+        a[i] = i % 1000;
+        b[i] = i * 0.001;
+    }
+
+    int total = 0;
+    int biggest = 0;
+    double dtotal = 0.0;
+    for (int r = 0; r < 1000; ++r) {
+        total = (total + sum_int(a)) % 1000007;
+        biggest = biggest + max_int(a);
+        dtotal = dtotal + sum_double(b);
+    }
+    print_int(total);
+    print_int(biggest);
+    print_double(dtotal);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#!/bin/bash
+# Compares vlang generated code with equivalent C (gcc -O2) on array kernels.
+# Run from anywhere, vlang has to be built in the repository root.
+cd "$(dirname "$0")/../.." || exit 1
+mkdir -p build
+
+for bench in reduce elementwise; do
+    ./vlang -O 3 -l 0 benchmarks/arrays/$bench.vala -o build/bench_${bench}_vala > /dev/null 2>&1 \
+        || { echo "vlang failed on $bench.vala"; exit 1; }
+    gcc -O2 benchmarks/arrays/$bench.c -o build/bench_${bench}_c || exit 1
+
+    for impl in vala c; do
+        start=$(date +%s.%N)
+        ./build/bench_${bench}_${impl} > /dev/null
+        end=$(date +%s.%N)
+        printf "%-12s %-5s %8.3f s\n" "$bench" "$impl" "$(echo "$end - $start" | bc)"
+    done
+done
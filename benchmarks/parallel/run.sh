@@ -0,0 +1,24 @@
+#!/bin/bash
+# Scaling of [Parallel] loops from 1 thread to all CPUs (VLANG_THREADS), or to the number of
+# threads given as the first argument. Speedup is relative to the 1 thread run.
+# Run from anywhere, vlang has to be built in the repository root.
+cd "$(dirname "$0")/../.." || exit 1
+mkdir -p build
+max=${1:-$(nproc)}
+
+./vlang -O 3 -l 0 benchmarks/parallel/scaling.vala -o build/bench_parallel > /dev/null 2>&1 \
+    || { echo "vlang failed on scaling.vala"; exit 1; }
+
+base=""
+threads=1
+while [ "$threads" -le "$max" ]; do
+    start=$(date +%s.%N)
+    VLANG_THREADS=$threads ./build/bench_parallel > /dev/null
+    end=$(date +%s.%N)
+    time=$(echo "$end - $start" | bc)
+    [ -z "$base" ] && base=$time
+    printf "%3d threads %8.3f s %6.2fx\n" "$threads" "$time" "$(echo "$base / $time" | bc -l)"
+    [ "$threads" -eq "$max" ] && break
+    threads=$((threads * 2))
+    [ "$threads" -gt "$max" ] && threads=$max
+done
@@ -0,0 +1,42 @@
+// [Parallel] loops: a balanced kernel (the same work per iteration) and an unbalanced one
+// (work grows with i), which is where work stealing and adaptive chunks matter.
+void print_double(double x);
+
+double balanced(double[] a) {
+    double sum = 0.0;
+    [Parallel]
+    for (int i = 0; i < a.length; ++i) {
+        double x = a[i];
+        for (int k = 0; k < 64; ++k)
+            x = Math.sqrt(x * x + 1.0);
+        sum = sum + x;
+    }
+    return sum;
+}
+
+double unbalanced(double[] a) {
+    double biggest = 0.0;
+    [Parallel]
+    for (int i = 0; i < a.length; ++i) {
+        double x = a[i];
+        for (int k = 0; k < i / 256; ++k)
+            x = Math.sqrt(x * x + 1.0);
+        biggest = Math.fmax(biggest, x);
+    }
+    return biggest;
+}
+
+int main() {
+    int n = 200000;
+    double[] a = new double[n];
+    [Parallel]
+    for (int i = 0; i < n; ++i)
+        a[i] = i * 0.001;
+
+    double total = 0.0;
+    for (int r = 0; r < 20; ++r)
+        total = total + balanced(a);
+    print_double(total);
+    print_double(unbalanced(a));
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "vlang.h"
+
+/* Allocator of vlang programs, all objects, arrays and strings are allocated here.
+ *
+ * Requests of up to VLANG_ALLOC_MAX bytes are rounded up to a size class and served from
+ * free lists of the calling thread, without any locking. A thread cache takes blocks from
+ * the shared pool (or carves a fresh chunk) a batch at a time and gives a batch back once
+ * it holds too many free blocks, exiting threads give back everything. Chunks are cut from
+ * 1 MiB regions which are never returned to the system.
+ *
+ * Callers pass the size of the block to vlang_free(), so blocks don't need any header.
+ * Classes of 64 bytes and more are multiples of 64 and such blocks are 64 byte aligned
+ * (arrays rely on it), larger requests go to aligned_alloc().
+ *
+ * VLANG_MALLOC=1 in the environment (or runtime built with -DVLANG_USE_MALLOC, see
+ * vlang --malloc) forwards everything to the system allocator, which is what valgrind and
+ * sanitizers want. VLANG_ALLOC_STATS=1 prints a memory report at exit. */
+#define VLANG_ALLOC_MAX 32768
+#define VLANG_ALLOC_ALIGNMENT 64
+#define VLANG_REGION_SIZE (1 << 20)
+#define VLANG_BATCH_BYTES 8192
+#define VLANG_BATCH_MIN 4
+#define VLANG_BATCH_MAX 128
+
+/* 16 byte steps up to 64, then 4 classes per power of two */
+static const uint32_t vlang_class_size[] = {
+    16, 32, 48, 64, 128, 192, 256, 320, 384, 448, 512, 640, 768, 896, 1024,
+    1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192,
+    10240, 12288, 14336, 16384, 20480, 24576, 28672, 32768
+};
+#define VLANG_CLASSES (sizeof(vlang_class_size) / sizeof(vlang_class_size[0]))
+
+/* Size class of each multiple of 64 (index is size rounded up to 64, divided by 64) */
+static uint8_t vlang_class_of[VLANG_ALLOC_MAX / 64 + 1];
+static uint32_t vlang_class_batch[VLANG_CLASSES];
+
+typedef struct vlang_block {
+    struct vlang_block* next;
+} vlang_block;
+
+typedef struct {
+    vlang_block* head;
+    uint32_t count;
+} vlang_free_list;
+
+static __thread vlang_free_list vlang_cache[VLANG_CLASSES];
+static __thread int vlang_cache_registered;
+
+/* Shared pool, one list per class, and the region chunks are cut from */
+static pthread_mutex_t vlang_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static vlang_free_list vlang_pool[VLANG_CLASSES];
+static char* vlang_region;
+static size_t vlang_region_left;
+static pthread_key_t vlang_cache_key;
+
+static int vlang_use_malloc;
+static int vlang_stats;
+
+/* Statistics, only updated with VLANG_ALLOC_STATS */
+static struct {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t in_use;
+    uint64_t peak;
+    uint64_t reserved;
+    uint64_t large;
+    uint64_t per_class[VLANG_CLASSES];
+} vlang_alloc_stats;
+
+static void vlang_out_of_memory(void) {
+    fprintf(stderr, "vlang: out of memory\n");
+    abort();
+}
+
+static inline unsigned vlang_size_class(size_t size) {
+    if (size <= 64)
+        return size <= 16 ? 0 : (unsigned)((size - 1) >> 4);
+    return vlang_class_of[(size + 63) >> 6];
+}
+
+static void vlang_count(size_t bytes, unsigned c, int allocation) {
+    if (allocation) {
+        __atomic_add_fetch(&vlang_alloc_stats.allocations, 1, __ATOMIC_RELAXED);
+        if (c < VLANG_CLASSES)
+            __atomic_add_fetch(&vlang_alloc_stats.per_class[c], 1, __ATOMIC_RELAXED);
+        else
+            __atomic_add_fetch(&vlang_alloc_stats.large, 1, __ATOMIC_RELAXED);
+        uint64_t now = __atomic_add_fetch(&vlang_alloc_stats.in_use, bytes, __ATOMIC_RELAXED);
+        uint64_t peak = __atomic_load_n(&vlang_alloc_stats.peak, __ATOMIC_RELAXED);
+        while (now > peak && !__atomic_compare_exchange_n(&vlang_alloc_stats.peak, &peak, now, 1,
+                                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+    } else {
+        __atomic_add_fetch(&vlang_alloc_stats.frees, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&vlang_alloc_stats.in_use, bytes, __ATOMIC_RELAXED);
+    }
+}
+
+/* Gives all blocks of an exiting thread back to the shared pool. */
+static void vlang_cache_flush(void* unused) {
+    (void)unused;
+    pthread_mutex_lock(&vlang_pool_lock);
+    for (unsigned c = 0; c < VLANG_CLASSES; ++c) {
+        vlang_free_list* list = &vlang_cache[c];
+        if (list->head == NULL) continue;
+        vlang_block* tail = list->head;
+        while (tail->next != NULL)
+            tail = tail->next;
+        tail->next = vlang_pool[c].head;
+        vlang_pool[c].head = list->head;
+        vlang_pool[c].count += list->count;
+        list->head = NULL;
+        list->count = 0;
+    }
+    pthread_mutex_unlock(&vlang_pool_lock);
+}
+
+/* Cuts a chunk of given size from the current region, pool lock has to be held. */
+static char* vlang_region_take(size_t size) {
+    if (vlang_region_left < size) {
+        vlang_region = aligned_alloc(VLANG_ALLOC_ALIGNMENT, VLANG_REGION_SIZE);
+        if (vlang_region == NULL) vlang_out_of_memory();
+        vlang_region_left = VLANG_REGION_SIZE;
+        if (vlang_stats)
+            __atomic_add_fetch(&vlang_alloc_stats.reserved, VLANG_REGION_SIZE, __ATOMIC_RELAXED);
+    }
+    char* chunk = vlang_region;
+    vlang_region += size;
+    vlang_region_left -= size;
+    return chunk;
+}
+
+/* Makes sure blocks of current thread go back to the pool when the thread exits. */
+static void vlang_cache_register(void) {
+    if (!vlang_cache_registered) {
+        vlang_cache_registered = 1;
+        pthread_setspecific(vlang_cache_key, vlang_cache);
+    }
+}
+
+/* Slow path of vlang_alloc(): fills the empty thread cache of given class with a batch. */
+static vlang_block* vlang_refill(unsigned c) {
+    vlang_free_list* list = &vlang_cache[c];
+    uint32_t batch = vlang_class_batch[c];
+    vlang_cache_register();
+
+    pthread_mutex_lock(&vlang_pool_lock);
+    vlang_free_list* pool = &vlang_pool[c];
+    if (pool->head != NULL) {
+        vlang_block* last = pool->head;
+        uint32_t taken = 1;
+        while (taken < batch && last->next != NULL) {
+            last = last->next;
+            ++taken;
+        }
+        list->head = pool->head;
+        list->count = taken;
+        pool->head = last->next;
+        pool->count -= taken;
+        last->next = NULL;
+    } else {
+        size_t size = vlang_class_size[c];
+        char* chunk = vlang_region_take(size * batch);
+        for (uint32_t i = 0; i + 1 < batch; ++i)
+            ((vlang_block*)(chunk + i * size))->next = (vlang_block*)(chunk + (i + 1) * size);
+        ((vlang_block*)(chunk + (batch - 1) * size))->next = NULL;
+        list->head = (vlang_block*)chunk;
+        list->count = batch;
+    }
+    pthread_mutex_unlock(&vlang_pool_lock);
+    return list->head;
+}
+
+/* Slow path of vlang_free(): thread cache holds two batches, one of them goes to the pool. */
+static void vlang_release_batch(unsigned c) {
+    vlang_free_list* list = &vlang_cache[c];
+    uint32_t batch = vlang_class_batch[c];
+    vlang_block* first = list->head;
+    vlang_block* last = first;
+    for (uint32_t i = 1; i < batch; ++i)
+        last = last->next;
+    list->head = last->next;
+    list->count -= batch;
+
+    pthread_mutex_lock(&vlang_pool_lock);
+    last->next = vlang_pool[c].head;
+    vlang_pool[c].head = first;
+    vlang_pool[c].count += batch;
+    pthread_mutex_unlock(&vlang_pool_lock);
+}
+
+static void* vlang_system_alloc(size_t size) {
+    void* ptr = size < VLANG_ALLOC_ALIGNMENT
+        ? malloc(size)
+        : aligned_alloc(VLANG_ALLOC_ALIGNMENT, (size + VLANG_ALLOC_ALIGNMENT - 1) & ~(size_t)(VLANG_ALLOC_ALIGNMENT - 1));
+    if (ptr == NULL) vlang_out_of_memory();
+    return ptr;
+}
+
+void* vlang_alloc(size_t size) {
+    if (vlang_use_malloc || size > VLANG_ALLOC_MAX) {
+        if (vlang_stats) {
+            vlang_count(size, VLANG_CLASSES, 1);
+            if (!vlang_use_malloc)
+                __atomic_add_fetch(&vlang_alloc_stats.reserved, size, __ATOMIC_RELAXED);
+        }
+        return vlang_system_alloc(size);
+    }
+    unsigned c = vlang_size_class(size);
+    vlang_free_list* list = &vlang_cache[c];
+    vlang_block* block = list->head;
+    if (block == NULL)
+        block = vlang_refill(c);
+    list->head = block->next;
+    --list->count;
+    if (vlang_stats) vlang_count(vlang_class_size[c], c, 1);
+    return block;
+}
+
+void vlang_free(void* ptr, size_t size) {
+    if (ptr == NULL) return;
+    if (vlang_use_malloc || size > VLANG_ALLOC_MAX) {
+        if (vlang_stats) {
+            vlang_count(size, VLANG_CLASSES, 0);
+            if (!vlang_use_malloc)
+                __atomic_sub_fetch(&vlang_alloc_stats.reserved, size, __ATOMIC_RELAXED);
+        }
+        free(ptr);
+        return;
+    }
+    unsigned c = vlang_size_class(size);
+    if (vlang_stats) vlang_count(vlang_class_size[c], c, 0);
+    vlang_free_list* list = &vlang_cache[c];
+    if (list->head == NULL)
+        vlang_cache_register();
+    vlang_block* block = ptr;
+    block->next = list->head;
+    list->head = block;
+    if (++list->count >= 2 * vlang_class_batch[c])
+        vlang_release_batch(c);
+}
+
+size_t vlang_alloc_size(size_t size) {
+    if (vlang_use_malloc || size > VLANG_ALLOC_MAX)
+        return size;
+    return vlang_class_size[vlang_size_class(size)];
+}
+
+static void vlang_alloc_report(void) {
+    double kib = 1024.0;
+    fprintf(stderr, "vlang alloc: %llu allocations, %llu frees, %llu still in use\n",
+            (unsigned long long)vlang_alloc_stats.allocations,
+            (unsigned long long)vlang_alloc_stats.frees,
+            (unsigned long long)(vlang_alloc_stats.allocations - vlang_alloc_stats.frees));
+    fprintf(stderr, "vlang alloc: peak %.1f KiB in use, %.1f KiB in use at exit",
+            vlang_alloc_stats.peak / kib, vlang_alloc_stats.in_use / kib);
+    if (vlang_use_malloc)
+        fprintf(stderr, " (malloc)\n");
+    else
+        fprintf(stderr, ", %.1f KiB reserved\n", vlang_alloc_stats.reserved / kib);
+    for (unsigned c = 0; c < VLANG_CLASSES; ++c)
+        if (vlang_alloc_stats.per_class[c] != 0)
+            fprintf(stderr, "vlang alloc: %6u B  %10llu\n", vlang_class_size[c],
+                    (unsigned long long)vlang_alloc_stats.per_class[c]);
+    if (vlang_alloc_stats.large != 0)
+        fprintf(stderr, "vlang alloc: %8s  %10llu\n", vlang_use_malloc ? "malloc" : "large",
+                (unsigned long long)vlang_alloc_stats.large);
+}
+
+static int vlang_env_flag(const char* name) {
+    const char* value = getenv(name);
+    return value != NULL && value[0] != '\0' && strcmp(value, "0") != 0;
+}
+
+/* Runs before any static constructor of the program could allocate */
+__attribute__((constructor(101))) static void vlang_alloc_init(void) {
+    unsigned c = 3;
+    for (unsigned i = 1; i < sizeof(vlang_class_of); ++i) {
+        while (vlang_class_size[c] < i * 64)
+            ++c;
+        vlang_class_of[i] = (uint8_t)c;
+    }
+    for (c = 0; c < VLANG_CLASSES; ++c) {
+        uint32_t batch = VLANG_BATCH_BYTES / vlang_class_size[c];
+        vlang_class_batch[c] = batch < VLANG_BATCH_MIN ? VLANG_BATCH_MIN
+                             : batch > VLANG_BATCH_MAX ? VLANG_BATCH_MAX : batch;
+    }
+    pthread_key_create(&vlang_cache_key, vlang_cache_flush);
+
+#ifdef VLANG_USE_MALLOC
+    vlang_use_malloc = 1;
+#else
+    vlang_use_malloc = vlang_env_flag("VLANG_MALLOC");
+#endif
+    vlang_stats = vlang_env_flag("VLANG_ALLOC_STATS");
+    if (vlang_stats)
+        atexit(vlang_alloc_report);
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "vlang.h"
+
+/* Array layout (must match GetArrayStructType() in LLVMCodegen.cpp):
+ *     { int64_t length, int64_t refcount, T data[] }
+ * Buffers are 64 byte aligned, so data is 16 byte aligned. New arrays have a single
+ * reference, compiled code frees them with vlang_array_free() once the count drops to 0
+ * (through the destroy helper of the array type which knows the element size). */
+#define VLANG_ARRAY_ALIGNMENT 64
+#define VLANG_ARRAY_HEADER 16
+
+static size_t vlang_array_size(int64_t length, int64_t elem_size) {
+    size_t size = VLANG_ARRAY_HEADER + (size_t)length * (size_t)elem_size;
+    return (size + VLANG_ARRAY_ALIGNMENT - 1) & ~(size_t)(VLANG_ARRAY_ALIGNMENT - 1);
+}
+
+void* vlang_array_new(int64_t length, int64_t elem_size) {
+    if (length < 0) {
+        fprintf(stderr, "vlang: negative array length %lld\n", (long long)length);
+        abort();
+    }
+    size_t size = vlang_array_size(length, elem_size);
+    int64_t* arr = vlang_alloc(size);
+    memset(arr, 0, size);
+    arr[0] = length;
+    arr[1] = 1;
+    return arr;
+}
+
+void vlang_array_free(void* arr, int64_t elem_size) {
+    vlang_free(arr, vlang_array_size(((int64_t*)arr)[0], elem_size));
+}
+
+void vlang_array_bounds_fail(int64_t index, int64_t length) {
+    fprintf(stderr, "vlang: array index %lld out of bounds (length %lld)\n",
+            (long long)index, (long long)length);
+    abort();
+}
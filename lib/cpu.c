@@ -0,0 +1,33 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+/* CPU feature levels [Multiversion] functions are dispatched on, see CreateMultiversion()
+ * in LLVMCodegen.cpp: 0 is the baseline, 1 is x86-64-v3 (AVX2, FMA, BMI2), 2 is x86-64-v4
+ * (AVX-512 F/BW/DQ/VL). VLANG_CPU_LEVEL=n lowers the level, so every version can be tested
+ * on one machine. */
+
+static int32_t vlang_detect_cpu_level(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma") || !__builtin_cpu_supports("bmi2"))
+        return 0;
+    if (!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512bw") ||
+        !__builtin_cpu_supports("avx512dq") || !__builtin_cpu_supports("avx512vl"))
+        return 1;
+    return 2;
+#else
+    return 0;
+#endif
+}
+
+/* Called by module constructors (once per multiversioned function), so it's cached. */
+int32_t vlang_cpu_level(void) {
+    static int32_t level = -1;
+    if (level < 0) {
+        level = vlang_detect_cpu_level();
+        const char* forced = getenv("VLANG_CPU_LEVEL");
+        if (forced != NULL && atoi(forced) < level)
+            level = atoi(forced) < 0 ? 0 : atoi(forced);
+    }
+    return level;
+}
@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Function instrumentation of programs compiled with --instrument, see Profile.hpp. Every
+ * function registers its { calls, cycles } counters from a module constructor. At exit the
+ * hottest functions are reported on stderr (VLANG_INSTRUMENT_TOP of them, 20 by default),
+ * or all of them are written into VLANG_INSTRUMENT_FILE as tab separated values. */
+
+#define INSTRUMENT_CALLS 1
+#define INSTRUMENT_TIME 2
+
+typedef struct {
+    const char* name;
+    uint64_t* counters;
+} instrument_entry;
+
+static instrument_entry* instrument_entries = NULL;
+static size_t instrument_count = 0, instrument_capacity = 0;
+static int instrument_flags = 0;
+
+/* Cycle counter and wall clock at startup, they give the frequency of the cycle counter. */
+static uint64_t start_cycles;
+static double start_seconds;
+
+static uint64_t read_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static double read_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Hottest first: by time if it's measured, otherwise by calls. */
+static int instrument_compare(const void* a, const void* b) {
+    int column = (instrument_flags & INSTRUMENT_TIME) ? 1 : 0;
+    uint64_t x = ((const instrument_entry*)a)->counters[column];
+    uint64_t y = ((const instrument_entry*)b)->counters[column];
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void instrument_report(void) {
+    double seconds = read_seconds() - start_seconds;
+    uint64_t cycles = read_cycles() - start_cycles;
+    double ms_per_cycle = cycles > 0 ? seconds * 1e3 / cycles : 0;
+    qsort(instrument_entries, instrument_count, sizeof(instrument_entry), instrument_compare);
+
+    const char* path = getenv("VLANG_INSTRUMENT_FILE");
+    if (path != NULL && *path != '\0') {
+        FILE* out = fopen(path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "vlang: can't write %s\n", path);
+            return;
+        }
+        fprintf(out, "function\tcalls\tcycles\tms\n");
+        for (size_t i = 0; i < instrument_count; ++i) {
+            const instrument_entry* e = &instrument_entries[i];
+            fprintf(out, "%s\t%llu\t%llu\t%.3f\n", e->name, (unsigned long long)e->counters[0],
+                    (unsigned long long)e->counters[1], e->counters[1] * ms_per_cycle);
+        }
+        fclose(out);
+        return;
+    }
+
+    const char* top = getenv("VLANG_INSTRUMENT_TOP");
+    size_t shown = top != NULL ? (size_t)atol(top) : 20;
+    if (shown > instrument_count)
+        shown = instrument_count;
+    fprintf(stderr, "vlang: %zu of %zu functions, %.3f ms in total (time is inclusive)\n",
+            shown, instrument_count, seconds * 1e3);
+    fprintf(stderr, "%14s %12s %8s  %s\n", "calls", "ms", "%", "function");
+    for (size_t i = 0; i < shown; ++i) {
+        const instrument_entry* e = &instrument_entries[i];
+        double ms = e->counters[1] * ms_per_cycle;
+        fprintf(stderr, "%14llu %12.3f %8.2f  %s\n", (unsigned long long)e->counters[0], ms,
+                seconds > 0 ? ms / (seconds * 10) : 0, e->name);
+    }
+}
+
+void vlang_instrument_register(const char* name, uint64_t* counters, int32_t flags) {
+    if (instrument_count == instrument_capacity) {
+        size_t capacity = instrument_capacity ? 2 * instrument_capacity : 64;
+        instrument_entry* entries = realloc(instrument_entries, capacity * sizeof(instrument_entry));
+        if (entries == NULL)
+            return;
+        instrument_entries = entries;
+        instrument_capacity = capacity;
+    }
+    if (instrument_count == 0) {
+        start_cycles = read_cycles();
+        start_seconds = read_seconds();
+        atexit(instrument_report);
+    }
+    instrument_entries[instrument_count].name = name;
+    instrument_entries[instrument_count].counters = counters;
+    ++instrument_count;
+    instrument_flags |= flags;
+}
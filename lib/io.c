@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <unistd.h>
+#include "vlang.h"
 
 void print_int(int t) {
     printf("%d\n", t);
@@ -6,8 +8,9 @@ void print_int(int t) {
 void print_double(double t) {
     printf("%g\n", t);
 }
-void print_str(char* str) {
-    printf("%s\n", str);
+void print_str(vlang_string str) {
+    fwrite(vlang_string_data(&str), 1, (size_t)vlang_string_length(&str), stdout);
+    putchar('\n');
 }
 int read_int() {
     int t;
@@ -19,3 +22,35 @@ double read_double() {
     scanf("%lf", &t);
     return t;
 }
+
+/* Specialized stdout.printf() pieces. The compiler parses literal formats, so
+ * nothing is parsed at runtime: each call writes one segment into the (buffered)
+ * stdout, which is flushed at exit. */
+#define VLANG_OUT_BUFFER (1 << 16)
+
+__attribute__((constructor)) static void vlang_out_init(void) {
+    /* Terminals stay line buffered */
+    if (!isatty(fileno(stdout)))
+        setvbuf(stdout, NULL, _IOFBF, VLANG_OUT_BUFFER);
+}
+
+void vlang_out_write(const char* data, int64_t length) {
+    fwrite(data, 1, (size_t)length, stdout);
+}
+void vlang_out_str(vlang_string str) {
+    fwrite(vlang_string_data(&str), 1, (size_t)vlang_string_length(&str), stdout);
+}
+void vlang_out_int(int64_t value) {
+    char buf[24];
+    char* end = vlang_concat_int(buf, value);
+    fwrite(buf, 1, (size_t)(end - buf), stdout);
+}
+void vlang_out_uint(uint64_t value) {
+    char buf[24];
+    char* end = vlang_concat_uint(buf, value);
+    fwrite(buf, 1, (size_t)(end - buf), stdout);
+}
+void vlang_out_double(double value, char conversion) {
+    char format[] = { '%', conversion, '\0' };
+    printf(format, value);
+}
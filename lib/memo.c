@@ -0,0 +1,105 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Caches of [Memoize] functions, see CreateMemoize() in LLVMCodegen.cpp. The wrapper of a
+ * memoized function packs its arguments into arity words (the key) and looks them up before
+ * calling the original body.
+ *
+ * A cache is an open-addressed table of capacity (a power of two) entries, each one is
+ * arity + 2 words: tag, key, value. The tag is the hash of the key with the lowest bit set,
+ * 0 marks an empty entry. A key is searched in MEMO_PROBES consecutive entries; if all of them
+ * are taken by other keys, the new one evicts the entry picked by the high bits of its hash.
+ * The table is allocated on the first insertion.
+ *
+ * Lookups and insertions made from bodies of [Parallel] loops (see lib/parallel.c) take a lock
+ * shared by all caches, the rest of the program doesn't pay for it. Two threads missing the same
+ * key both compute the value, the second insertion overwrites the first. */
+
+/* Must match the global created by CreateMemoize(): { i64* entries, i32 capacity, i32 arity } */
+typedef struct {
+    uint64_t* entries;
+    uint32_t capacity;
+    uint32_t arity;
+} vlang_memo;
+
+#define MEMO_PROBES 4
+
+static pthread_mutex_t memo_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int vlang_parallel_in_loop(void);
+
+static uint64_t memo_hash(const int64_t* key, uint32_t arity) {
+    uint64_t h = 0x9e3779b97f4a7c15ull;
+    for (uint32_t i = 0; i < arity; ++i) {
+        h ^= (uint64_t)key[i];
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+    }
+    return h | 1;
+}
+
+static uint64_t* memo_entry(const vlang_memo* memo, uint64_t index) {
+    return memo->entries + (index & (memo->capacity - 1)) * (memo->arity + 2);
+}
+
+static int32_t memo_find(const vlang_memo* memo, const int64_t* key, int64_t* value) {
+    if (memo->entries == NULL)
+        return 0;
+    uint64_t tag = memo_hash(key, memo->arity);
+    for (uint64_t i = 0; i < MEMO_PROBES; ++i) {
+        uint64_t* entry = memo_entry(memo, tag + i);
+        if (entry[0] == 0)
+            return 0;
+        if (entry[0] == tag && memcmp(entry + 1, key, memo->arity * sizeof(int64_t)) == 0) {
+            *value = (int64_t)entry[memo->arity + 1];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns 1 and sets *value if key is cached, 0 otherwise. */
+int32_t vlang_memo_find(const vlang_memo* memo, const int64_t* key, int64_t* value) {
+    if (! vlang_parallel_in_loop())
+        return memo_find(memo, key, value);
+    pthread_mutex_lock(&memo_lock);
+    int32_t found = memo_find(memo, key, value);
+    pthread_mutex_unlock(&memo_lock);
+    return found;
+}
+
+static void memo_insert(vlang_memo* memo, const int64_t* key, int64_t value) {
+    if (memo->entries == NULL) {
+        memo->entries = calloc((size_t)memo->capacity * (memo->arity + 2), sizeof(uint64_t));
+        if (memo->entries == NULL) {
+            fprintf(stderr, "vlang: out of memory\n");
+            abort();
+        }
+    }
+    uint64_t tag = memo_hash(key, memo->arity);
+    uint64_t* entry = memo_entry(memo, tag + (tag >> 62));
+    for (uint64_t i = 0; i < MEMO_PROBES; ++i) {
+        uint64_t* candidate = memo_entry(memo, tag + i);
+        if (candidate[0] == 0 || candidate[0] == tag) {
+            entry = candidate;
+            break;
+        }
+    }
+    entry[0] = tag;
+    memcpy(entry + 1, key, memo->arity * sizeof(int64_t));
+    entry[memo->arity + 1] = (uint64_t)value;
+}
+
+/* Caches value of given key. */
+void vlang_memo_insert(vlang_memo* memo, const int64_t* key, int64_t value) {
+    if (! vlang_parallel_in_loop()) {
+        memo_insert(memo, key, value);
+        return;
+    }
+    pthread_mutex_lock(&memo_lock);
+    memo_insert(memo, key, value);
+    pthread_mutex_unlock(&memo_lock);
+}
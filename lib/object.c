@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "vlang.h"
+
+/* Object layout (must match ClassAST::llvm_type() in Statement.cpp):
+ *     { int64_t header, fields... }
+ * Header is the reference count, new objects have a single reference. Objects are zeroed,
+ * so fields without a default value start as 0, null or "". */
+void* vlang_object_new(int64_t size) {
+    int64_t* obj = vlang_alloc((size_t)size);
+    memset(obj, 0, (size_t)size);
+    obj[0] = 1;
+    return obj;
+}
+
+/* Called by the destroy function of a class once its managed fields are released, size is
+ * the size of the class. */
+void vlang_object_free(void* obj, int64_t size) {
+    vlang_free(obj, (size_t)size);
+}
@@ -0,0 +1,218 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Runtime of [Parallel] loops, see ForStmtAST::codegenParallel(). The body of a loop is
+ * outlined into a function running iterations [begin, end) of it, vlang_parallel_for()
+ * calls it on chunks of the iteration space from a pool of threads.
+ *
+ * The pool has VLANG_THREADS threads (online CPUs by default), the calling thread included.
+ * Workers are started by the first loop and sleep between loops.
+ *
+ * Work stealing: the iteration space is split evenly into one range per thread. A thread
+ * runs chunks from the front of its own range; once the range is empty, it steals the back
+ * half of the range of another thread (victims are tried from a random one). The loop ends
+ * when no thread finds anything to steal.
+ *
+ * Adaptive chunking: a chunk is a quarter of what is left in the range, but at least the
+ * grain (1/64 of an even share). Chunks start large, so the body is called only a few times,
+ * and shrink towards the end of a range, where they balance the load. Reductions combine
+ * their partial results once per chunk, under vlang_parallel_lock().
+ *
+ * Loops started inside a loop body (or while another thread runs a loop) run serially.
+ * Runtime parts which aren't thread-safe on their own (lib/memo.c) ask vlang_parallel_in_loop()
+ * whether they have to synchronize. */
+
+#define PARALLEL_MAX_THREADS 256
+#define PARALLEL_CHUNK_DIVISOR 4
+#define PARALLEL_GRAINS_PER_THREAD 64
+
+typedef void (*vlang_loop_body)(void* env, int64_t begin, int64_t end);
+
+/* Iterations [next, end) not started yet, a line each so threads don't share them */
+typedef struct {
+    pthread_mutex_t lock;
+    int64_t next;
+    int64_t end;
+} __attribute__((aligned(64))) parallel_range;
+
+static parallel_range parallel_ranges[PARALLEL_MAX_THREADS];
+static int parallel_threads;
+static pthread_once_t parallel_once = PTHREAD_ONCE_INIT;
+
+/* Current loop, published to workers by bumping the generation */
+static pthread_mutex_t parallel_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t parallel_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t parallel_done = PTHREAD_COND_INITIALIZER;
+static uint64_t parallel_generation;
+static int parallel_running;
+static int parallel_busy;
+static vlang_loop_body parallel_body;
+static void* parallel_env;
+static int64_t parallel_grain;
+
+static pthread_mutex_t parallel_reduce_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int parallel_in_loop;
+
+/* Takes the next chunk of own range, returns 0 if the range is empty. */
+static int parallel_take(int self, int64_t* begin, int64_t* end) {
+    parallel_range* range = &parallel_ranges[self];
+    pthread_mutex_lock(&range->lock);
+    int64_t left = range->end - range->next;
+    if (left > 0) {
+        int64_t chunk = left / PARALLEL_CHUNK_DIVISOR;
+        if (chunk < parallel_grain)
+            chunk = parallel_grain;
+        if (chunk > left)
+            chunk = left;
+        *begin = range->next;
+        *end = range->next + chunk;
+        range->next += chunk;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return left > 0;
+}
+
+/* Moves the back half of a victim's range into own (empty) range, returns 0 if every
+ * range is down to a single chunk. */
+static int parallel_steal(int self, unsigned* seed) {
+    int first = rand_r(seed) % parallel_threads;
+    for (int i = 0; i < parallel_threads; ++i) {
+        int victim = (first + i) % parallel_threads;
+        if (victim == self)
+            continue;
+        parallel_range* range = &parallel_ranges[victim];
+        pthread_mutex_lock(&range->lock);
+        int64_t left = range->end - range->next;
+        if (left > parallel_grain) {
+            int64_t middle = range->next + left / 2;
+            int64_t end = range->end;
+            range->end = middle;
+            pthread_mutex_unlock(&range->lock);
+
+            parallel_range* own = &parallel_ranges[self];
+            pthread_mutex_lock(&own->lock);
+            own->next = middle;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&range->lock);
+    }
+    return 0;
+}
+
+static void parallel_work(int self) {
+    unsigned seed = 2654435761u * (unsigned)(self + 1);
+    int64_t begin, end;
+    parallel_in_loop = 1;
+    do {
+        while (parallel_take(self, &begin, &end))
+            parallel_body(parallel_env, begin, end);
+    } while (parallel_steal(self, &seed));
+    parallel_in_loop = 0;
+}
+
+static void* parallel_worker(void* arg) {
+    int self = (int)(intptr_t)arg;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&parallel_pool_lock);
+    for (;;) {
+        while (parallel_generation == seen)
+            pthread_cond_wait(&parallel_start, &parallel_pool_lock);
+        seen = parallel_generation;
+        pthread_mutex_unlock(&parallel_pool_lock);
+
+        parallel_work(self);
+
+        pthread_mutex_lock(&parallel_pool_lock);
+        if (--parallel_running == 0)
+            pthread_cond_signal(&parallel_done);
+    }
+    return NULL;
+}
+
+static void parallel_start_pool(void) {
+    const char* env = getenv("VLANG_THREADS");
+    long threads = env != NULL ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1)
+        threads = 1;
+    if (threads > PARALLEL_MAX_THREADS)
+        threads = PARALLEL_MAX_THREADS;
+
+    parallel_threads = 1;
+    pthread_mutex_init(&parallel_ranges[0].lock, NULL);
+    for (int i = 1; i < threads; ++i) {
+        pthread_mutex_init(&parallel_ranges[i].lock, NULL);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, parallel_worker, (void*)(intptr_t)i) != 0) {
+            fprintf(stderr, "vlang: can't start more than %d threads for parallel loops\n", i);
+            break;
+        }
+        pthread_detach(thread);
+        ++parallel_threads;
+    }
+}
+
+/* Runs body on all iterations of [begin, end) and returns once all of them are done. */
+void vlang_parallel_for(int64_t begin, int64_t end, vlang_loop_body body, void* env) {
+    if (end <= begin)
+        return;
+    pthread_once(&parallel_once, parallel_start_pool);
+    int64_t count = end - begin;
+    if (parallel_in_loop || parallel_threads == 1 || count == 1) {
+        body(env, begin, end);
+        return;
+    }
+
+    pthread_mutex_lock(&parallel_pool_lock);
+    if (parallel_busy) {
+        pthread_mutex_unlock(&parallel_pool_lock);
+        parallel_in_loop = 1;
+        body(env, begin, end);
+        parallel_in_loop = 0;
+        return;
+    }
+    parallel_busy = 1;
+    int threads = parallel_threads;
+    int64_t share = count / threads, rest = count % threads;
+    int64_t next = begin;
+    for (int i = 0; i < threads; ++i) {
+        parallel_ranges[i].next = next;
+        next += share + (i < rest);
+        parallel_ranges[i].end = next;
+    }
+    parallel_grain = share / PARALLEL_GRAINS_PER_THREAD;
+    if (parallel_grain < 1)
+        parallel_grain = 1;
+    parallel_body = body;
+    parallel_env = env;
+    parallel_running = threads - 1;
+    ++parallel_generation;
+    pthread_cond_broadcast(&parallel_start);
+    pthread_mutex_unlock(&parallel_pool_lock);
+
+    parallel_work(0);
+
+    pthread_mutex_lock(&parallel_pool_lock);
+    while (parallel_running > 0)
+        pthread_cond_wait(&parallel_done, &parallel_pool_lock);
+    parallel_busy = 0;
+    pthread_mutex_unlock(&parallel_pool_lock);
+}
+
+/* Returns 1 if the calling thread runs a body of a [Parallel] loop (other threads may run it too). */
+int vlang_parallel_in_loop(void) {
+    return parallel_in_loop;
+}
+
+/* Chunks of a loop with reductions add their partial results to the variables in between. */
+void vlang_parallel_lock(void) {
+    pthread_mutex_lock(&parallel_reduce_lock);
+}
+
+void vlang_parallel_unlock(void) {
+    pthread_mutex_unlock(&parallel_reduce_lock);
+}
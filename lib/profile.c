@@ -0,0 +1,91 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Profiles of programs compiled with --profile-generate, see Profile.hpp. Every function
+ * registers its counters (entries, then true/false counts of its branch sites) from a module
+ * constructor. At exit they are added to the counts of previous runs in the profile file,
+ * VLANG_PROFILE_FILE overrides the file given at compile time. */
+
+typedef struct profile_entry {
+    const char* name;
+    uint64_t* counters;
+    int64_t count;
+    struct profile_entry* next;
+} profile_entry;
+
+static profile_entry* profile_entries = NULL;
+static const char* profile_path = NULL;
+
+static profile_entry* profile_find(const char* name, int64_t count) {
+    for (profile_entry* e = profile_entries; e != NULL; e = e->next)
+        if (e->count == count && strcmp(e->name, name) == 0)
+            return e;
+    return NULL;
+}
+
+#define PROFILE_HEADER "# vlang profile\n"
+
+/* Adds counts of a previous profile, functions which changed since are dropped. */
+static void profile_merge(FILE* in, const char* path) {
+    char name[4096];
+    long long count;
+    if (fgets(name, sizeof(name), in) == NULL)
+        return;
+    if (strcmp(name, PROFILE_HEADER) != 0) {
+        fprintf(stderr, "vlang: %s isn't a vlang profile, it is overwritten without merging\n", path);
+        return;
+    }
+    while (fscanf(in, "%4095s %lld", name, &count) == 2) {
+        profile_entry* e = profile_find(name, count);
+        for (long long i = 0; i < count; ++i) {
+            unsigned long long c;
+            if (fscanf(in, "%llu", &c) != 1)
+                return;
+            if (e != NULL)
+                e->counters[i] += c;
+        }
+    }
+}
+
+static void profile_write(void) {
+    const char* path = getenv("VLANG_PROFILE_FILE");
+    if (path == NULL || *path == '\0')
+        path = profile_path;
+
+    FILE* in = fopen(path, "r");
+    if (in != NULL) {
+        profile_merge(in, path);
+        fclose(in);
+    }
+
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "vlang: can't write profile %s\n", path);
+        return;
+    }
+    fprintf(out, PROFILE_HEADER);
+    for (profile_entry* e = profile_entries; e != NULL; e = e->next) {
+        fprintf(out, "%s %lld", e->name, (long long)e->count);
+        for (int64_t i = 0; i < e->count; ++i)
+            fprintf(out, " %llu", (unsigned long long)e->counters[i]);
+        fprintf(out, "\n");
+    }
+    fclose(out);
+}
+
+void vlang_profile_register(const char* name, uint64_t* counters, int64_t count, const char* path) {
+    profile_entry* e = malloc(sizeof(profile_entry));
+    if (e == NULL)
+        return;
+    e->name = name;
+    e->counters = counters;
+    e->count = count;
+    e->next = profile_entries;
+    if (profile_entries == NULL) {
+        profile_path = path;
+        atexit(profile_write);
+    }
+    profile_entries = e;
+}
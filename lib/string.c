@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "vlang.h"
+
+/* Heap strings: reference count is stored in front of the data, the compiler updates
+ * it inline and calls vlang_string_free() once it drops to 0. Buffers are allocated for
+ * exactly the length of the string, so the length is all vlang_free() needs. */
+static size_t vlang_string_block_size(int64_t capacity) {
+    /* One extra byte for the terminator written by snprintf() */
+    return sizeof(int64_t) + (size_t)capacity + 1;
+}
+
+static char* vlang_string_alloc(int64_t capacity) {
+    int64_t* block = vlang_alloc(vlang_string_block_size(capacity));
+    block[0] = 1;
+    return (char*)(block + 1);
+}
+
+void vlang_string_free(char* data, int64_t length) {
+    vlang_free(data - sizeof(int64_t), vlang_string_block_size(length));
+}
+
+/* Substring. Follows Vala semantics: negative offset counts from the end, negative length
+ * means "until the end". Slices of inline strings stay inline and slices of literals are
+ * zero-copy, long slices of heap strings get their own buffer (slices can't keep the
+ * original buffer alive). */
+vlang_string vlang_string_substring(vlang_string s, int64_t offset, int64_t length) {
+    int64_t size = vlang_string_length(&s);
+    if (offset < 0) offset += size;
+    if (offset < 0) offset = 0;
+    if (offset > size) offset = size;
+    if (length < 0 || offset + length > size) length = size - offset;
+
+    const char* data = vlang_string_data(&s) + offset;
+    if (vlang_string_is_inline(&s) || length <= VLANG_STRING_INLINE_MAX)
+        return vlang_string_make(data, length);
+    if (vlang_string_is_heap(&s)) {
+        char* copy = vlang_string_alloc(length);
+        memcpy(copy, data, (size_t)length);
+        vlang_string res = { copy, length | VLANG_STRING_HEAP };
+        return res;
+    }
+    vlang_string res = { data, length };
+    return res;
+}
+
+/* Lexicographic comparison, returns <0, 0 or >0. */
+int32_t vlang_string_compare(vlang_string a, vlang_string b) {
+    int64_t la = vlang_string_length(&a), lb = vlang_string_length(&b);
+    int cmp = memcmp(vlang_string_data(&a), vlang_string_data(&b), (size_t)(la < lb ? la : lb));
+    if (cmp != 0) return cmp;
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+/* Concatenation. The compiler sums up lengths of all parts of a + chain, calls
+ * vlang_concat_begin() once and then writes each part straight into the buffer with
+ * vlang_concat_*() which return the position after the written part. Number formatters
+ * never allocate, results of up to 15 bytes are built in scratch space and stored inline. */
+static __thread char vlang_concat_scratch[VLANG_STRING_INLINE_MAX + 1];
+
+char* vlang_concat_begin(int64_t capacity) {
+    if (capacity <= VLANG_STRING_INLINE_MAX)
+        return vlang_concat_scratch;
+    return vlang_string_alloc(capacity);
+}
+
+char* vlang_concat_str(char* dst, vlang_string s) {
+    int64_t length = vlang_string_length(&s);
+    memcpy(dst, vlang_string_data(&s), (size_t)length);
+    return dst + length;
+}
+
+/* Number of characters needed to write given integer. */
+int64_t vlang_uint_string_length(uint64_t value) {
+    int64_t length = 1;
+    while (value >= 10) {
+        value /= 10;
+        ++length;
+    }
+    return length;
+}
+
+int64_t vlang_int_string_length(int64_t value) {
+    uint64_t u = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    return vlang_uint_string_length(u) + (value < 0 ? 1 : 0);
+}
+
+char* vlang_concat_uint(char* dst, uint64_t value) {
+    char* end = dst + vlang_uint_string_length(value);
+    char* p = end;
+    do {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
+
+char* vlang_concat_int(char* dst, int64_t value) {
+    if (value < 0) *dst++ = '-';
+    return vlang_concat_uint(dst, value < 0 ? -(uint64_t)value : (uint64_t)value);
+}
+
+/* Same format as print_double(), at most 13 characters. */
+char* vlang_concat_double(char* dst, double value) {
+    return dst + snprintf(dst, 14, "%g", value);
+}
+
+/* Numbers may take less than reserved for them, a buffer which ended up in a smaller size
+ * class is moved, so it can be freed knowing just the length. */
+vlang_string vlang_concat_end(char* begin, char* end, int64_t capacity) {
+    int64_t length = end - begin;
+    if (begin == vlang_concat_scratch)
+        return vlang_string_make(begin, length);
+    if (length <= VLANG_STRING_INLINE_MAX) {
+        vlang_string res = vlang_string_make(begin, length);
+        vlang_string_free(begin, capacity);
+        return res;
+    }
+    if (vlang_alloc_size(vlang_string_block_size(length)) != vlang_alloc_size(vlang_string_block_size(capacity))) {
+        char* moved = vlang_string_alloc(length);
+        memcpy(moved, begin, (size_t)length);
+        vlang_string_free(begin, capacity);
+        begin = moved;
+    }
+    vlang_string res = { begin, length | VLANG_STRING_HEAP };
+    return res;
+}
@@ -0,0 +1,68 @@
+#ifndef VLANG_RUNTIME_H
+#define VLANG_RUNTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Size-class allocator (lib/alloc.c). Blocks are freed with the size they were allocated
+ * with, blocks of 64 bytes and more are 64 byte aligned. */
+void* vlang_alloc(size_t size);
+void vlang_free(void* ptr, size_t size);
+
+/* Number of bytes actually reserved for a block of given size. */
+size_t vlang_alloc_size(size_t size);
+
+/* String value, must match GetStringStructType() in LLVMCodegen.cpp.
+ *
+ * Long strings (and all literals) point to their data: { data, length }.
+ * Strings of up to 15 bytes built at runtime are stored inline in the value itself:
+ * bytes 0..14 hold the characters and the last byte is 0x80 | length, so the sign
+ * bit of length tells the two representations apart.
+ *
+ * Long strings built at runtime own a heap buffer whose reference count is stored in
+ * the 8 bytes in front of data, they are marked with VLANG_STRING_HEAP bit of length. */
+typedef struct {
+    const char* data;
+    int64_t length;
+} vlang_string;
+
+#define VLANG_STRING_INLINE_MAX 15
+#define VLANG_STRING_HEAP ((int64_t)1 << 62)
+
+static inline int vlang_string_is_inline(const vlang_string* s) {
+    return s->length < 0;
+}
+
+static inline int vlang_string_is_heap(const vlang_string* s) {
+    return (s->length & VLANG_STRING_HEAP) != 0;
+}
+
+static inline int64_t vlang_string_length(const vlang_string* s) {
+    return vlang_string_is_inline(s) ? (int64_t)(((const unsigned char*)s)[15] & 0x7f)
+                                     : s->length & ~VLANG_STRING_HEAP;
+}
+
+static inline const char* vlang_string_data(const vlang_string* s) {
+    return vlang_string_is_inline(s) ? (const char*)s : s->data;
+}
+
+/* Creates a string from given bytes, inline if short enough, otherwise points to data. */
+static inline vlang_string vlang_string_make(const char* data, int64_t length) {
+    vlang_string res;
+    if (length <= VLANG_STRING_INLINE_MAX) {
+        memset(&res, 0, sizeof(res));
+        memcpy(&res, data, (size_t)length);
+        ((unsigned char*)&res)[15] = (unsigned char)(0x80 | length);
+    } else {
+        res.data = data;
+        res.length = length;
+    }
+    return res;
+}
+
+/* Writes given integer at dst, returns the position after it (lib/string.c). */
+char* vlang_concat_int(char* dst, int64_t value);
+char* vlang_concat_uint(char* dst, uint64_t value);
+
+#endif /* VLANG_RUNTIME_H */
@@ -0,0 +1,21 @@
+// Tests for loops (canonical loop form with llvm.loop metadata).
+void print_int(int x);
+
+int sum_to(int n) {
+    int sum = 0;
+    for (int i = 0; i < n; ++i)
+        sum = sum + i;
+    return sum;
+}
+
+int main() {
+    int total = 0;
+    for (int i = 10; i > 0; i--) {
+        total = total + sum_to(i);
+    }
+    for (;;) {
+        print_int(total);
+        return 0;
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+// Tests arrays (allocation, initializer lists, indexing, length).
+void print_int(int x);
+void print_double(double x);
+
+int sum(int[] a) {
+    int s = 0;
+    // Bounds checks are removed: i is in [0, a.length)
+    for (int i = 0; i < a.length; ++i)
+        s = s + a[i];
+    return s;
+}
+
+int main() {
+    int[] a = {1, 2, 3, 4, 5};
+    double[] b = new double[10];
+    for (int i = 0; i < 10; ++i)
+        b[i] = i * 0.5;
+    // Constant index into array of known length, no bounds check
+    print_int(a[4]);
+    print_int(sum(a));
+    print_double(b[9]);
+    // Checked access, aborts at runtime
+    print_int(a[b.length]);
+    return 0;
+}
@@ -0,0 +1,20 @@
+// Tests strings (pooled literals, escapes, length, substrings, comparison).
+void print_int(int x);
+void print_str(string s);
+
+int main() {
+    string greeting = "Hello, \"world\"";
+    string same = "Hello, \"world\"";
+    // Substrings do not copy, short ones are stored inline
+    string world = greeting.substring(8, 5);
+    print_str(greeting);
+    print_str(world);
+    print_str(greeting.substring(-7));
+    print_int(greeting.length);
+    print_int(world.length);
+    if (greeting == same)
+        print_str("equal\tliterals");
+    if (world < greeting)
+        print_str("ordered");
+    return 0;
+}
@@ -0,0 +1,15 @@
+// Tests string concatenation and to_string() of numbers.
+void print_str(string s);
+
+int main() {
+    int x = 3;
+    double y = -0.25;
+    // One allocation for the whole chain
+    string point = "(" + x.to_string() + ", " + y.to_string() + ")";
+    print_str(point);
+    string line = "";
+    for (int i = 0; i < 5; ++i)
+        line = line + i.to_string() + " ";
+    print_str(line + "and a long enough tail to be allocated");
+    return 0;
+}
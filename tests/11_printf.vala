@@ -0,0 +1,12 @@
+// Tests stdout.printf with formats specialized at compile time.
+int main() {
+    int[] a = {1, 2, 3};
+    double avg = 2.0;
+    string name = "a";
+    stdout.printf("Hello world!\n");
+    for (int i = 0; i < a.length; ++i)
+        stdout.printf("%d ", a[i]);
+    stdout.printf("\n%s: avg %f (%g), 100%%\n", name, avg, avg);
+    stdout.printf(name + " done\n");
+    return 0;
+}
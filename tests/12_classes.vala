@@ -0,0 +1,41 @@
+// Tests classes (fields, auto-properties, constructors, methods).
+class Point : GLib.Object {
+    public bool visible = true;
+    public int id;
+    public double x { get; set; default = 0.0; }
+    public double y { get; set; default = 0.0; }
+
+    public Point(double x, double y) {
+        this.x = x;
+        this.y = y;
+    }
+
+    public void move(double dx, double dy) {
+        x = x + dx;
+        y = y + dy;
+    }
+
+    public double dot(Point other) {
+        return x * other.x + y * other.y;
+    }
+
+    public string to_string() {
+        return "(" + x.to_string() + ", " + y.to_string() + ")";
+    }
+}
+
+int main() {
+    stdout.printf("Creating Point object...\n");
+    Point p = new Point(1.1, 2.2);
+    p.x = 1.0;
+    p.y = 2.0;
+    p.id = 7;
+    stdout.printf("%s\n", p.to_string());
+
+    // Property accesses and calls are direct, this loop has no calls left after inlining
+    Point q = new Point(0.0, 0.0);
+    for (int i = 0; i < 1000; ++i)
+        q.move(p.x, p.y);
+    stdout.printf("%s %f %d\n", q.to_string(), p.dot(q), p.id);
+    return 0;
+}
@@ -0,0 +1,42 @@
+// Tests escape analysis: objects which never leave their function live on the stack.
+class Vec : GLib.Object {
+    public double x;
+    public double y;
+
+    public Vec(double x, double y) {
+        this.x = x;
+        this.y = y;
+    }
+
+    public double length2() {
+        return x * x + y * y;
+    }
+
+    public Vec self() {
+        return this;
+    }
+}
+
+// Escapes through the return value, stays on the heap
+Vec make(double x, double y) {
+    Vec v = new Vec(x, y);
+    return v;
+}
+
+int main() {
+    // Temporary created in every iteration, only its fields and methods are used
+    double sum = 0.0;
+    for (int i = 0; i < 1000000; ++i) {
+        Vec v = new Vec(i, 1.0);
+        v.x = v.x * 0.5;
+        sum = sum + v.length2();
+    }
+    stdout.printf("%f\n", sum);
+
+    // self() lets 'this' escape, so w is heap allocated
+    Vec w = new Vec(3.0, 4.0);
+    Vec alias = w.self();
+    Vec m = make(1.0, 2.0);
+    stdout.printf("%f %f\n", alias.length2(), m.length2());
+    return 0;
+}
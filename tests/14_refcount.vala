@@ -0,0 +1,52 @@
+// Tests reference counting: every object, array and heap string below is freed
+// as soon as its last reference goes away.
+class Node : GLib.Object {
+    public string name;
+    public Node next;
+
+    public Node(string name) {
+        this.name = name;
+    }
+
+    public string describe() {
+        int count = name.length();
+        return name + " (" + count.to_string() + " characters)";
+    }
+
+    public int name_length() {
+        return name.length();
+    }
+}
+
+// Ownership of the local is transferred to the caller
+Node make(string prefix, int i) {
+    Node n = new Node(prefix + " number " + i.to_string());
+    return n;
+}
+
+// Parameters are borrowed, their counts aren't touched at all
+int total_length(Node first, Node second) {
+    return first.name_length() + second.name_length();
+}
+
+int main() {
+    int sum = 0;
+    for (int i = 0; i < 100000; ++i) {
+        Node a = make("a very long node name", i);
+        Node b = make("another long node name", i);
+        a.next = b;
+        b = a;
+        sum = sum + total_length(a, b);
+
+        // Temporary strings are released right after they are used
+        string d = a.describe();
+        string s = d.substring(2);
+        sum = sum + s.length();
+
+        int[] numbers = new int[16];
+        numbers[0] = i;
+        sum = sum + numbers.length;
+    }
+    stdout.printf("%d\n", sum);
+    return 0;
+}
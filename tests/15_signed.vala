@@ -0,0 +1,36 @@
+// Tests signed integer arithmetic and comparisons which produce bool values.
+void print_int(int x);
+
+bool is_negative(int x) {
+    return x < 0;
+}
+
+int main() {
+    int a = -7;
+    int b = 2;
+    // -3 and -1, division and remainder round towards zero
+    print_int(a / b);
+    print_int(a % b);
+
+    bool negative = is_negative(a);
+    if (negative)
+        print_int(1);
+    if (a < b)
+        print_int(2);
+
+    // Loop counting down through zero
+    int steps = 0;
+    for (int i = 5; i >= -5; --i)
+        steps = steps + 1;
+    print_int(steps);
+
+    double x = 0.5;
+    bool small = x < 1;
+    while (small) {
+        x = x * 2;
+        small = x < 1;
+    }
+    if (x >= 1.0)
+        print_int(3);
+    return 0;
+}
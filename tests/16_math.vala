@@ -0,0 +1,22 @@
+// Tests Math functions, they are lowered to LLVM intrinsics. Compile with
+// --fp-model=reassoc (or fast) to let the dot product vectorize.
+void print_double(double x);
+
+double norm(double[] v) {
+    double s = 0.0;
+    for (int i = 0; i < v.length; ++i)
+        s = s + v[i] * v[i];
+    return Math.sqrt(s);
+}
+
+int main() {
+    double[] v = new double[1000];
+    for (int i = 0; i < v.length; ++i)
+        v[i] = Math.sin(i) + Math.fabs(Math.floor(i / 3.0));
+
+    print_double(norm(v));
+    print_double(Math.pow(2, 10));
+    print_double(Math.fmax(Math.ceil(1.2), Math.round(2.5)));
+    print_double(Math.fma(2.0, 3.0, 1.0));
+    return 0;
+}
@@ -0,0 +1,41 @@
+// Tests sized and unsigned integer types, their promotions and explicit casts.
+int main() {
+    // Literals fit into narrow types without a cast
+    int8 small = 100;
+    uint8 byte = 200;
+    int16 medium = -30000;
+    uint ticks = 4000000000U;
+    int64 big = 3000000000;
+    uint64 huge = 18446744073709551615UL;
+
+    // int8 + int8 is computed in int (as in C), so there is no overflow
+    int sum = small + small;
+    stdout.printf("%d %u %d\n", sum, byte, medium);
+
+    // Unsigned types wrap around and are compared as unsigned
+    byte = (uint8) (byte + byte);
+    ticks = ticks + ticks;
+    stdout.printf("%u %u %u\n", byte, ticks, huge);
+    if (huge > 1)
+        stdout.printf("unsigned compare\n");
+
+    // Division and conversions follow signedness of the operand
+    stdout.printf("%d %u\n", big / -7, huge / 10);
+    double d = huge;
+    int8 truncated = (int8) 300;
+    uint16 fromDouble = (uint16) 65535.9;
+    stdout.printf("%g %d %u\n", d, truncated, fromDouble);
+
+    // Narrow arrays take a fraction of the memory
+    uint8[] pixels = new uint8[256];
+    for (int i = 0; i < pixels.length; ++i)
+        pixels[i] = (uint8) i;
+    uint total = 0;
+    for (int i = 0; i < pixels.length; ++i)
+        total = total + pixels[i];
+    stdout.printf("%u\n", total);
+
+    string s = "big=" + big.to_string() + " huge=" + huge.to_string();
+    stdout.printf("%s\n", s);
+    return 0;
+}
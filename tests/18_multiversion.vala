@@ -0,0 +1,28 @@
+// Tests [Multiversion] functions: the loop is compiled for baseline, AVX2 and AVX-512 CPUs
+// and the best version is picked at startup (VLANG_CPU_LEVEL=0 forces the baseline one).
+// Build with --march=native to tune everything else for the host CPU.
+[Multiversion]
+double dot(double[] a, double[] b) {
+    double sum = 0;
+    for (int i = 0; i < a.length; ++i)
+        sum = sum + a[i] * b[i];
+    return sum;
+}
+
+[Multiversion]
+void scale(double[] a, double factor) {
+    for (int i = 0; i < a.length; ++i)
+        a[i] = a[i] * factor;
+}
+
+int main() {
+    double[] a = new double[1000];
+    double[] b = new double[1000];
+    for (int i = 0; i < a.length; ++i) {
+        a[i] = i;
+        b[i] = 2;
+    }
+    scale(b, 0.5);
+    stdout.printf("%g\n", dot(a, b));
+    return 0;
+}
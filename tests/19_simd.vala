@@ -0,0 +1,40 @@
+// Tests SIMD vector types: lane-wise arithmetic, lanes, shuffles, reductions and loads/stores
+// of whole vectors from arrays (bounds checked once per vector).
+double dot(double[] a, double[] b) {
+    double4 sum = double4(0);
+    int i = 0;
+    for (i = 0; i + 4 <= a.length; i = i + 4)
+        sum = sum + double4.load_aligned(a, i) * double4.load_aligned(b, i);
+    double res = sum.sum();
+    for (; i < a.length; ++i)
+        res = res + a[i] * b[i];
+    return res;
+}
+
+int main() {
+    double4 v = double4(1, 2, 3, 4);
+    double4 w = v * 2 + 0.5;
+    stdout.printf("%g %g %g %g\n", w[0], w[1], w[2], w[3]);
+
+    double4 r = v.shuffle(3, 2, 1, 0);
+    r[0] = -r[0];
+    stdout.printf("%g %g %g\n", r[0], r.min(), r.max());
+
+    int32x8 n = int32x8(0, 1, 2, 3, 4, 5, 6, 7);
+    int32x8 m = n.shuffle(n * 10, 0, 8, 1, 9, 2, 10, 3, 11);
+    int32x8 h = n / 2;
+    stdout.printf("%d %d\n", m.sum(), h.max());
+
+    double[] a = new double[10];
+    double[] b = new double[10];
+    for (int i = 0; i < a.length; ++i) {
+        a[i] = i;
+        b[i] = 2;
+    }
+    stdout.printf("%g\n", dot(a, b));
+
+    double2 half = double2.load(a, 3) / 2;
+    half.store(b, 7);
+    stdout.printf("%g %g\n", b[7], b[8]);
+    return 0;
+}
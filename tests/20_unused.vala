@@ -0,0 +1,25 @@
+// Tests removal of unused functions: square and its callers are generated, helper and
+// cube aren't (build with -l 1 to see the module). --export=cube keeps cube and helper.
+int helper(int x) {
+    return x + 1;
+}
+
+int cube(int x) {
+    return helper(x) * x * x;
+}
+
+int square(int x) {
+    return x * x;
+}
+
+int sum_of_squares(int n) {
+    int sum = 0;
+    for (int i = 1; i <= n; ++i)
+        sum = sum + square(i);
+    return sum;
+}
+
+int main() {
+    stdout.printf("%d\n", sum_of_squares(10));
+    return 0;
+}
@@ -0,0 +1,33 @@
+// Tests --run: collatz and main run in the interpreter, steps gets hot and the program
+// switches to native code (vlang --run --jit-threshold=1000 tests/21_run.vala).
+// length() uses a string, so it is native from the start.
+int steps(int n) {
+    int count = 0;
+    while (n != 1) {
+        if (n % 2 == 0)
+            n = n / 2;
+        else
+            n = 3 * n + 1;
+        count++;
+    }
+    return count;
+}
+
+double average(int limit) {
+    int total = 0;
+    for (int i = 1; i <= limit; ++i)
+        total = total + steps(i);
+    return (double) total / limit;
+}
+
+int length() {
+    string s = "interpreter";
+    return s.length;
+}
+
+int main() {
+    stdout.printf("%d\n", steps(27));
+    stdout.printf("%f\n", average(10000));
+    stdout.printf("%d\n", length());
+    return 0;
+}
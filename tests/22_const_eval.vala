@@ -0,0 +1,33 @@
+// Tests compile-time evaluation: calls of pure functions with constant arguments become
+// constants (build with -l 1: square and power aren't generated at all). log writes
+// output and fib(n) has a variable argument, so these calls stay.
+int square(int x) {
+    return x * x;
+}
+
+int fib(int n) {
+    if (n < 2)
+        return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+double power(double base, int exponent) {
+    double result = 1.0;
+    for (int i = 0; i < exponent; ++i)
+        result = result * base;
+    return result;
+}
+
+int log(int x) {
+    stdout.printf("log %d\n", x);
+    return x;
+}
+
+int main() {
+    int n = 7;
+    stdout.printf("%d %d\n", square(10), square(square(-3)));
+    stdout.printf("%d\n", fib(20));
+    stdout.printf("%f\n", power(1.5, 4));
+    stdout.printf("%d %d\n", log(5), fib(n));
+    return 0;
+}
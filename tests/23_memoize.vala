@@ -0,0 +1,29 @@
+// Tests [Memoize] functions: fib(90) takes 91 computations instead of billions, paths()
+// caches two arguments. print() isn't memoized (it returns nothing) and only gets a warning.
+[Memoize]
+int64 fib(int n) {
+    if (n < 2)
+        return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+[Memoize]
+double paths(int rows, int columns) {
+    if (rows == 0)
+        return 1.0;
+    if (columns == 0)
+        return 1.0;
+    return paths(rows - 1, columns) + paths(rows, columns - 1);
+}
+
+[Memoize]
+void print(int64 x) {
+    stdout.printf("%lld\n", x);
+}
+
+int main() {
+    int n = 90;
+    print(fib(n));
+    stdout.printf("%f\n", paths(16, 16));
+    return 0;
+}
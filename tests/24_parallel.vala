@@ -0,0 +1,45 @@
+// Tests [Parallel] loops: iterations run on VLANG_THREADS threads (all CPUs by default),
+// written outer variables are reductions. Output doesn't depend on the number of threads
+// (the sum of doubles only up to rounding).
+int main() {
+    int n = 1000000;
+    double[] a = new double[n];
+    int[] b = new int[n];
+
+    // Iterations write different elements
+    [Parallel]
+    for (int i = 0; i < n; ++i) {
+        a[i] = i * 0.5;
+        b[i] = (i * 37) % 1000;
+    }
+
+    int64 total = 0;
+    int biggest = 0;
+    double smallest = 1000000.0;
+    double product = 1.0;
+    int odd = 0;
+    [Parallel]
+    for (int i = 0; i < n; ++i) {
+        total = total + b[i];
+        if (b[i] > biggest) biggest = b[i];
+        smallest = Math.fmin(smallest, a[i] + 1.0);
+        if (b[i] % 2 == 1)
+            ++odd;
+    }
+    [Parallel]
+    for (int i = 1; i <= 20; ++i)
+        product = product * i;
+    stdout.printf("%lld %d %f %d %f\n", total, biggest, smallest, odd, product);
+
+    // Inner loops of an iteration run serially inside it
+    double checksum = 0.0;
+    [Parallel]
+    for (int row = 0; row < 1000; ++row) {
+        double s = 0.0;
+        for (int col = 0; col < 1000; ++col)
+            s = s + a[row * 1000 + col];
+        checksum = checksum + s;
+    }
+    stdout.printf("%f\n", checksum);
+    return 0;
+}
@@ -0,0 +1,11 @@
+int main() {
+    int8 a = 1000;
+    uint8 b = -1;
+    int x = 10;
+    int8 c = x;
+    uint d = x;
+    int64 e = 10;
+    int f = e;
+    uint64 g = e;
+    return 0;
+}
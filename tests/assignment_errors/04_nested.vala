@@ -0,0 +1,15 @@
+// Assignments inside blocks, ifs and loops are checked too
+int main() {
+    int n = 3;
+    if (n > 2) {
+        string s = 1.5;
+    }
+    for (int i = 0; i < n; i++) {
+        while (n > 0) {
+            int8 x = 1000;
+            n--;
+        }
+    }
+    return 0;
+    n = 1;
+}
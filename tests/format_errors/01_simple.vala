@@ -0,0 +1,9 @@
+int main() {
+    int x = 10;
+    double y = 1.5;
+    stdout.printf("%d %d\n", x, y);
+    stdout.printf("%s\n");
+    if (x > 5)
+        stdout.printf("%f %q\n", y);
+    return 0;
+}
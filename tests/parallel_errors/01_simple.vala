@@ -0,0 +1,56 @@
+int main() {
+    int n = 1000;
+    int[] a = new int[n];
+    int last = 0;
+    int sum = 0;
+
+    // Iterations would race on last
+    [Parallel]
+    for (int i = 0; i < n; ++i)
+        last = a[i];
+
+    // Partial sums aren't the sum
+    [Parallel]
+    for (int i = 0; i < n; ++i) {
+        sum = sum + a[i];
+        a[i] = sum;
+    }
+
+    // Not a counted loop
+    [Parallel]
+    for (int i = n; i > 0; --i)
+        a[i - 1] = i;
+
+    // Iterations read and write elements of each other
+    [Parallel]
+    for (int i = 1; i < n; ++i)
+        a[i] = a[i - 1] + 1;
+    [Parallel]
+    for (int i = 0; i < n; ++i)
+        a[0] = i;
+
+    // Compares one value and keeps another, that isn't a maximum
+    double[] d = new double[n];
+    double m = 0.0;
+    [Parallel]
+    for (int i = 0; i < n; ++i) {
+        if (Math.fabs(d[i]) > m)
+            m = Math.sqrt(d[i]);
+    }
+
+    // Iterations retain and release the same string, that needs --atomic-rc
+    string name = "vlang";
+    int[] lengths = new int[n];
+    [Parallel]
+    for (int i = 0; i < n; ++i) {
+        string copy = name;
+        lengths[i] = copy.length;
+    }
+
+    [Parallel]
+    for (int i = 0; i < n; ++i) {
+        if (a[i] < 0)
+            return 1;
+    }
+    return 0;
+}